@@ -0,0 +1,196 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+namespace SpaE
+{
+
+struct Buffer;
+
+/**
+ * Buffer 的侵入式引用计数指针，拷贝只增加引用计数，可以跨线程传递（比如作为信号参数）
+ */
+class BufferRef
+{
+public:
+    BufferRef() = default;
+    BufferRef(Buffer *b);
+    BufferRef(const BufferRef &other);
+    BufferRef(BufferRef &&other) noexcept;
+    ~BufferRef();
+
+    BufferRef &operator = (const BufferRef &other);
+    BufferRef &operator = (BufferRef &&other) noexcept;
+
+    Buffer *get() const
+    {
+        return m_buf;
+    }
+
+    Buffer *operator -> () const
+    {
+        return m_buf;
+    }
+
+    explicit operator bool () const
+    {
+        return m_buf != nullptr;
+    }
+
+    bool operator == (const BufferRef &other) const
+    {
+        return m_buf == other.m_buf;
+    }
+
+    bool operator != (const BufferRef &other) const
+    {
+        return m_buf != other.m_buf;
+    }
+
+    // 以下为便捷访问，空引用时返回 nullptr / 0
+    char    *data() const;
+    size_t  size() const;
+
+private:
+    Buffer  *m_buf = nullptr;
+};
+
+/**
+ * 池化的字节缓冲，头部与数据在同一块内存中：[ Buffer | data ... ]
+ * 按 2 的幂分档复用，超过最大档的直接分配和释放
+ */
+struct Buffer
+{
+    std::atomic<int>    refCount;
+
+    // 数据区容量
+    uint32_t    capacity;
+
+    // 有效数据长度，由使用者维护
+    uint32_t    size;
+
+    // 所在档位，-1 表示不池化
+    int         sizeClass;
+
+    // 空闲链表
+    Buffer      *next;
+
+    Buffer(const Buffer &) = delete;
+    Buffer& operator= (const Buffer&) = delete;
+
+    char *data()
+    {
+        return (char *) (this + 1);
+    }
+
+    /**
+     * @brief               从池中取一块容量不小于 capacity 的缓冲，size 为 0
+     */
+    static BufferRef    alloc(size_t capacity);
+
+    /**
+     * @brief               分配并拷贝 len 字节，size 为 len
+     */
+    static BufferRef    copy(const void *data, size_t len);
+
+    /**
+     * @brief               每个档位最多缓存的空闲块数量，默认 256
+     */
+    static void     setPoolLimit(int count);
+
+    void    addRef()
+    {
+        refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void    release();
+
+private:
+    Buffer() = default;
+    ~Buffer() = default;
+};
+
+inline BufferRef::BufferRef(Buffer *b) : m_buf(b)
+{
+    if (m_buf) {
+        m_buf->addRef();
+    }
+}
+
+inline BufferRef::BufferRef(const BufferRef &other) : m_buf(other.m_buf)
+{
+    if (m_buf) {
+        m_buf->addRef();
+    }
+}
+
+inline BufferRef::BufferRef(BufferRef &&other) noexcept : m_buf(other.m_buf)
+{
+    other.m_buf = nullptr;
+}
+
+inline BufferRef::~BufferRef()
+{
+    if (m_buf) {
+        m_buf->release();
+    }
+}
+
+inline BufferRef &BufferRef::operator = (const BufferRef &other)
+{
+    if (other.m_buf) {
+        other.m_buf->addRef();
+    }
+    if (m_buf) {
+        m_buf->release();
+    }
+    m_buf = other.m_buf;
+
+    return *this;
+}
+
+inline BufferRef &BufferRef::operator = (BufferRef &&other) noexcept
+{
+    if (this != &other) {
+        if (m_buf) {
+            m_buf->release();
+        }
+        m_buf = other.m_buf;
+        other.m_buf = nullptr;
+    }
+
+    return *this;
+}
+
+inline char *BufferRef::data() const
+{
+    return m_buf ? m_buf->data() : nullptr;
+}
+
+inline size_t BufferRef::size() const
+{
+    return m_buf ? m_buf->size : 0;
+}
+
+};
@@ -0,0 +1,322 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "coroutine_sync.h"
+
+namespace SpaE
+{
+
+// 一次 send / recv / select 等待的共享状态，select 的多个分支指向同一个
+struct ChannelWait
+{
+    CoWaiter    waiter;
+
+    int         selected = -1;
+
+    bool        ok = false;
+};
+
+struct ChannelNode
+{
+    ChannelWait     *wait = nullptr;
+
+    // send: 源对象, recv: 目标对象
+    void            *value = nullptr;
+
+    int             index = 0;
+
+    ChannelNode     *prev = nullptr,
+                    *next = nullptr;
+};
+
+// 侵入式等待队列，不加锁，由所属通道保护
+class ChannelNodeQueue
+{
+public:
+    void            push(ChannelNode *n);
+    void            remove(ChannelNode *n);
+
+    /**
+     * @brief               取出一个仍在等待的节点并抢占（Waiting -> Claimed）
+     *                      调用者写入数据后必须调用 complete
+     */
+    ChannelNode     *claim();
+
+    /**
+     * @brief               完成抢占的节点，之后节点随时可能失效
+     * @param wakeup        对应的唤醒动作，需在释放锁之后执行
+     */
+    static void     complete(ChannelNode *n, bool ok, CoWakeup &wakeup);
+
+private:
+    ChannelNode     *m_head = nullptr,
+                    *m_tail = nullptr;
+};
+
+class ChannelSelect;
+
+class ChannelBase
+{
+public:
+    friend class ChannelSelect;
+
+    ChannelBase(size_t capacity);
+    virtual ~ChannelBase();
+
+    ChannelBase(const ChannelBase &) = delete;
+    ChannelBase& operator= (const ChannelBase&) = delete;
+
+    /**
+     * @brief               关闭通道，唤醒所有等待者。缓冲中的数据仍可被接收
+     */
+    void        close();
+    bool        isClosed();
+
+    size_t      capacity();
+    size_t      size();
+
+protected:
+    // 以下函数调用时必须持有 m_mutex，value 为 T *
+    // 返回 true 表示操作已完成（ok 为 false 表示通道已关闭），false 表示需要等待
+    virtual bool    trySendLocked(void *value, CoWakeup &wakeup, bool &ok) = 0;
+    virtual bool    tryRecvLocked(void *value, CoWakeup &wakeup, bool &ok) = 0;
+
+    virtual size_t  bufferSizeLocked() = 0;
+
+    bool        sendHelper(void *value, const Seconds &sec, bool &ok);
+    bool        recvHelper(void *value, const Seconds &sec, bool &ok);
+
+protected:
+    SpinMutex           m_mutex;
+
+    size_t              m_capacity;
+
+    bool                m_closed = false;
+
+    ChannelNodeQueue    m_sendQueue,
+                        m_recvQueue;
+};
+
+/**
+ * Go 风格通道
+ * capacity 为 0 时为无缓冲通道，send 直到有接收者取走数据才返回；
+ * 缓冲满时 send 挂起当前 Context，缓冲空时 recv 挂起，由此对生产者形成背压。
+ * 不在协程中调用时阻塞线程。所在上下文被取消时挂起中的 send / recv 返回 false。
+ */
+template<typename T>
+class Channel : public ChannelBase
+{
+public:
+    Channel(size_t capacity = 0) : ChannelBase(capacity)
+    {
+
+    }
+
+    /**
+     * @return              false 表示通道已关闭
+     */
+    bool send(const T &value)
+    {
+        T   v = value;
+
+        return sendFor(std::move(v), -1);
+    }
+
+    bool send(T &&value)
+    {
+        return sendFor(std::move(value), -1);
+    }
+
+    /**
+     * @return              false 表示超时或通道已关闭
+     */
+    bool sendFor(T &&value, const Seconds &sec)
+    {
+        bool ok;
+
+        return sendHelper(&value, sec, ok) && ok;
+    }
+
+    bool trySend(T &&value)
+    {
+        return sendFor(std::move(value), 0);
+    }
+
+    /**
+     * @return              false 表示通道已关闭且缓冲为空
+     */
+    bool recv(T &value)
+    {
+        return recvFor(value, -1);
+    }
+
+    /**
+     * @return              false 表示超时或通道已关闭且缓冲为空
+     */
+    bool recvFor(T &value, const Seconds &sec)
+    {
+        bool ok;
+
+        return recvHelper(&value, sec, ok) && ok;
+    }
+
+    bool tryRecv(T &value)
+    {
+        return recvFor(value, 0);
+    }
+
+protected:
+    bool trySendLocked(void *value, CoWakeup &wakeup, bool &ok) override
+    {
+        auto &v = * (T *) value;
+
+        if (m_closed) {
+            ok = false;
+            return true;
+        }
+
+        auto n = m_recvQueue.claim();
+        if (n) {
+            * (T *) n->value = std::move(v);
+
+            ChannelNodeQueue::complete(n, true, wakeup);
+
+            ok = true;
+            return true;
+        }
+
+        if (m_buffer.size() < m_capacity) {
+            m_buffer.emplace_back(std::move(v));
+
+            ok = true;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool tryRecvLocked(void *value, CoWakeup &wakeup, bool &ok) override
+    {
+        auto &v = * (T *) value;
+
+        if (m_buffer.size()) {
+            v = std::move(m_buffer.front());
+            m_buffer.pop_front();
+
+            // 腾出的位置交给等待中的发送者
+            auto n = m_sendQueue.claim();
+            if (n) {
+                m_buffer.emplace_back(std::move(* (T *) n->value));
+
+                ChannelNodeQueue::complete(n, true, wakeup);
+            }
+
+            ok = true;
+            return true;
+        }
+
+        auto n = m_sendQueue.claim();
+        if (n) {
+            v = std::move(* (T *) n->value);
+
+            ChannelNodeQueue::complete(n, true, wakeup);
+
+            ok = true;
+            return true;
+        }
+
+        if (m_closed) {
+            ok = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    size_t bufferSizeLocked() override
+    {
+        return m_buffer.size();
+    }
+
+private:
+    std::deque<T>       m_buffer;
+};
+
+/**
+ * 在多个通道上等待，任意一个分支就绪即返回
+ *
+ *  ChannelSelect sel;
+ *  auto a = sel.recv(ch1, v1);
+ *  auto b = sel.send(ch2, v2);
+ *  auto r = sel.wait(1);   // r == a / r == b / r == -1 超时
+ *
+ * 被选中的 send 分支会移走 value，recv 分支的 value 在选中前保持不变
+ * 所在上下文被取消时 wait 按超时返回
+ */
+class ChannelSelect
+{
+public:
+    template<typename T>
+    int recv(Channel<T> &ch, T &value)
+    {
+        return addCase(&ch, &value, false);
+    }
+
+    template<typename T>
+    int send(Channel<T> &ch, T &value)
+    {
+        return addCase(&ch, &value, true);
+    }
+
+    /**
+     * @param sec           小于 0 表示一直等待，0 表示不等待
+     * @return              就绪分支的序号，-1 表示超时
+     */
+    int     wait(const Seconds &sec = -1);
+
+    /**
+     * @brief               被选中的分支是否成功，false 表示对应通道已关闭
+     */
+    bool    ok();
+
+private:
+    struct Case {
+        ChannelBase     *ch;
+
+        void            *value;
+
+        bool            isSend;
+    };
+
+    int     addCase(ChannelBase *ch, void *value, bool isSend);
+
+    void    lockAll(std::vector<ChannelBase *> &chs);
+    void    unlockAll(std::vector<ChannelBase *> &chs);
+
+private:
+    std::vector<Case>       m_cases;
+
+    bool        m_ok = false;
+};
+
+};
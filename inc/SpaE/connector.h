@@ -38,12 +38,121 @@ template<typename R, typename... Args>
 struct is_std_function<std::function<R(Args...)>, std::void_t<decltype(&std::function<R(Args...)>::operator())>>
     : std::true_type {};
 
+template<typename ... Args>
+struct SignalWaiter;
+
+/**
+ * 信号的等待者链表，由信号和挂在其上的等待者共同持有，信号销毁后等待者仍可安全地移除自己
+ */
+template<typename ... Args>
+struct SignalWaiterList
+{
+    using Waiter = SignalWaiter<Args ...>;
+
+    SpinMutex   mutex;
+
+    Waiter      *head = nullptr,
+                *tail = nullptr;
+
+    // 以下持有 mutex 时调用
+
+    void push(Waiter *w)
+    {
+        w->prev = tail;
+        w->next = nullptr;
+
+        if (tail) {
+            tail->next = w;
+        }
+        else {
+            head = w;
+        }
+        tail = w;
+    }
+
+    void unlink(Waiter *w)
+    {
+        // 已经被发射取走
+        if (! w->prev && head != w) {
+            return;
+        }
+
+        if (w->prev) {
+            w->prev->next = w->next;
+        }
+        else {
+            head = w->next;
+        }
+
+        if (w->next) {
+            w->next->prev = w->prev;
+        }
+        else {
+            tail = w->prev;
+        }
+
+        w->prev = nullptr;
+        w->next = nullptr;
+    }
+};
+
+/**
+ * 一次性信号等待者，不经过 Connect
+ * 信号下一次发射时从信号中移除，并以发射的参数调用 complete；信号在发射前销毁时调用 cancel
+ */
+template<typename ... Args>
+struct SignalWaiter
+{
+    SignalWaiter    *prev = nullptr,
+                    *next = nullptr;
+
+    std::shared_ptr<SignalWaiterList<Args ...>>     list;
+
+    virtual ~SignalWaiter()
+    {
+
+    }
+
+    /**
+     * @brief               在信号锁内调用
+     * @return              false 表示等待者已放弃（如超时），不再调用 complete / cancel
+     */
+    virtual bool    claim() = 0;
+
+    /**
+     * @brief               释放信号锁后在信号所在线程调用，之后节点随时可能失效
+     */
+    virtual void    complete(const Args &... args) = 0;
+
+    /**
+     * @brief               同 complete，信号在发射前被销毁时在销毁它的线程调用
+     */
+    virtual void    cancel() = 0;
+
+    /**
+     * @brief               移除尚未被发射取走的等待者，信号已销毁时也可以调用
+     */
+    void    unlink()
+    {
+        auto l = list;
+        if (! l) {
+            return;
+        }
+
+        std::unique_lock<decltype(l->mutex)>    lk(l->mutex);
+
+        l->unlink(this);
+    }
+};
+
 template<typename ... Args>
 class Signal : public SignalBase
 {
 public:
     using Func = std::function<void (Args ...)>;
 
+    using Waiter = SignalWaiter<Args ...>;
+
     using ConnectFunMap = std::map<SharedConnectBase, Func>;
     using ConnectSet = std::set<SharedConnectBase>;
 
@@ -91,6 +200,54 @@ public:
         m_connectFunMap.erase(it);
     }
 
+    ~Signal()
+    {
+        if (! m_waiters) {
+            return;
+        }
+
+        // 挂起的等待者以 cancel 结束，之后它们只访问共享的链表
+        Waiter  *head = claimWaiters(*m_waiters);
+
+        while (head) {
+            auto w = head;
+            head = w->next;
+
+            w->next = nullptr;
+            w->cancel();
+        }
+    }
+
+    /**
+     * @brief               添加一次性等待者，信号需已绑定（见 SpaE::bindSignal）
+     */
+    void addWaiter(Waiter *w)
+    {
+        std::shared_ptr<WaiterList>     l;
+        {
+            std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+            if (! m_waiters) {
+                m_waiters = std::make_shared<WaiterList>();
+            }
+            l = m_waiters;
+        }
+
+        w->list = l;
+
+        std::unique_lock<decltype(l->mutex)>    lk(l->mutex);
+
+        l->push(w);
+    }
+
+    /**
+     * @brief               移除尚未被发射取走的等待者，同 Waiter::unlink
+     */
+    void removeWaiter(Waiter *w)
+    {
+        w->unlink();
+    }
+
     void dispatch(const Args &... args)
     {
         if (! m_loop) {
@@ -147,8 +304,65 @@ public:
     }
 
 private:
+    using WaiterList = SignalWaiterList<Args ...>;
+
+    // 摘下所有等待者，claim 成功的借用 next 串成临时链表返回
+    static Waiter *claimWaiters(WaiterList &l)
+    {
+        Waiter  *head = nullptr,
+                *tail = nullptr;
+
+        std::unique_lock<decltype(l.mutex)>     lk(l.mutex);
+
+        while (l.head) {
+            auto w = l.head;
+
+            l.unlink(w);
+
+            if (! w->claim()) {
+                continue;
+            }
+
+            if (tail) {
+                tail->next = w;
+            }
+            else {
+                head = w;
+            }
+            tail = w;
+        }
+
+        return head;
+    }
+
+    void notifyWaiters(const Args &... args)
+    {
+        std::shared_ptr<WaiterList>     l;
+        {
+            std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+            l = m_waiters;
+        }
+
+        if (! l) {
+            return;
+        }
+
+        Waiter  *head = claimWaiters(*l);
+
+        while (head) {
+            auto w = head;
+            head = w->next;
+
+            w->next = nullptr;
+            w->complete(args ...);
+        }
+    }
+
     void dispatchHelper(const Args &... args)
     {
+        notifyWaiters(args ...);
+
         auto sharedAlive = m_containerAlive;
 
         std::function<void ()>      func;
@@ -223,6 +437,8 @@ private:
 
     void dispatchSyncHelper(const Args &... args)
     {
+        notifyWaiters(args ...);
+
         auto sharedAlive = m_containerAlive;
 
         std::function<void ()>      func;
@@ -290,6 +506,9 @@ private:
     SharedConnectBase   m_sharedConnect;
 
     SpinMutex           m_mutex;
+
+    // 第一次 addWaiter 时创建
+    std::shared_ptr<WaiterList>     m_waiters;
 };
 
 // 计算函数参数个数
@@ -626,4 +845,30 @@ SharedConnectBase connect(SenderObject *sender, Signal *signal, nullptr_t receiv
     return connect<SenderObject, Signal, Slot>(sender, signal, std::forward<Slot>(slot), mode);
 }
 
+/**
+ * @brief       将信号绑定到发送者所在的事件循环，未 connect 过的信号在添加等待者前需先绑定
+ *              不在发送者线程中调用时同步等待发送者线程完成绑定
+ */
+template<typename SenderObject, typename Signal>
+void bindSignal(SenderObject *sender, Signal *signal)
+{
+    if (signal->isBound()) {
+        return;
+    }
+
+    if (sender->getLoop() == Loop::getCurrentLoop()) {
+        sender->bindSignal(signal);
+        return;
+    }
+
+    sender->getLoop()->workSync(
+        [=]
+        {
+            if (! signal->isBound()) {
+                sender->bindSignal(signal);
+            }
+        }
+    );
+}
+
 };
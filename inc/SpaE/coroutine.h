@@ -19,7 +19,10 @@
 #pragma once
 
 #include <vector>
-#include <condition_variable>
+#include <atomic>
+#include <optional>
+#include <tuple>
+#include <string>
 
 #include "loop.h"
 #include "timer.h"
@@ -29,38 +32,251 @@ namespace SpaE
 
 using ContextId = uint64_t;
 
-struct ArchContext;
+struct Context;
 
 class Coroutine;
 
-struct Context : public Object
+class TaskGroup;
+
+struct CoWakeup;
+
+/**
+ * Context 的侵入式引用计数指针，用法与 std::shared_ptr 一致
+ * 引用计数放在 Context 内部，不再单独分配控制块
+ */
+class SharedContext
+{
+public:
+    SharedContext() = default;
+
+    SharedContext(std::nullptr_t)
+    {
+
+    }
+
+    explicit SharedContext(Context *c);
+
+    SharedContext(const SharedContext &other);
+    SharedContext(SharedContext &&other) noexcept;
+
+    ~SharedContext();
+
+    SharedContext &operator = (const SharedContext &other);
+    SharedContext &operator = (SharedContext &&other) noexcept;
+
+    Context *get() const
+    {
+        return m_ctx;
+    }
+
+    Context *operator -> () const
+    {
+        return m_ctx;
+    }
+
+    Context &operator * () const
+    {
+        return *m_ctx;
+    }
+
+    explicit operator bool () const
+    {
+        return m_ctx != nullptr;
+    }
+
+    bool operator == (const SharedContext &other) const
+    {
+        return m_ctx == other.m_ctx;
+    }
+
+    bool operator != (const SharedContext &other) const
+    {
+        return m_ctx != other.m_ctx;
+    }
+
+    bool operator < (const SharedContext &other) const
+    {
+        return m_ctx < other.m_ctx;
+    }
+
+private:
+    Context     *m_ctx = nullptr;
+};
+
+/**
+ * 协程（或线程）等待者，CoSync 原语、Channel 以及 join 共用
+ */
+struct CoWaiter
+{
+    enum State {
+        Waiting,
+        Claimed,        // 已被通知方抢占，正在写入结果
+        Notified,
+        TimedOut,
+    };
+
+    std::atomic<int>    state { Waiting };
+
+    Coroutine       *co = nullptr;
+    SharedContext   sc;
+
+    // 不在协程中时使用
+    Semaphore       sem;
+
+    // 为 true 时所在上下文被取消会使 sleep 提前返回 false（同超时）
+    bool            cancellable = false;
+
+    CoWaiter        *prev = nullptr,
+                    *next = nullptr;
+
+    /**
+     * @brief               记录当前等待者（协程上下文或线程），入队之前调用
+     */
+    void        prepare();
+
+    /**
+     * @brief               挂起直到被通知、超时或被取消，超时和取消后状态为 TimedOut
+     *                      调用前 waiter 必须已入队，且已释放保护队列的锁；
+     *                      超时返回后由调用者负责将 waiter 移出队列
+     * @param sec           小于 0 表示一直等待
+     * @return              true 被通知, false 超时或被取消
+     */
+    bool        sleep(const Seconds &sec = -1);
+
+    /**
+     * @brief               上下文已被取消时尝试将状态置为 TimedOut，仅协程中调用
+     * @return              true 表示已因取消结束等待
+     */
+    bool        cancel();
+
+    /**
+     * @brief               通知方抢占等待者（Waiting -> Claimed），在保护队列的锁内调用
+     * @return              false 表示已超时或已被其他通知方抢占
+     */
+    bool        claim()
+    {
+        int expected = Waiting;
+
+        return state.compare_exchange_strong(expected, Claimed);
+    }
+
+    /**
+     * @brief               完成抢占（Claimed -> Notified），之后 waiter 随时可能失效
+     * @param wakeup        对应的唤醒动作，需在释放锁之后执行
+     */
+    void        complete(CoWakeup &wakeup);
+
+    bool        finished()
+    {
+        auto s = state.load();
+
+        return s == Notified || s == TimedOut;
+    }
+};
+
+// 唤醒动作，需要在释放原语内部锁之后执行
+struct CoWakeup
 {
-    std::vector<char>       stack;
+    Coroutine       *co = nullptr;
+    SharedContext   sc;
+
+    Semaphore       *sem = nullptr;
+
+    void operator () ();
+};
+
+// 侵入式等待队列，不加锁，由所属对象保护
+class CoWaitQueue
+{
+public:
+    void        push(CoWaiter *w);
+    void        remove(CoWaiter *w);
+
+    /**
+     * @brief               取出一个仍在等待的 waiter 并标记为 Notified
+     * @param wakeup        对应的唤醒动作
+     * @return              false 表示队列中没有可唤醒的 waiter
+     */
+    bool        notifyOne(CoWakeup &wakeup);
+
+    bool        empty();
+
+private:
+    CoWaiter    *m_head = nullptr,
+                *m_tail = nullptr;
+};
 
+/**
+ * 协程上下文
+ * 与栈在同一块内存中分配：[ 栈 ... | Context ]，Context 位于栈顶之上，
+ * 栈底写入溢出标记。创建一个协程只有这一次分配（不计 work 自身）。
+ */
+struct Context
+{
     ContextId       id;
 
     Loop::WorkFun   work;
     Loop::Priority  pri;
 
+    // 所属协程，迁移时改变
+    std::atomic<Coroutine *>    co;
+
+    // 非空时在下次切出后迁移到该协程，仅所属协程线程访问
+    Coroutine       *migrateTo;
+
     bool        alive;
     bool        firstRun;
     bool        running;
 
-    std::mutex                  compeleteCvMutex;
-    std::condition_variable     compeleteCv;
+    // 协作式取消标志，在挂起点检查
+    std::atomic<bool>   cancelled;
+
+    std::atomic<int>    refCount;
 
+    // 保护 alive 与 completeQueue
     SpinMutex       mutex;
 
-    ArchContext     *archContex;
+    // join 等待者
+    CoWaitQueue     completeQueue;
 
-    Context(const Loop::WorkFun &work, int stackSize);
-    Context(Loop::WorkFun &&work, int stackSize);
-    ~Context();
+    // 睡眠定时器的到期时间及在 Coroutine 定时器堆中的位置，仅协程线程访问
+    Seconds     wakeTime;
+    int         timerIndex;
+
+    // 本次切入的时间，以及是否已经超出过时间片预算，仅协程线程访问
+    Seconds     sliceStart;
+    bool        greedy;
+
+    // 所属任务组及在组内的位置，mutex 保护
+    TaskGroup       *group;
+    int             groupIndex;
+
+    // 栈底（低地址），也是整块内存的起始
+    char        *stack;
+    int         stackSize;
+
+    // work() 传入的任务类型标记，用于栈使用统计
+    const char  *tag;
+
+    // 创建时栈已填充，结束时可统计使用量
+    bool        painted;
+
+    // tb_context_ref_t, tb_context_from_t::context
+    void        *archRef;
+    void        *archFrom;
+
+    // Coroutine 内的上下文链表
+    Context     *prev, *next;
 
     Context(const Context &) = delete;
     Context& operator= (const Context&) = delete;
 
-    void init(int stackSize);
+    /**
+     * @brief               分配上下文和栈
+     * @param stackSize     栈大小
+     */
+    static SharedContext    create(const Loop::WorkFun &work, int stackSize);
+    static SharedContext    create(Loop::WorkFun &&work, int stackSize);
 
     bool operator < (const Context &other) const
     {
@@ -72,12 +288,108 @@ struct Context : public Object
         return id == other.id;
     }
 
-    void        join();
+    void    addRef()
+    {
+        refCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void    release();
 
-    Signal<>    signalCompelte;
+private:
+    Context(int stackSize);
+    ~Context();
+
+    static SharedContext    alloc(int stackSize);
 };
 
-using SharedContext = std::shared_ptr<Context>;
+inline SharedContext::SharedContext(Context *c) : m_ctx(c)
+{
+    if (m_ctx) {
+        m_ctx->addRef();
+    }
+}
+
+inline SharedContext::SharedContext(const SharedContext &other) : m_ctx(other.m_ctx)
+{
+    if (m_ctx) {
+        m_ctx->addRef();
+    }
+}
+
+inline SharedContext::SharedContext(SharedContext &&other) noexcept : m_ctx(other.m_ctx)
+{
+    other.m_ctx = nullptr;
+}
+
+inline SharedContext::~SharedContext()
+{
+    if (m_ctx) {
+        m_ctx->release();
+    }
+}
+
+inline SharedContext &SharedContext::operator = (const SharedContext &other)
+{
+    if (other.m_ctx) {
+        other.m_ctx->addRef();
+    }
+    if (m_ctx) {
+        m_ctx->release();
+    }
+    m_ctx = other.m_ctx;
+
+    return *this;
+}
+
+inline SharedContext &SharedContext::operator = (SharedContext &&other) noexcept
+{
+    if (this != &other) {
+        if (m_ctx) {
+            m_ctx->release();
+        }
+        m_ctx = other.m_ctx;
+        other.m_ctx = nullptr;
+    }
+
+    return *this;
+}
+
+/**
+ * Coroutine::waitSignal 使用的一次性信号等待者
+ */
+template<typename ... Args>
+struct CoSignalWaiter : public SignalWaiter<Args ...>
+{
+    CoWaiter    waiter;
+
+    std::optional<std::tuple<std::decay_t<Args> ...>>       result;
+
+    bool claim() override
+    {
+        return waiter.claim();
+    }
+
+    void complete(const Args &... args) override
+    {
+        CoWakeup    wakeup;
+
+        result.emplace(args ...);
+
+        waiter.complete(wakeup);
+
+        wakeup();
+    }
+
+    // 信号被销毁，以空结果唤醒
+    void cancel() override
+    {
+        CoWakeup    wakeup;
+
+        waiter.complete(wakeup);
+
+        wakeup();
+    }
+};
 
 class Coroutine
 {
@@ -85,16 +397,107 @@ public:
     Coroutine(const Coroutine &) = delete;
     Coroutine& operator= (const Coroutine&) = delete;
 
-    SharedContext       work(const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0);
-    SharedContext       work(Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0);
+    /**
+     * @param stackSize     栈大小，小于 getStackSize() 时使用 getStackSize()
+     * @param tag           任务类型标记，用于栈使用统计与自适应栈大小，按字符串内容区分，需长期有效
+     */
+    SharedContext       work(const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+    SharedContext       work(Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
 
     void    join(const SharedContext &sc);
+
+    /**
+     * @brief               等待 sc 结束，最多 sec 秒；所在上下文被取消时按超时返回
+     * @return              true 表示已结束
+     */
+    bool    joinFor(const SharedContext &sc, const Seconds &sec);
+
     void    resume(const SharedContext &sc);
 
+    /**
+     * @brief               协作式取消 sc，可在任意线程调用
+     *                      尚未开始运行的上下文不再运行 work，直接结束；挂起中的上下文被唤醒，
+     *                      在挂起点（yield / yieldFor、带超时的等待、Channel 收发、
+     *                      FdOperator 的 fd 等待：readAsync / writeAsync / accept / connect / splice / sendfile）提前返回，
+     *                      fd 等待以 -1 返回，errno 为 ECANCELED
+     */
+    void    cancel(const SharedContext &sc);
+
+    /**
+     * @brief               同 resume，但不会让出当前上下文
+     */
+    void    wake(const SharedContext &sc);
+
+    /**
+     * @brief               将当前上下文迁移到 target 协程线程，返回时已在 target 线程上运行
+     *                      迁移后 thread_local 与 Loop::getCurrentLoop() 随之改变；
+     *                      不要跨 migrate 持有 thread_local 变量的引用或指针（编译器可能缓存其地址），迁移后重新访问
+     * @param objects       需要一起迁移事件循环的对象（moveToLoop），必须属于当前线程
+     * @return              false 表示不在协程中
+     */
+    static bool     migrate(Coroutine *target, std::initializer_list<Object *> objects = {});
+
+    /**
+     * @brief               将本协程的上下文 sc 迁移到 target，可在任意线程调用
+     *                      挂起中的上下文立即迁移（含睡眠定时器），之后的 resume 被转发到 target；
+     *                      正在运行或排队的上下文在下次切出后迁移。对象的事件循环需由上下文自己迁移
+     */
+    void    migrate(const SharedContext &sc, Coroutine *target);
+
     static void     pending();
+
+    /**
+     * @brief               挂起当前上下文，直到被 resume 或经过 sec 秒
+     *                      定时器由所属协程自己维护，不分配内存
+     */
+    static void     pendingFor(const Seconds &sec);
     static void     yield();
     static void     yieldFor(const Seconds &sec);
 
+    /**
+     * @brief               等待信号下一次发射，挂起当前上下文（不在协程中时阻塞线程）
+     *                      使用一次性等待者，不创建 Connect；发送者在发射前被销毁时立即返回
+     * @param sec           小于 0 表示一直等待
+     * @return              发射的参数，超时、上下文被取消或发送者被销毁时为空
+     */
+    template<typename SenderObject, typename ... Args>
+    static std::optional<std::tuple<std::decay_t<Args> ...>> waitSignal(SenderObject *sender, Signal<Args ...> *signal, const Seconds &sec = -1)
+    {
+        bindSignal(sender, signal);
+
+        CoSignalWaiter<Args ...>    w;
+        w.waiter.prepare();
+        w.waiter.cancellable = true;
+
+        signal->addWaiter(&w);
+
+        if (! w.waiter.sleep(sec)) {
+            // 信号可能已销毁，通过共享的链表移除
+            w.unlink();
+
+            return std::nullopt;
+        }
+
+        return std::move(w.result);
+    }
+
+    /**
+     * @brief               当前上下文是否已被取消
+     */
+    static bool     isCancelled();
+
+    /**
+     * @brief               协作式检查点，在长时间运行的循环中调用
+     *                      当前时间片超出预算且开启了自动让出时 yield，否则只返回
+     * @return              true 表示已让出
+     */
+    static bool     checkpoint();
+
+    /**
+     * @brief               当前上下文本次切入后已运行的时间，不在协程中时为 0
+     */
+    static Seconds  sliceElapsed();
+
     Loop        *getLoop();
 
     SharedContext       getCurrentContext();
@@ -111,16 +514,102 @@ public:
 
     void    setRun(bool sta);
 
+    /**
+     * @brief               尚未结束的上下文数量，可在任意线程调用
+     */
     int     workSetSize();
 
     static bool     stackOverflowCheck(const char **loopName, int *stackSize);
 
+    struct StackProfile
+    {
+        std::string     tag;
+
+        int     samples;
+
+        // 最大使用量（字节）
+        int     maxUsed;
+
+        // 结束时发现溢出标记被破坏的次数
+        int     overflows;
+
+        // 自适应策略为该 tag 选择的栈大小
+        int     suggested;
+
+        // histogram[i]: 使用量不超过 (1 << i) KB 且大于上一档的次数
+        std::vector<int>    histogram;
+    };
+
+    /**
+     * @brief               栈使用统计：创建上下文时填充栈，结束时扫描得到使用量，按 tag 汇总
+     *                      填充整个栈有开销，默认关闭；没有 tag 的上下文不统计
+     */
+    static void     setStackProfiling(bool sta);
+
+    /**
+     * @brief               自适应栈大小：work() 未指定 stackSize 且 tag 已有统计时，
+     *                      使用满足历史最大使用量（另加余量）的最小一档栈，开启后同时开启统计
+     */
+    static void     setStackAdaptive(bool sta);
+
+    static std::vector<StackProfile>    getStackProfiles();
+
+    struct SliceStats
+    {
+        // 上下文切入次数
+        uint64_t    slices;
+
+        // 超出预算的次数
+        uint64_t    overBudget;
+
+        Seconds     total;
+        Seconds     max;
+        Seconds     avg;
+    };
+
+    /**
+     * @brief               时间片预算：一次切入运行超过 sec 的上下文被记为超时，每个上下文首次超时打印警告
+     *                      上下文不让出时调度器无法打断它，autoYield 为 true 时在 checkpoint() 处自动让出
+     * @param sec           小于等于 0 表示不检查
+     */
+    void    setSliceBudget(const Seconds &sec, bool autoYield = false);
+    Seconds getSliceBudget();
+
+    /**
+     * @brief               时间片统计，可在任意线程调用
+     */
+    SliceStats      getSliceStats();
+    void            resetSliceStats();
+
 private:
     Coroutine(const char *name = "SpaE::Co");
     ~Coroutine();
 
     void    run();
 
+    /**
+     * @brief               将挂起的上下文转交给 target，在本协程线程调用
+     */
+    void    migrateHelper(Context *ctx, Coroutine *target);
+
+    // 睡眠定时器小根堆，仅协程线程访问
+    void    timerPush(Context *ctx);
+    void    timerRemove(Context *ctx);
+    void    timerSwap(int a, int b);
+    void    timerSiftUp(int i);
+    void    timerSiftDown(int i);
+
+    /**
+     * @brief               唤醒到期的上下文
+     * @return              距离下一个定时器到期的时间，小于 0 表示没有定时器
+     */
+    Seconds     timerProcess();
+
+    /**
+     * @brief               记录一次时间片，在上下文切出后调用
+     */
+    void        sliceRecord(Context *ctx, const Seconds &elapsed);
+
 private:
     Loop    *m_loop;
 
@@ -128,7 +617,20 @@ private:
 
     std::multimap<Loop::Priority, SharedContext>        m_runningContextMap;
 
-    std::unordered_set<SharedContext>       m_sharedContextSet;
+    std::vector<Context *>      m_timerHeap;
+
+    // 属于本协程且尚未结束的上下文，各持有一个引用, m_mutex 保护
+    Context     *m_contextList = nullptr;
+
+    std::atomic<int>    m_workSetSize { 0 };
+
+    std::atomic<double> m_sliceBudget { 0 };
+    std::atomic<bool>   m_sliceAutoYield { false };
+
+    // m_sliceMutex 保护
+    SliceStats      m_sliceStats {};
+
+    SpinMutex       m_sliceMutex;
 
     bool        m_terminate = false;
 
@@ -151,4 +653,13 @@ namespace std
             return o.id;
         }
     };
+
+    template<>
+    struct hash<SpaE::SharedContext>
+    {
+        size_t operator () (const SpaE::SharedContext &o) const
+        {
+            return (size_t) o.get();
+        }
+    };
 };
@@ -37,8 +37,8 @@ public:
     static void         setStackSize(int size);
     static int          getStackSize();
 
-    static ContextInfo      coroutineWork(const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0);
-    static ContextInfo      coroutineWork(Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0);
+    static ContextInfo      coroutineWork(const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+    static ContextInfo      coroutineWork(Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
     static void             loopWork(const Loop::WorkFun &f, const Loop::Priority &pri = 0);
     static void             loopWork(Loop::WorkFun &&f, const Loop::Priority &pri = 0);
 };
@@ -0,0 +1,142 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include "coroutine.h"
+
+namespace SpaE
+{
+
+/**
+ * 协程同步原语
+ * 在协程中等待时只挂起当前 Context，由 Coroutine::resume() 唤醒，不阻塞协程线程；
+ * 在普通线程中等待时退化为信号量阻塞。唤醒可以来自任意线程。
+ * 带超时的等待（waitFor）在所在上下文被取消时按超时返回。
+ */
+
+class CoMutex
+{
+public:
+    CoMutex() = default;
+
+    CoMutex(const CoMutex &) = delete;
+    CoMutex& operator= (const CoMutex&) = delete;
+
+    void        lock();
+    bool        tryLock();
+    void        unlock();
+
+    // std::unique_lock 兼容
+    bool        try_lock() { return tryLock(); }
+
+private:
+    SpinMutex       m_mutex;
+
+    bool            m_locked = false;
+
+    CoWaitQueue     m_waitQueue;
+};
+
+class CoSemaphore
+{
+public:
+    CoSemaphore(int value = 0);
+
+    CoSemaphore(const CoSemaphore &) = delete;
+    CoSemaphore& operator= (const CoSemaphore&) = delete;
+
+    void        wait();
+    bool        waitFor(const Seconds &sec);
+    bool        tryWait();
+    void        post();
+
+private:
+    SpinMutex       m_mutex;
+
+    int             m_value;
+
+    CoWaitQueue     m_waitQueue;
+};
+
+class CoConditionVariable
+{
+public:
+    CoConditionVariable() = default;
+
+    CoConditionVariable(const CoConditionVariable &) = delete;
+    CoConditionVariable& operator= (const CoConditionVariable&) = delete;
+
+    /**
+     * @brief               释放 mutex 并等待通知，返回前重新获取 mutex
+     * @param mutex         调用者已持有的 CoMutex
+     */
+    void        wait(CoMutex &mutex);
+
+    /**
+     * @return              false 表示超时
+     */
+    bool        waitFor(CoMutex &mutex, const Seconds &sec);
+
+    template<typename Predicate>
+    void        wait(CoMutex &mutex, Predicate pred)
+    {
+        while (! pred()) {
+            wait(mutex);
+        }
+    }
+
+    void        notifyOne();
+    void        notifyAll();
+
+private:
+    SpinMutex       m_mutex;
+
+    CoWaitQueue     m_waitQueue;
+};
+
+class CoEvent
+{
+public:
+    /**
+     * @param autoReset     true 时每次 set 只唤醒一个等待者并自动复位
+     */
+    CoEvent(bool autoReset = false);
+
+    CoEvent(const CoEvent &) = delete;
+    CoEvent& operator= (const CoEvent&) = delete;
+
+    void        set();
+    void        reset();
+    bool        isSet();
+
+    void        wait();
+    bool        waitFor(const Seconds &sec);
+
+private:
+    SpinMutex       m_mutex;
+
+    bool            m_set = false;
+    bool            m_autoReset;
+
+    CoWaitQueue     m_waitQueue;
+};
+
+};
@@ -0,0 +1,118 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fd_operator.h"
+
+namespace SpaE
+{
+
+/**
+ * 一个路径级的事件，path 为发生变化的完整路径，mask 同 inotify（含 IN_ISDIR）
+ */
+struct DirectoryEvent
+{
+    std::string path;
+
+    uint32_t    mask = 0;
+};
+
+using DirectoryEventBatch = std::shared_ptr<const std::vector<DirectoryEvent>>;
+
+/**
+ * 递归关注目录树：遍历一次，所有目录的关注都加在同一个 inotify fd 上；
+ * 新建或移入的子目录自动加入关注，删除或移出的子目录自动移除。
+ * 事件在 DirectoryWatcher 所在的事件循环中转换为完整路径，每批 emit 一次 signalEvents
+ */
+class DirectoryWatcher : public Object
+{
+public:
+    /**
+     * @param isolate       同 FdOperator::inotifyWatch，非 isolate 时使用进程共享的 inotify 实例
+     */
+    explicit DirectoryWatcher(int isolate = FdOperator::IsolateNone);
+    ~DirectoryWatcher();
+
+    /**
+     * @brief               关注 root 及其下所有目录，可多次调用关注多棵树
+     * @param mask          需要通知的事件，维护目录树所需的 IN_CREATE / IN_MOVED_FROM / IN_MOVED_TO 总是被关注，
+     *                      但只有包含在 mask 中时才通知
+     * @return              false 表示 root 无法关注，errno 为原因；子目录关注失败（如超出 max_user_watches）计入 getErrorCount
+     */
+    bool watch(const char *root, uint32_t mask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO);
+
+    /**
+     * @brief               合并窗口，见 FdOperator::setInotifyCoalesce
+     */
+    void setCoalesce(double sec);
+
+    size_t  getWatchCount();
+    size_t  getErrorCount();
+
+    void close();
+
+signals:
+    // 新建子目录时，关注生效之前已在其中创建的文件和目录以 IN_CREATE 补发（可能与实际事件重复）；
+    // inotify 队列溢出时 emit 一个 path 为空、mask 为 IN_Q_OVERFLOW 的事件，需要重新扫描
+    Signal<DirectoryEventBatch>     signalEvents;
+
+private:
+    // 以下持有 m_mutex 时调用
+
+    // 遍历 dir 并加入关注，created 不为 nullptr 时补发其中已有的条目；dir 本身无法关注时返回 false
+    bool addTree(const std::string &dir, std::vector<DirectoryEvent> *created);
+
+    void removeTree(const std::string &dir);
+
+    // 树内改名，内核中的关注跟随 inode，只需更新路径
+    void renameTree(const std::string &from, const std::string &to);
+
+    void onEvents(InotifyBatch events);
+
+private:
+    int     m_isolate;
+
+    FdOperator  *m_notifier = nullptr;
+
+    uint32_t    m_mask = 0;
+
+    double      m_coalesce = 0;
+
+    std::unordered_map<int, std::string>    m_wdPaths;
+    std::unordered_map<std::string, int>    m_pathWds;
+
+    size_t      m_errors = 0;
+
+    // 遍历大目录树时持有较久，不使用自旋锁
+    std::mutex  m_mutex;
+};
+
+};
+
+#endif
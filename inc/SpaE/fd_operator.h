@@ -20,22 +20,77 @@
 
 #ifdef __linux__
 
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <string.h>
 
 #include <fcntl.h>
 #include <sys/epoll.h>
 #include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "connector.h"
+#include "buffer.h"
 
 namespace SpaE
 {
 
+struct AsyncWaiter;
+
+/**
+ * 一个数据报，addrLen 为 0 表示没有地址（已连接的 socket）
+ */
+struct Datagram
+{
+    BufferRef       buf;
+
+    struct sockaddr_storage     addr;
+    socklen_t       addrLen = 0;
+};
+
+using DatagramBatch = std::shared_ptr<const std::vector<Datagram>>;
+
+/**
+ * 一个 inotify 事件，name 为目录中发生变化的文件名，关注的是文件本身时为空
+ */
+struct InotifyEvent
+{
+    int         wd = -1;
+
+    uint32_t    mask = 0;
+    uint32_t    cookie = 0;
+
+    std::string name;
+};
+
+using InotifyBatch = std::shared_ptr<const std::vector<InotifyEvent>>;
+
+struct FdIoState;
+
+struct ReactorShard;
+
+struct FdWatchRecord;
+
 class FdOperator : public Object
 {
 public:
+    /**
+     * 各 watch 接口的 isolate 参数
+     * IsolateNone         所有 fd 共用一个 epoll 线程
+     * IsolateShard        放到独立反应器分片池中，每个分片一个 epoll 线程，承载多个 fd
+     * IsolateDedicated    独占一个分片（一个线程），用于对延迟敏感的 fd
+     * 兼容旧接口，true 等同于 IsolateShard
+     */
+    enum IsolateMode {
+        IsolateNone = 0,
+        IsolateShard = 1,
+        IsolateDedicated = 2,
+    };
 
 public:
     FdOperator(int fd, const char *path);
@@ -46,16 +101,198 @@ public:
     virtual int write(const void *buf, size_t len);
     virtual int read(void *buf, size_t len);
 
+    /**
+     * @brief               协程感知的读写，fd 会被设置为非阻塞。
+     *                      遇到 EAGAIN 时在 epoll 上登记关注并挂起当前协程，就绪后恢复重试；
+     *                      不在协程中调用时退化为 poll 阻塞等待。
+     * @return              同 ::read / ::write
+     */
+    int readAsync(void *buf, size_t len);
+    int writeAsync(const void *buf, size_t len);
+
+    /**
+     * @brief               协程感知的分散读 / 聚集写，语义同 readAsync / writeAsync
+     */
+    int readvAsync(const struct iovec *iov, int count);
+    int writevAsync(const struct iovec *iov, int count);
+
+    /**
+     * @brief               协程感知的零拷贝转发，把本 fd 的数据 splice 到 out，数据不经过用户态。
+     *                      两端都不是管道时经过内部管道中转；直到转发 len 字节或读到 EOF 才返回
+     * @return              转发的字节数，出错且未转发任何数据时返回 -1
+     */
+    ssize_t spliceTo(FdOperator *out, size_t len);
+
+    /**
+     * @brief               协程感知的 tee，把本管道中的数据复制到管道 out，不消耗本管道的数据
+     *                      两端都必须是管道，复制到数据即返回
+     * @return              同 ::tee
+     */
+    ssize_t teeTo(FdOperator *out, size_t len);
+
+    /**
+     * @brief               协程感知的 sendfile，从文件 file 的 offset 处发送 len 字节到本 fd
+     * @return              发送的字节数，文件提前结束时小于 len，出错且未发送任何数据时返回 -1
+     */
+    ssize_t sendFileFrom(FdOperator *file, off_t offset, size_t len);
+
+    /**
+     * @brief               协程感知的 accept，返回新连接的 fd，失败返回 -1
+     */
+    int acceptAsync(struct sockaddr *addr = nullptr, socklen_t *addrLen = nullptr);
+
+    /**
+     * @brief               协程感知的 connect，成功返回 0，失败返回 -1 并设置 errno
+     */
+    int connectAsync(const struct sockaddr *addr, socklen_t addrLen);
+
+    /**
+     * @brief               等待 fd 就绪，协程中挂起当前上下文，否则阻塞线程
+     * @param events        EPOLLIN / EPOLLOUT
+     * @return              false 表示等待失败，或 close 被调用、所在上下文被取消（errno 为 ECANCELED）
+     */
+    bool waitReady(int events);
+
+    /**
+     * @brief               fd 就绪（或关闭）时调用一次 f，不挂起。f 在 SpaE::FdA 线程中执行，
+     *                      同一方向可登记多个等待者，就绪时全部唤醒。因关闭而调用时 fd 尚未关闭，isClosed() 为 true，f 不应再读写 fd
+     * @param events        EPOLLIN / EPOLLOUT
+     * @return              false 表示 fd 已关闭或登记失败，f 不会被调用
+     */
+    bool notifyReady(int events, Loop::WorkFun &&f);
+
+    /**
+     * @brief               提交一次异步读，完成后 emit signalReadDone(buffer, n)，n 为 0 表示 EOF，小于 0 为 -errno
+     *                      内核支持 io_uring 时由 io_uring 完成，同一轮事件中提交的请求只需一次系统调用；
+     *                      否则退化为 epoll 就绪后在 SpaE::FdA 线程中读取。
+     *                      同一 fd 上的读请求依次执行，可在任意线程调用
+     * @param len           读缓冲大小，缓冲从 Buffer 池中分配
+     * @return              false 表示 fd 已关闭
+     */
+    bool readSubmit(size_t len = 4096);
+
+    /**
+     * @brief               提交一次异步写，全部写完或出错后 emit signalWriteDone(n)，n 小于 0 为 -errno
+     *                      数据被拷贝到池化缓冲中，调用后即可释放；同一 fd 上的写请求按提交顺序执行
+     * @return              false 表示 fd 已关闭
+     */
+    bool writeSubmit(const void *buf, size_t len);
+    bool writeSubmit(const BufferRef &buf);
+
+    /**
+     * @brief               是否使用 io_uring，默认在内核支持时使用。只影响之后开始执行的请求
+     */
+    static void setUringEnabled(bool sta);
+    static bool isUringAvailable();
+
+    /**
+     * @brief               缓冲写，数据追加到 fd 的写缓冲链后立即返回，不阻塞调用线程。
+     *                      链为空时直接 writev，内核缓冲满（EAGAIN）时才在 epoll 上关注 EPOLLOUT，
+     *                      可写后在 SpaE::FdA 线程中继续写出；写缓冲清空时 emit signalDrained()，
+     *                      积压越过高水位时 emit signalHighWatermark(size)，清空前只通知一次。
+     *                      出错时丢弃积压数据并 emit signalWriteDone(-errno)，之后的缓冲写返回 false。
+     *                      小块数据拷贝进链尾缓冲合并写出，BufferRef 版本不拷贝，写出前不能再修改
+     * @return              false 表示 fd 已关闭或出错
+     */
+    bool writeBuffered(const void *buf, size_t len);
+    bool writeBuffered(const BufferRef &buf);
+
+    /**
+     * @brief               缓冲写的高水位，默认 1MB
+     */
+    void setWriteHighWatermark(size_t bytes);
+
+    /**
+     * @brief               缓冲写尚未写出的字节数
+     */
+    size_t getPendingWriteSize();
+
+    void setNonBlock(bool sta);
+
     void configSerial();
 
     int getFd();
+
+    bool isClosed();
+
+    /**
+     * @brief               使用共享 inotify 实例时返回共享的 fd，不要自行读取或关闭
+     */
     int getInotifyFd();
 
-    void epollWatch(int flags, bool isolate = false);
-    void inotifyWatch(int flags, bool isolate = false);
+    /**
+     * @brief               isolate 模式的反应器分片池：最多 shards 个共享分片，每个分片承载 fdsPerShard 个 fd，
+     *                      最空的分片也满了时新建分片，达到上限后放到最空的分片上。
+     *                      分片上的 fd 全部关闭后分片线程退出并被 join。默认 4 个分片，每个 64 个 fd
+     */
+    static void setIsolatePool(int shards, int fdsPerShard);
+
+    /**
+     * @brief               当前存在的分片数量（含独占分片）
+     */
+    static int getIsolateShardCount();
+
+    void epollWatch(int flags, int isolate = IsolateNone);
+
+    /**
+     * @brief               数据模式：fd 被设置为非阻塞并以边沿触发关注，由 epoll 线程把 fd 读空，
+     *                      每块数据 emit 一次 signalData(buffer)，接收者不需要再调用 read；
+     *                      EOF 或出错时 emit 一次空 buffer，之后不再关注
+     * @param bufSize       每块缓冲的大小，缓冲从 Buffer 池中分配
+     */
+    void dataWatch(size_t bufSize = 4096, int isolate = IsolateNone);
 
+    /**
+     * @brief               数据报模式：fd 被设置为非阻塞并以边沿触发关注，由 epoll 线程用 recvmmsg
+     *                      一次收取最多 batch 个数据报，每批 emit 一次 signalDatagrams(batch)。
+     *                      接收缓冲预先分配并循环复用，接收者释放后即可被之后的批次使用
+     * @param bufSize       单个数据报的最大长度，超出部分被截断
+     */
+    void datagramWatch(int batch = 64, size_t bufSize = 2048, int isolate = IsolateNone);
+
+    /**
+     * @brief               sendmmsg 批量发送，一次系统调用发送多个数据报
+     * @return              发送的数据报数量，一个都没有发送时返回 -1
+     */
+    int sendBatch(const std::vector<Datagram> &msgs);
+
+    /**
+     * @brief               关注 m_path。非 isolate 时使用进程共享的 inotify 实例，所有对象的关注都在一个 fd 上，
+     *                      isolate 时在反应器分片上使用自己的 inotify fd。
+     *                      每次读取到的事件 emit 一次 signalInotifyEvents(batch)，同时每个事件 emit 一次 signalInotifyWatch(mask)
+     */
+    void inotifyWatch(int flags, int isolate = IsolateNone);
+
+    /**
+     * @brief               追加关注 path，事件同样通过 signalInotifyEvents 通知，用 wd 区分。
+     *                      尚未调用 inotifyWatch 时使用共享实例
+     * @return              wd，失败返回 -1
+     */
+    int inotifyAdd(const char *path, uint32_t mask);
+    bool inotifyRemove(int wd);
+
+    /**
+     * @brief               共享实例上的事件合并窗口：第一个事件到达后 sec 秒内，同一 (wd, name) 的事件合并为一条
+     *                      （mask 按位或），窗口结束时一起 emit。0 表示不合并（默认），isolate 模式不合并
+     */
+    void setInotifyCoalesce(double sec);
+
+    /**
+     * @brief               关闭 fd 并 emit signalClosed，可重复调用（析构时也会调用），只有第一次生效
+     */
     virtual void close();
 
+private:
+    bool armAsyncWaiter(int events, AsyncWaiter &&w);
+
+    // 协程异步读写等待者的记录，首次等待时创建
+    std::shared_ptr<FdWatchRecord> getAsyncRecord();
+    std::shared_ptr<FdWatchRecord> getAsyncRecordLocked();
+
+    std::shared_ptr<FdIoState> getIoState();
+
+    void epollWatchHelper(int flags, size_t drainSize, int batch, int isolate);
+
 signals:
     Signal<>        signalClosed;
 
@@ -63,14 +300,52 @@ signals:
     Signal<int>     signalEpollWatch;
     Signal<int>     signalInotifyWatch;
 
+    // inotify 的一批事件
+    Signal<InotifyBatch>    signalInotifyEvents;
+
+    // dataWatch 读到的数据，空 buffer 表示 EOF
+    Signal<BufferRef>   signalData;
+
+    // datagramWatch 收到的一批数据报
+    Signal<DatagramBatch>   signalDatagrams;
+
+    // readSubmit / writeSubmit 的完成
+    Signal<BufferRef, int>      signalReadDone;
+    Signal<int>                 signalWriteDone;
+
+    // writeBuffered 的背压通知
+    Signal<>        signalDrained;
+    Signal<size_t>  signalHighWatermark;
+
 protected:
     int m_fd = -1;
 
     std::string m_path = "";
 
-    int m_watchEpollFd = -1;
     int m_watchInotifyFd = -1;
-    int m_watchInotifyEpollFd = -1;
+
+    // epollWatch / inotifyWatch 的登记记录，关闭时交给回收
+    FdWatchRecord   *m_watchRecord = nullptr;
+    FdWatchRecord   *m_watchInotifyRecord = nullptr;
+
+    // isolate 模式所在的反应器分片
+    ReactorShard    *m_watchShard = nullptr;
+    ReactorShard    *m_watchInotifyShard = nullptr;
+
+    double  m_inotifyCoalesce = 0;
+
+    bool m_nonBlock = false;
+
+    // close 已被调用，挂起的 readAsync / writeAsync 等以 ECANCELED 返回
+    std::atomic<bool>   m_closed { false };
+
+    // readSubmit / writeSubmit / writeBuffered 的状态，首次提交时创建
+    std::shared_ptr<FdIoState>  m_ioState;
+
+    std::shared_ptr<FdWatchRecord>  m_asyncRecord;
+
+    // 保护 m_ioState 与 m_asyncRecord
+    SpinMutex   m_ioStateMutex;
 };
 
 };
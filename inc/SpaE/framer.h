@@ -0,0 +1,184 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "fd_operator.h"
+
+namespace SpaE
+{
+
+/**
+ * 一帧数据，指向 buf 中 [offset, offset + len)，不含分隔符 / 长度头
+ */
+struct Frame
+{
+    BufferRef   buf;
+
+    uint32_t    offset = 0;
+    uint32_t    len = 0;
+
+    const char  *data() const
+    {
+        return buf.data() + offset;
+    }
+
+    size_t  size() const
+    {
+        return len;
+    }
+};
+
+using FrameBatch = std::shared_ptr<const std::vector<Frame>>;
+
+/**
+ * 流分帧：接收 FdOperator::signalData 的数据块（或 feed），切分出完整的帧，每个数据块 emit 一次 signalFrames(batch)。
+ * 完整落在一个数据块中的帧直接引用该块，跨块的帧或需要解码的帧才拷贝。
+ * 未完成的帧以缓冲链保存：大部分是有效数据的块直接引用，零碎的尾部拷贝到可增长的缓冲中，占用的内存与缓存的数据量成正比
+ */
+class Framer : public Object
+{
+public:
+    /**
+     * Line             以 '\n' 分隔，去掉行尾的 '\r'
+     * Delimiter        以 setDelimiter 设置的字节分隔
+     * LengthPrefixed   长度头（setLengthPrefix）+ 数据，长度不含头
+     * Slip             RFC 1055，忽略空帧
+     * Cobs             以 0 分隔的 COBS 编码，解码后输出，总是拷贝，忽略连续分隔符之间的空帧
+     */
+    enum Mode {
+        Line,
+        Delimiter,
+        LengthPrefixed,
+        Slip,
+        Cobs,
+    };
+
+    explicit Framer(Mode mode = Line);
+
+    void    setDelimiter(char c);
+
+    /**
+     * @param bytes         长度头的字节数，1 / 2 / 4
+     */
+    void    setLengthPrefix(int bytes, bool bigEndian = true);
+
+    /**
+     * @brief               帧长上限，默认 64KB。分隔模式下超出的帧被丢弃直到下一个分隔符；
+     *                      长度头模式下认为流已错位，丢弃所有已缓存的数据。两者都 emit signalOverflow
+     */
+    void    setMaxFrameSize(size_t bytes);
+
+    /**
+     * @brief               分隔符查找使用逐字节的实现，用于对比测试
+     */
+    void    setScalarScan(bool sta);
+
+    /**
+     * @brief               接收 o 的 signalData，需要之后调用 o->dataWatch()；EOF 时 emit signalEnd
+     */
+    void    attach(FdOperator *o);
+
+    void    feed(const BufferRef &buf);
+
+    /**
+     * @brief               丢弃未完成的帧
+     */
+    void    reset();
+
+    /**
+     * @brief               按当前模式编码一帧，用于发送
+     */
+    BufferRef   encode(const void *data, size_t len);
+
+    /**
+     * @brief               查找 c 第一次出现的位置，没有时返回 len。运行时选择 AVX2 / SSE2，ARM 上使用 NEON，否则逐字节
+     */
+    static size_t   find(const char *p, size_t len, char c);
+    static size_t   findScalar(const char *p, size_t len, char c);
+
+    /**
+     * @brief               find 使用的实现："avx2" / "sse2" / "neon" / "scalar"
+     */
+    static const char   *getScanImpl();
+
+    /**
+     * @brief               未完成的帧占住的缓冲容量
+     */
+    size_t  getPendingCapacity();
+
+signals:
+    Signal<FrameBatch>  signalFrames;
+
+    Signal<size_t>      signalOverflow;
+
+    Signal<>            signalEnd;
+
+private:
+    void    feedDelimited(const BufferRef &buf);
+    void    feedLengthPrefixed(const BufferRef &buf);
+
+    // 完整的帧在 buf 中，需要解码时拷贝
+    void    addFrame(const BufferRef &buf, size_t offset, size_t len, std::vector<Frame> &out);
+
+    // 缓冲链中未完成的部分与 buf 的前 len 字节拼成一帧
+    BufferRef   joinPending(const BufferRef &buf, size_t len);
+
+    size_t  scan(const char *p, size_t len, char c);
+
+    void    pushPending(const BufferRef &buf, size_t offset);
+
+    // 从缓冲链和 buf 中取长度头，不足时返回 false
+    bool    peekLength(const BufferRef &buf, size_t &len);
+
+private:
+    Mode    m_mode;
+
+    char    m_delimiter = '\n';
+
+    int     m_prefixBytes = 4;
+    bool    m_bigEndian = true;
+
+    size_t  m_maxFrameSize = 64 * 1024;
+
+    bool    m_scalar = false;
+
+    // 未完成的帧：第一块从 m_pendingOffset 开始
+    std::deque<BufferRef>   m_pending;
+
+    size_t  m_pendingOffset = 0;
+    size_t  m_pendingSize = 0;
+
+    // 链尾是自己拷贝出来的缓冲，可以继续追加
+    bool    m_pendingTailOwned = false;
+
+    // 分隔模式下超长帧被丢弃，直到下一个分隔符
+    bool    m_discarding = false;
+};
+
+};
+
+#endif
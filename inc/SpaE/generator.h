@@ -0,0 +1,251 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <iterator>
+
+namespace SpaE
+{
+
+struct GeneratorEntry;
+
+/**
+ * 生成器的非模板部分：独立的栈与上下文切换
+ * 消费者与生产者之间直接切换栈，不经过 Loop 队列，也不分配内存（栈除外）
+ */
+class GeneratorBase
+{
+public:
+    GeneratorBase(const GeneratorBase &) = delete;
+    GeneratorBase& operator= (const GeneratorBase&) = delete;
+
+    bool    finished()
+    {
+        return m_finished;
+    }
+
+protected:
+    /**
+     * @param stackSize     生产者栈大小
+     */
+    GeneratorBase(int stackSize);
+
+    virtual ~GeneratorBase();
+
+    /**
+     * @brief               未结束时切回生产者并在其 yield 处抛出异常展开栈，保证栈上对象被析构
+     *                      派生类需在析构函数中先调用，此时生产者函数对象仍然有效
+     */
+    void    stop();
+
+    /**
+     * @brief               切换到生产者，直到它产出下一个值或结束，仅消费者调用
+     *                      生产者抛出的异常在此重新抛出
+     * @return              false 表示生产者已结束
+     */
+    bool    resume();
+
+    /**
+     * @brief               产出 value 并切回消费者，仅生产者调用
+     *                      value 在消费者下一次 resume 之前有效
+     */
+    void    suspend(const void *value);
+
+    virtual void    body() = 0;
+
+protected:
+    const void      *m_value = nullptr;
+
+private:
+    friend struct GeneratorEntry;
+
+    // stop() 时用于展开生产者的栈，不应被生产者吞掉
+    struct Stop {};
+
+private:
+    char        *m_stack = nullptr;
+    int         m_stackSize;
+
+    // 生产者和消费者各自挂起的位置
+    void        *m_producerRef = nullptr;
+    void        *m_consumerRef = nullptr;
+
+    bool        m_started = false;
+    bool        m_finished = false;
+    bool        m_stopping = false;
+
+    std::exception_ptr      m_exception;
+};
+
+/**
+ * 生成器：生产者运行在自己的栈上，yield(value) 把值交给消费者，消费者用 range-for 迭代
+ *
+ *  Generator<int> gen([] (Generator<int>::Yield &yield) {
+ *      for (int i = 0; i < 10; i ++) {
+ *          yield(i);
+ *      }
+ *  });
+ *
+ *  for (auto &v: gen) { ... }
+ *
+ * yield 不复制值，消费者拿到的引用在取下一个值之前有效。
+ * 生产者惰性启动，只能在创建它的线程上迭代；生产者中可以迭代其他生成器，形成流水线。
+ * 在协程中使用时，生产者也可以挂起所在的协程上下文（如等待 IO）。
+ */
+template<typename T>
+class Generator : public GeneratorBase
+{
+public:
+    class Yield
+    {
+    public:
+        void operator () (const T &value)
+        {
+            m_gen->suspend(&value);
+        }
+
+    private:
+        friend class Generator;
+
+        Yield(Generator *gen) : m_gen(gen)
+        {
+
+        }
+
+        Generator   *m_gen;
+    };
+
+    using Producer = std::function<void (Yield &)>;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        iterator() = default;
+
+        reference operator * () const
+        {
+            return * (const T *) m_gen->m_value;
+        }
+
+        pointer operator -> () const
+        {
+            return (const T *) m_gen->m_value;
+        }
+
+        iterator &operator ++ ()
+        {
+            if (! m_gen->resume()) {
+                m_gen = nullptr;
+            }
+
+            return *this;
+        }
+
+        void operator ++ (int)
+        {
+            ++ *this;
+        }
+
+        bool operator == (const iterator &other) const
+        {
+            return m_gen == other.m_gen;
+        }
+
+        bool operator != (const iterator &other) const
+        {
+            return m_gen != other.m_gen;
+        }
+
+    private:
+        friend class Generator;
+
+        iterator(Generator *gen) : m_gen(gen)
+        {
+
+        }
+
+        Generator   *m_gen = nullptr;
+    };
+
+    Generator(Producer &&producer, int stackSize = 64 * 1024) :
+        GeneratorBase(stackSize), m_producer(std::move(producer))
+    {
+
+    }
+
+    Generator(const Producer &producer, int stackSize = 64 * 1024) :
+        GeneratorBase(stackSize), m_producer(producer)
+    {
+
+    }
+
+    ~Generator()
+    {
+        stop();
+    }
+
+    /**
+     * @brief               取下一个值
+     * @return              nullptr 表示生产者已结束
+     */
+    const T *next()
+    {
+        if (! resume()) {
+            return nullptr;
+        }
+
+        return (const T *) m_value;
+    }
+
+    /**
+     * @brief               开始迭代，只能调用一次
+     */
+    iterator begin()
+    {
+        iterator    it(this);
+
+        return ++ it;
+    }
+
+    iterator end()
+    {
+        return iterator();
+    }
+
+protected:
+    void body() override
+    {
+        Yield   yield(this);
+
+        m_producer(yield);
+    }
+
+private:
+    Producer        m_producer;
+};
+
+};
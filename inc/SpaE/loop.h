@@ -183,6 +183,13 @@ public:
      */
     void waitProcess();
 
+    /**
+     * @brief               手动等待并执行事件，最多等待 sec 秒
+     *                      警告！！！将会阻塞线程
+     * @return              false 表示超时，没有执行事件
+     */
+    bool waitProcessFor(double sec);
+
     /**
      * @brief               获取线程的名字
      */
@@ -196,6 +203,11 @@ public:
      **/
     static Loop *getCurrentLoop();
 
+    /**
+     * @brief               当前线程是否为某个事件循环的线程，不是时 getCurrentLoop 返回默认实例
+     **/
+    static bool isLoopThread();
+
     static Loop *getInstance();
 
     static Loop *newInstance(const char *name = nullptr);
@@ -51,8 +51,16 @@ public:
 
     void bindContainer(Object *o, Loop *loop);
 
+    /**
+     * @brief               是否已绑定到容器对象（首次 connect 时绑定）
+     */
+    bool isBound()
+    {
+        return m_loop != nullptr;
+    }
+
 protected:
-    Loop                *m_loop;
+    Loop                *m_loop = nullptr;
 
     SharedAliveMutex    m_containerAlive;
 };
@@ -0,0 +1,218 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fd_operator.h"
+
+namespace SpaE
+{
+
+/**
+ * TCP 连接，读写使用 FdOperator 的接口（readAsync / writeBuffered / dataWatch 等）
+ */
+class TcpSocket : public FdOperator
+{
+public:
+    friend class TcpServer;
+
+    /**
+     * @brief               创建未连接的 IPv4 socket，之后调用 connectTo
+     */
+    TcpSocket();
+
+    /**
+     * @brief               接管已连接的 fd
+     */
+    explicit TcpSocket(int fd);
+
+    ~TcpSocket();
+
+    /**
+     * @brief               协程感知的连接，不在协程中调用时阻塞等待
+     * @param host          IPv4 点分地址
+     * @return              false 表示失败，errno 为原因
+     */
+    bool connectTo(const char *host, uint16_t port);
+
+    bool setNoDelay(bool sta);
+
+    std::string getPeerAddress();
+    uint16_t    getPeerPort();
+
+    void close() override;
+
+private:
+    void releaseLoad();
+
+private:
+    // 所在连接循环的连接数，由 TcpServer 设置，关闭时减一
+    std::shared_ptr<std::atomic<int>>   m_load;
+};
+
+/**
+ * TCP 监听，可以用 SO_REUSEPORT 在多个事件循环上各建一个监听 fd，由内核分配新连接；
+ * 每次就绪都 accept 到 EAGAIN，新连接放到连接数最少的连接循环上
+ */
+class TcpServer : public Object
+{
+public:
+    TcpServer();
+    ~TcpServer();
+
+    /**
+     * @param host          IPv4 点分地址，nullptr 表示 INADDR_ANY
+     * @param port          0 表示由系统分配，用 getPort 获取
+     * @param acceptLoops   每个事件循环一个监听 fd（多于一个时使用 SO_REUSEPORT），
+     *                      accept 在对应循环中执行；为空时只在当前循环监听
+     * @return              false 表示失败，errno 为原因；已在监听时返回 false，errno 为 EBUSY，需先 close
+     */
+    bool listen(const char *host, uint16_t port, const std::vector<Loop *> &acceptLoops = {}, int backlog = 128);
+
+    /**
+     * @brief               新连接所在的事件循环，每个连接放到当前连接数最少的循环上。
+     *                      未设置时留在 accept 所在的循环。需在 listen 之前调用
+     */
+    void setConnectionLoops(const std::vector<Loop *> &loops);
+
+    /**
+     * @brief               各连接循环当前的连接数，顺序同 setConnectionLoops
+     */
+    std::vector<int>    getConnectionCounts();
+
+    uint16_t    getPort();
+
+    void close();
+
+signals:
+    // 新连接，对象已移到所在的连接循环，由接收者负责 delete
+    Signal<TcpSocket *>     signalNewConnection;
+
+private:
+    // 由监听槽函数和重试定时器共享，只在分片所在的循环中访问
+    struct ShardState {
+        bool        alive = true;
+
+        // 资源不足时已安排重试
+        bool        retrying = false;
+    };
+
+    struct Shard {
+        Loop        *loop;
+
+        FdOperator  *listener;
+
+        std::shared_ptr<ShardState>     state;
+    };
+
+    void acceptReady(FdOperator *listener, const std::shared_ptr<ShardState> &state);
+
+    Loop    *pickConnectionLoop(std::shared_ptr<std::atomic<int>> &load);
+
+private:
+    std::vector<Shard>      m_shards;
+
+    std::vector<Loop *>     m_connLoops;
+    std::vector<std::shared_ptr<std::atomic<int>>>  m_connLoads;
+
+    uint16_t    m_port = 0;
+};
+
+/**
+ * UDP socket
+ */
+class UdpSocket : public FdOperator
+{
+public:
+    UdpSocket();
+
+    /**
+     * @param host          IPv4 点分地址，nullptr 表示 INADDR_ANY
+     * @param port          0 表示由系统分配，用 getLocalPort 获取
+     */
+    bool bind(const char *host, uint16_t port);
+
+    uint16_t    getLocalPort();
+
+    int sendTo(const void *buf, size_t len, const char *host, uint16_t port);
+
+    /**
+     * @brief               协程感知的接收，同 readAsync
+     * @param host, port    不为 nullptr 时返回发送方地址
+     */
+    int recvFrom(void *buf, size_t len, std::string *host = nullptr, uint16_t *port = nullptr);
+};
+
+/**
+ * Unix 域 socket，流式或数据报
+ */
+class UnixSocket : public FdOperator
+{
+public:
+    enum Type {
+        Stream,
+        Datagram,
+    };
+
+    explicit UnixSocket(Type type = Stream);
+
+    /**
+     * @brief               接管已有的 fd
+     */
+    UnixSocket(int fd, Type type);
+
+    /**
+     * @brief               绑定到 path，已存在的文件会先被删除
+     */
+    bool bind(const char *path);
+
+    bool listen(int backlog = 128);
+
+    /**
+     * @brief               协程感知的 accept，返回的连接由调用者负责 delete，失败返回 nullptr
+     */
+    UnixSocket  *accept();
+
+    /**
+     * @brief               协程感知的连接
+     */
+    bool connectTo(const char *path);
+
+    /**
+     * @brief               数据报模式下发送到 path
+     */
+    int sendTo(const void *buf, size_t len, const char *path);
+
+    Type    getType();
+
+private:
+    Type    m_type;
+};
+
+};
+
+#endif
@@ -0,0 +1,559 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+/**
+ * C++20 无栈协程前端
+ * 协程帧只有几百字节，适合大量 I/O 胶水逻辑；与 Coroutine（有栈）互不依赖。
+ * 需要 -std=c++20，低于 C++20 时本文件为空。
+ *
+ *  Task<int> f(FdOperator *fd)
+ *  {
+ *      co_await readable(fd);
+ *      co_await sleepFor(0.1);
+ *      auto [v] = co_await nextEmission(o, &o->signal2);
+ *      co_return v;
+ *  }
+ *
+ *  f(fd).start(loop);
+ */
+
+#if __cplusplus >= 202002L
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <tuple>
+
+#include "fd_operator.h"
+#include "timer.h"
+
+namespace SpaE
+{
+
+template<typename T = void>
+class Task;
+
+struct TaskPromiseBase
+{
+    // 等待本任务的协程，结束时恢复
+    std::coroutine_handle<>     continuation;
+
+    std::exception_ptr          exception;
+
+    // start() 之后任务没有所有者，结束时自行销毁
+    bool        detached = false;
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            auto &p = h.promise();
+
+            if (p.continuation) {
+                return p.continuation;
+            }
+
+            if (p.detached) {
+                h.destroy();
+            }
+
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+
+        }
+    };
+
+    // 惰性启动，被 co_await 或 start() 时才开始执行
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        exception = std::current_exception();
+    }
+};
+
+template<typename T>
+struct TaskPromise : public TaskPromiseBase
+{
+    std::optional<T>    value;
+
+    Task<T> get_return_object();
+
+    template<typename U>
+    void return_value(U &&v)
+    {
+        value.emplace(std::forward<U>(v));
+    }
+
+    T result()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+
+        return std::move(*value);
+    }
+};
+
+template<>
+struct TaskPromise<void> : public TaskPromiseBase
+{
+    Task<void> get_return_object();
+
+    void return_void()
+    {
+
+    }
+
+    void result()
+    {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+/**
+ * 可等待的任务，只能移动
+ * 在另一个 Task 中 co_await 时启动并在结束后恢复等待者（对称转移，不经过事件循环）；
+ * 不在协程中时用 start() 在指定事件循环中启动，结果被丢弃，异常被忽略。
+ */
+template<typename T>
+class Task
+{
+public:
+    using promise_type = TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    Task() = default;
+
+    explicit Task(Handle h) : m_handle(h)
+    {
+
+    }
+
+    Task(Task &&other) noexcept : m_handle(other.m_handle)
+    {
+        other.m_handle = nullptr;
+    }
+
+    Task &operator = (Task &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+
+            m_handle = other.m_handle;
+            other.m_handle = nullptr;
+        }
+
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task& operator= (const Task&) = delete;
+
+    ~Task()
+    {
+        reset();
+    }
+
+    /**
+     * @brief               在 loop 中启动任务，任务结束后自动释放
+     * @param loop          为 nullptr 时在当前线程立即执行到第一个挂起点
+     */
+    void start(Loop *loop = nullptr)
+    {
+        if (! m_handle) {
+            return;
+        }
+
+        auto h = m_handle;
+        m_handle = nullptr;
+
+        h.promise().detached = true;
+
+        if (loop) {
+            loop->work([h] { h.resume(); });
+        }
+        else {
+            h.resume();
+        }
+    }
+
+    bool done()
+    {
+        return ! m_handle || m_handle.done();
+    }
+
+    auto operator co_await () &&
+    {
+        struct Awaiter
+        {
+            Handle  h;
+
+            bool await_ready()
+            {
+                return ! h || h.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+            {
+                h.promise().continuation = caller;
+
+                return h;
+            }
+
+            T await_resume()
+            {
+                return h.promise().result();
+            }
+        };
+
+        return Awaiter { m_handle };
+    }
+
+private:
+    void reset()
+    {
+        if (m_handle) {
+            m_handle.destroy();
+            m_handle = nullptr;
+        }
+    }
+
+private:
+    Handle      m_handle = nullptr;
+};
+
+template<typename T>
+inline Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(Task<T>::Handle::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+
+// ################################################################
+
+/**
+ * co_await resumeOn(loop)：在 loop 中恢复执行
+ */
+struct LoopAwaiter
+{
+    Loop    *loop;
+
+    bool await_ready()
+    {
+        return loop == Loop::getCurrentLoop();
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        loop->work([h] { h.resume(); });
+    }
+
+    void await_resume()
+    {
+
+    }
+};
+
+inline LoopAwaiter resumeOn(Loop *loop)
+{
+    return LoopAwaiter { loop };
+}
+
+/**
+ * co_await sleepFor(sec)：经过 sec 秒后在当前事件循环中恢复
+ * 挂起中的 Task 可以销毁，定时器到期后不再恢复
+ */
+struct SleepAwaiter
+{
+    Seconds     sec;
+
+    // 任务销毁后，定时器回调不再恢复
+    std::shared_ptr<std::atomic<bool>>      alive;
+
+    ~SleepAwaiter()
+    {
+        if (alive) {
+            *alive = false;
+        }
+    }
+
+    bool await_ready()
+    {
+        return sec <= 0;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        alive = std::make_shared<std::atomic<bool>>(true);
+
+        // 定时器回调在创建它的事件循环中执行
+        setTimeout(sec,
+            [h, a = alive]
+            {
+                if (*a) {
+                    h.resume();
+                }
+            }
+        );
+    }
+
+    void await_resume()
+    {
+
+    }
+};
+
+inline SleepAwaiter sleepFor(const Seconds &sec)
+{
+    return SleepAwaiter { sec };
+}
+
+/**
+ * co_await nextEmission(sender, &sender->signal)：等待信号下一次发射，返回参数 tuple
+ * 在等待开始时所在的事件循环中恢复。发送者在发射前被销毁时不会恢复。
+ * 挂起中的 Task 可以销毁，等待者随之从信号中移除
+ */
+template<typename ... Args>
+struct SignalAwaiter : public SignalWaiter<Args ...>
+{
+    // 等待中 / 已被发射取走 / 已完成
+    enum State {
+        Waiting,
+        Claimed,
+        Completed,
+    };
+
+    Signal<Args ...>    *signal;
+
+    Loop        *loop = nullptr;
+
+    std::coroutine_handle<>     handle;
+
+    std::optional<std::tuple<std::decay_t<Args> ...>>       result;
+
+    std::atomic<int>    state { Waiting };
+
+    // 任务销毁后，已排队的恢复不再执行
+    std::shared_ptr<std::atomic<bool>>      alive;
+
+    explicit SignalAwaiter(Signal<Args ...> *s) : signal(s)
+    {
+
+    }
+
+    ~SignalAwaiter()
+    {
+        if (! handle || state.load(std::memory_order_acquire) == Completed) {
+            if (alive) {
+                *alive = false;
+            }
+            return;
+        }
+
+        this->unlink();
+
+        // 已被取走时 complete 随后会访问本节点，等它结束
+        while (state.load(std::memory_order_acquire) == Claimed) {
+            std::this_thread::yield();
+        }
+
+        *alive = false;
+    }
+
+    bool claim() override
+    {
+        int     expected = Waiting;
+
+        return state.compare_exchange_strong(expected, Claimed);
+    }
+
+    void complete(const Args &... args) override
+    {
+        result.emplace(args ...);
+
+        auto h = handle;
+        auto l = loop;
+        auto a = alive;
+
+        // 之后任务随时可能销毁，不能再访问 this
+        state.store(Completed, std::memory_order_release);
+
+        l->work(
+            [h, a]
+            {
+                if (*a) {
+                    h.resume();
+                }
+            }
+        );
+    }
+
+    // 发送者被销毁，不再恢复
+    void cancel() override
+    {
+        state.store(Completed, std::memory_order_release);
+    }
+
+    bool await_ready()
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        loop = Loop::getCurrentLoop();
+        handle = h;
+        alive = std::make_shared<std::atomic<bool>>(true);
+
+        signal->addWaiter(this);
+    }
+
+    std::tuple<std::decay_t<Args> ...> await_resume()
+    {
+        return std::move(*result);
+    }
+};
+
+template<typename SenderObject, typename ... Args>
+SignalAwaiter<Args ...> nextEmission(SenderObject *sender, Signal<Args ...> *signal)
+{
+    bindSignal(sender, signal);
+
+    return SignalAwaiter<Args ...>(signal);
+}
+
+/**
+ * co_await readable(fd) / writable(fd)：等待 fd 就绪，在等待开始时所在的事件循环中恢复
+ * 挂起中的 Task 可以销毁，之后就绪或关闭不再恢复
+ * @return              false 表示登记失败（如 fd 已关闭），或 fd 在等待中被关闭
+ */
+struct FdReadyAwaiter
+{
+    // 由就绪回调共享，任务销毁后仍然有效
+    struct State
+    {
+        std::atomic<bool>   alive { true };
+
+        // 因 close 而唤醒，在恢复之前写入
+        bool        closed = false;
+    };
+
+    FdOperator  *fd;
+
+    int         events;
+
+    bool        ok = true;
+
+    std::shared_ptr<State>      state;
+
+    ~FdReadyAwaiter()
+    {
+        if (state) {
+            state->alive = false;
+        }
+    }
+
+    bool await_ready()
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        auto loop = Loop::getCurrentLoop();
+
+        state = std::make_shared<State>();
+
+        // 登记成功后可能立即在其他线程恢复，不能再访问 this
+        if (! fd->notifyReady(events,
+            [loop, h, s = state, fd = fd]
+            {
+                // 因关闭而调用时 fd 尚未关闭，对象仍然有效
+                s->closed = fd->isClosed();
+
+                loop->work(
+                    [h, s]
+                    {
+                        if (s->alive) {
+                            h.resume();
+                        }
+                    }
+                );
+            }
+        )) {
+            ok = false;
+
+            // 登记失败时不挂起
+            return false;
+        }
+
+        return true;
+    }
+
+    bool await_resume()
+    {
+        return ok && ! state->closed;
+    }
+};
+
+inline FdReadyAwaiter readable(FdOperator *fd)
+{
+    fd->setNonBlock(true);
+
+    return FdReadyAwaiter { fd, EPOLLIN };
+}
+
+inline FdReadyAwaiter writable(FdOperator *fd)
+{
+    fd->setNonBlock(true);
+
+    return FdReadyAwaiter { fd, EPOLLOUT };
+}
+
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "coroutine_pool.h"
+
+namespace SpaE
+{
+
+/**
+ * 结构化并发任务组
+ * 子上下文结束时直接通知所属任务组，不经过 signal 连接；
+ * waitAll 只在最后一个子上下文结束时唤醒等待者一次。
+ *
+ * cancel 为协作式取消（Coroutine::cancel）：尚未开始运行的子上下文不再运行，其余子上下文在下一个挂起点
+ * （yield / yieldFor、带超时的等待、Channel 收发）提前返回，可用 Coroutine::isCancelled() 检查。
+ * 等待中的上下文自身被取消时，取消传递给组内所有子上下文，并继续等待它们结束。
+ *
+ * 析构时等待所有子上下文结束。
+ */
+class TaskGroup
+{
+public:
+    TaskGroup() = default;
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup& operator= (const TaskGroup&) = delete;
+
+    /**
+     * @brief               在指定协程上创建子上下文
+     */
+    SharedContext       spawn(Coroutine *co, const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+    SharedContext       spawn(Coroutine *co, Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+
+    /**
+     * @brief               在 CoroutinePool 中负载最低的协程上创建子上下文
+     */
+    SharedContext       spawn(const Loop::WorkFun &f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+    SharedContext       spawn(Loop::WorkFun &&f, const int &stackSize = 0, const Loop::Priority &pri = 0, const char *tag = nullptr);
+
+    void        waitAll();
+
+    /**
+     * @return              false 表示超时
+     */
+    bool        waitFor(const Seconds &sec);
+
+    /**
+     * @brief               按结束顺序逐个取出已结束的子上下文
+     * @param sec           小于 0 表示一直等待
+     * @return              子上下文 id，0 表示超时或所有子上下文均已取出
+     */
+    ContextId   waitAny(const Seconds &sec = -1);
+
+    /**
+     * @brief               取消所有子上下文，之后 spawn 的子上下文创建即被取消
+     */
+    void        cancel();
+    bool        isCancelled();
+
+    /**
+     * @brief               尚未结束的子上下文数量
+     */
+    int         size();
+
+    /**
+     * @brief               子上下文结束时由 Coroutine 调用
+     */
+    void        complete(Context *ctx);
+
+private:
+    SharedContext       attach(SharedContext &&sc);
+
+    static void         cancelContext(const SharedContext &sc);
+
+private:
+    SpinMutex       m_mutex;
+
+    bool            m_cancelled = false;
+
+    // 尚未结束的子上下文，按 Context::groupIndex 交换删除
+    std::vector<SharedContext>      m_children;
+
+    // 已结束且尚未被 waitAny 取出的子上下文
+    std::vector<ContextId>          m_done;
+    size_t                          m_doneRead = 0;
+
+    CoWaitQueue     m_allQueue,
+                    m_anyQueue;
+};
+
+};
@@ -0,0 +1,131 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/buffer.h>
+#include <SpaE/spin_mutex.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+#include <new>
+
+using namespace SpaE;
+
+// 最小 256 字节，最大 64K
+#define BUFFER_MIN_SHIFT        (8)
+#define BUFFER_MAX_SHIFT        (16)
+#define BUFFER_CLASS_COUNT      (BUFFER_MAX_SHIFT - BUFFER_MIN_SHIFT + 1)
+
+struct BufferClass {
+    SpinMutex   mutex;
+
+    Buffer      *head = nullptr;
+
+    int         count = 0;
+};
+
+static BufferClass          g_bufferClasses[BUFFER_CLASS_COUNT];
+static std::atomic<int>     g_bufferPoolLimit { 256 };
+
+static inline int bufferClassOf(size_t capacity)
+{
+    int shift = BUFFER_MIN_SHIFT;
+
+    while (((size_t) 1 << shift) < capacity) {
+        shift ++;
+    }
+
+    return shift > BUFFER_MAX_SHIFT ? -1 : shift - BUFFER_MIN_SHIFT;
+}
+
+BufferRef Buffer::alloc(size_t capacity)
+{
+    auto cls = bufferClassOf(capacity);
+
+    Buffer  *b = nullptr;
+
+    if (cls >= 0) {
+        auto &c = g_bufferClasses[cls];
+
+        std::unique_lock<decltype(c.mutex)>     lk(c.mutex);
+
+        if (c.head) {
+            b = c.head;
+            c.head = b->next;
+            c.count --;
+        }
+    }
+
+    if (! b) {
+        auto cap = cls >= 0 ? (size_t) 1 << (cls + BUFFER_MIN_SHIFT) : capacity;
+
+        auto mem = malloc(sizeof(Buffer) + cap);
+        if (! mem) {
+            throw std::bad_alloc();
+        }
+
+        b = (Buffer *) mem;
+        new (&b->refCount) std::atomic<int>(0);
+        b->capacity = cap;
+        b->sizeClass = cls;
+    }
+
+    b->size = 0;
+    b->next = nullptr;
+
+    return BufferRef(b);
+}
+
+BufferRef Buffer::copy(const void *data, size_t len)
+{
+    auto ref = alloc(len);
+
+    memcpy(ref->data(), data, len);
+    ref->size = len;
+
+    return ref;
+}
+
+void Buffer::setPoolLimit(int count)
+{
+    g_bufferPoolLimit = count;
+}
+
+void Buffer::release()
+{
+    if (refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    if (sizeClass >= 0) {
+        auto &c = g_bufferClasses[sizeClass];
+
+        std::unique_lock<decltype(c.mutex)>     lk(c.mutex);
+
+        if (c.count < g_bufferPoolLimit) {
+            next = c.head;
+            c.head = this;
+            c.count ++;
+
+            return;
+        }
+    }
+
+    free(this);
+}
@@ -0,0 +1,353 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/channel.h>
+
+#include <algorithm>
+
+using namespace SpaE;
+
+void ChannelNodeQueue::push(ChannelNode *n)
+{
+    n->prev = m_tail;
+    n->next = nullptr;
+
+    if (m_tail) {
+        m_tail->next = n;
+    }
+    else {
+        m_head = n;
+    }
+    m_tail = n;
+}
+
+void ChannelNodeQueue::remove(ChannelNode *n)
+{
+    // 已经被 claim 取走
+    if (! n->prev && m_head != n) {
+        return;
+    }
+
+    if (n->prev) {
+        n->prev->next = n->next;
+    }
+    else {
+        m_head = n->next;
+    }
+
+    if (n->next) {
+        n->next->prev = n->prev;
+    }
+    else {
+        m_tail = n->prev;
+    }
+
+    n->prev = nullptr;
+    n->next = nullptr;
+}
+
+ChannelNode *ChannelNodeQueue::claim()
+{
+    while (m_head) {
+        auto n = m_head;
+
+        remove(n);
+
+        // 已超时，或者 select 的其他分支已被选中
+        if (n->wait->waiter.claim()) {
+            return n;
+        }
+    }
+
+    return nullptr;
+}
+
+void ChannelNodeQueue::complete(ChannelNode *n, bool ok, CoWakeup &wakeup)
+{
+    auto w = n->wait;
+
+    w->selected = n->index;
+    w->ok = ok;
+
+    w->waiter.complete(wakeup);
+}
+
+// ################################################################
+
+ChannelBase::ChannelBase(size_t capacity)
+{
+    m_capacity = capacity;
+}
+
+ChannelBase::~ChannelBase()
+{
+
+}
+
+void ChannelBase::close()
+{
+    std::vector<CoWakeup>       wakeups;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        m_closed = true;
+
+        ChannelNode     *n;
+        while ((n = m_recvQueue.claim())) {
+            wakeups.emplace_back();
+
+            ChannelNodeQueue::complete(n, false, wakeups.back());
+        }
+        while ((n = m_sendQueue.claim())) {
+            wakeups.emplace_back();
+
+            ChannelNodeQueue::complete(n, false, wakeups.back());
+        }
+    }
+
+    for (auto &it: wakeups) {
+        it();
+    }
+}
+
+bool ChannelBase::isClosed()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_closed;
+}
+
+size_t ChannelBase::capacity()
+{
+    return m_capacity;
+}
+
+size_t ChannelBase::size()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return bufferSizeLocked();
+}
+
+bool ChannelBase::sendHelper(void *value, const Seconds &sec, bool &ok)
+{
+    CoWakeup    wakeup;
+
+    m_mutex.lock();
+
+    if (trySendLocked(value, wakeup, ok)) {
+        m_mutex.unlock();
+
+        wakeup();
+        return true;
+    }
+
+    if (sec == 0) {
+        m_mutex.unlock();
+        return false;
+    }
+
+    ChannelWait     w;
+    w.waiter.prepare();
+    w.waiter.cancellable = true;
+
+    ChannelNode     n;
+    n.wait = &w;
+    n.value = value;
+
+    m_sendQueue.push(&n);
+    m_mutex.unlock();
+
+    if (! w.waiter.sleep(sec)) {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        m_sendQueue.remove(&n);
+
+        return false;
+    }
+
+    ok = w.ok;
+
+    return true;
+}
+
+bool ChannelBase::recvHelper(void *value, const Seconds &sec, bool &ok)
+{
+    CoWakeup    wakeup;
+
+    m_mutex.lock();
+
+    if (tryRecvLocked(value, wakeup, ok)) {
+        m_mutex.unlock();
+
+        wakeup();
+        return true;
+    }
+
+    if (sec == 0) {
+        m_mutex.unlock();
+        return false;
+    }
+
+    ChannelWait     w;
+    w.waiter.prepare();
+    w.waiter.cancellable = true;
+
+    ChannelNode     n;
+    n.wait = &w;
+    n.value = value;
+
+    m_recvQueue.push(&n);
+    m_mutex.unlock();
+
+    if (! w.waiter.sleep(sec)) {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        m_recvQueue.remove(&n);
+
+        return false;
+    }
+
+    ok = w.ok;
+
+    return true;
+}
+
+// ################################################################
+
+int ChannelSelect::addCase(ChannelBase *ch, void *value, bool isSend)
+{
+    Case    c;
+    c.ch = ch;
+    c.value = value;
+    c.isSend = isSend;
+
+    m_cases.emplace_back(c);
+
+    return m_cases.size() - 1;
+}
+
+void ChannelSelect::lockAll(std::vector<ChannelBase *> &chs)
+{
+    for (auto &it: chs) {
+        it->m_mutex.lock();
+    }
+}
+
+void ChannelSelect::unlockAll(std::vector<ChannelBase *> &chs)
+{
+    for (auto it = chs.rbegin(); it != chs.rend(); it ++) {
+        (*it)->m_mutex.unlock();
+    }
+}
+
+int ChannelSelect::wait(const Seconds &sec)
+{
+    // 按地址顺序加锁，避免多个 select 交叉死锁
+    std::vector<ChannelBase *>      chs;
+    for (auto &it: m_cases) {
+        chs.emplace_back(it.ch);
+    }
+    std::sort(chs.begin(), chs.end());
+    chs.erase(std::unique(chs.begin(), chs.end()), chs.end());
+
+    lockAll(chs);
+
+    for (size_t i = 0; i < m_cases.size(); i ++) {
+        auto &c = m_cases[i];
+
+        CoWakeup    wakeup;
+        bool        ok;
+        bool        done;
+
+        if (c.isSend) {
+            done = c.ch->trySendLocked(c.value, wakeup, ok);
+        }
+        else {
+            done = c.ch->tryRecvLocked(c.value, wakeup, ok);
+        }
+
+        if (done) {
+            unlockAll(chs);
+
+            wakeup();
+
+            m_ok = ok;
+            return i;
+        }
+    }
+
+    if (sec == 0) {
+        unlockAll(chs);
+        return -1;
+    }
+
+    ChannelWait     w;
+    w.waiter.prepare();
+    w.waiter.cancellable = true;
+
+    std::vector<ChannelNode>    nodes(m_cases.size());
+    for (size_t i = 0; i < m_cases.size(); i ++) {
+        auto &c = m_cases[i];
+        auto &n = nodes[i];
+
+        n.wait = &w;
+        n.value = c.value;
+        n.index = i;
+
+        if (c.isSend) {
+            c.ch->m_sendQueue.push(&n);
+        }
+        else {
+            c.ch->m_recvQueue.push(&n);
+        }
+    }
+
+    unlockAll(chs);
+
+    auto notified = w.waiter.sleep(sec);
+
+    // 未被选中的分支仍在各通道队列中
+    lockAll(chs);
+
+    for (size_t i = 0; i < m_cases.size(); i ++) {
+        auto &c = m_cases[i];
+
+        if (c.isSend) {
+            c.ch->m_sendQueue.remove(&nodes[i]);
+        }
+        else {
+            c.ch->m_recvQueue.remove(&nodes[i]);
+        }
+    }
+
+    unlockAll(chs);
+
+    if (! notified) {
+        return -1;
+    }
+
+    m_ok = w.ok;
+
+    return w.selected;
+}
+
+bool ChannelSelect::ok()
+{
+    return m_ok;
+}
@@ -18,6 +18,13 @@
 
 #include <SpaE/coroutine.h>
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <string_view>
+
+#include <SpaE/task_group.h>
+
 #include "context.h"
 
 #define DBG     0
@@ -35,103 +42,440 @@ static std::atomic<uint64_t>    g_contextId { 1 };
 static std::unordered_map<std::thread::id, Coroutine *>      g_coPoolMap;
 static SpinMutex    g_coPoolMutex;
 
-struct SpaE::ArchContext {
-    std::vector<char>       stack;
+static thread_local Coroutine   *t_currentCoroutine = nullptr;
+
+#define STACK_OVERFLOW_MARK     (0x55aaaa55)
+
+// 栈统计填充值，与溢出标记区分
+#define STACK_PAINT_BYTE        (0xcd)
+#define STACK_PAINT_WORD        (0xcdcdcdcd)
+
+// 使用量直方图档位: 1K, 2K ... 2^(N-1) K
+#define STACK_HISTOGRAM_SIZE    (16)
+
+// 自适应栈的最小一档及余量
+#define STACK_ADAPTIVE_MIN      (16 * 1024)
+#define STACK_ADAPTIVE_MARGIN   (8 * 1024)
 
-    tb_context_ref_t        ref;
-    tb_context_from_t       from;
+struct StackProfileInfo
+{
+    int     samples = 0;
+    int     maxUsed = 0;
+    int     overflows = 0;
+    int     suggested = 0;
+
+    int     histogram[STACK_HISTOGRAM_SIZE] = { 0 };
 };
 
-#define STACK_OVERFLOW_MARK     (0x55aaaa55)
+static std::atomic<bool>    g_stackProfiling { false };
+static std::atomic<bool>    g_stackAdaptive { false };
+
+static std::map<std::string, StackProfileInfo, std::less<>>     g_stackProfileMap;
+static SpinMutex    g_stackProfileMutex;
+
+// 满足 used 并留出余量的最小一档（2 的幂）
+static int stackBucket(int used)
+{
+    int need = used + std::max(used / 2, STACK_ADAPTIVE_MARGIN);
+
+    int bucket = STACK_ADAPTIVE_MIN;
+    while (bucket < need) {
+        bucket <<= 1;
+    }
+
+    return bucket;
+}
+
+static bool stackSizeForTag(const char *tag, int &stackSize)
+{
+    std::unique_lock<decltype(g_stackProfileMutex)>     lk(g_stackProfileMutex);
+
+    auto it = g_stackProfileMap.find(std::string_view(tag));
+    if (it == g_stackProfileMap.end()) {
+        return false;
+    }
+
+    stackSize = it->second.suggested;
+
+    return true;
+}
+
+// 在上下文的 work 返回后调用
+static void stackProfileRecord(Context *ctx)
+{
+    auto words = (uint32_t *) ctx->stack;
+    auto count = ctx->stackSize / (int) sizeof(uint32_t);
+
+    auto overflow = words[0] != STACK_OVERFLOW_MARK;
+
+    // 栈向下增长，从栈底向上找到第一个被改写的位置
+    int i = 1;
+    while (i < count && words[i] == STACK_PAINT_WORD) {
+        i ++;
+    }
+
+    int used = overflow ? ctx->stackSize : (count - i) * sizeof(uint32_t);
+
+    int h = 0;
+    while (h < STACK_HISTOGRAM_SIZE - 1 && (1 << h) * 1024 < used) {
+        h ++;
+    }
+
+    std::unique_lock<decltype(g_stackProfileMutex)>     lk(g_stackProfileMutex);
+
+    auto it = g_stackProfileMap.find(std::string_view(ctx->tag));
+    if (it == g_stackProfileMap.end()) {
+        it = g_stackProfileMap.emplace(ctx->tag, StackProfileInfo()).first;
+    }
+
+    auto &info = it->second;
+    info.samples ++;
+    info.histogram[h] ++;
 
-static std::unordered_set<Context *>    g_contextSet;
-static SpinMutex    g_contextSetMutex;
+    if (overflow) {
+        info.overflows ++;
+
+        // 溢出后至少翻倍
+        used = std::max(used, info.maxUsed) * 2;
+    }
+    if (used > info.maxUsed) {
+        info.maxUsed = used;
+    }
+
+    info.suggested = stackBucket(info.maxUsed);
+}
+
+// Context 紧贴栈顶存放，栈大小与整块内存都按此对齐
+#define CONTEXT_ALIGN           (16)
 
 static void archContextFun(tb_context_from_t from)
 {
     auto ctx = (Context *) from.priv;
-    auto sc = Coroutine::getCurrentCoroutine()->getCurrentContext();
 
-    {
-        std::unique_lock<decltype(g_contextSetMutex)>       lk(g_contextSetMutex);
+    ctx->archFrom = from.context;
 
-        g_contextSet.emplace(ctx);
+    // 开始运行之前已被取消的上下文不再运行 work
+    auto started = ! ctx->cancelled;
+
+    // from may change in work
+    if (started) {
+        ctx->work();
     }
 
-    sc->archContex->from = from;
+    // 尽早释放 work 捕获的对象
+    ctx->work = nullptr;
 
-    // from may change in work
-    ctx->work();
+    // 在通知 join 之前统计，此时栈上只剩本函数的栈帧
+    if (ctx->painted && ctx->tag && started) {
+        stackProfileRecord(ctx);
+    }
 
+    TaskGroup   *group;
     {
-        std::unique_lock<decltype(sc->mutex)>       lk(sc->mutex);
+        std::unique_lock<decltype(ctx->mutex)>      lk(ctx->mutex);
+
+        ctx->alive = false;
 
-        sc->alive = false;
+        group = ctx->group;
+        ctx->group = nullptr;
     }
 
-    sc->compeleteCv.notify_all();
+    if (group) {
+        group->complete(ctx);
+    }
 
-    emit sc->signalCompelte();
+    // alive 为 false 之后不会再有新的 join 等待者入队
+    for (;;) {
+        CoWakeup    wakeup;
+        {
+            std::unique_lock<decltype(ctx->mutex)>      lk(ctx->mutex);
 
-    {
-        std::unique_lock<decltype(g_contextSetMutex)>       lk(g_contextSetMutex);
+            if (! ctx->completeQueue.notifyOne(wakeup)) {
+                break;
+            }
+        }
 
-        g_contextSet.erase(ctx);
+        wakeup();
     }
 
-    tb_context_jump(sc->archContex->from.context, nullptr);
+    tb_context_jump(ctx->archFrom, nullptr);
 }
 
 bool Coroutine::stackOverflowCheck(const char **loopName, int *stackSize)
 {
-    for (auto &it: g_contextSet) {
-        if (((uint32_t *) (& it->archContex->stack[it->archContex->stack.size() - 4]))[0] == STACK_OVERFLOW_MARK) {
-            continue;
+    std::unique_lock<decltype(g_coPoolMutex)>       lk(g_coPoolMutex);
+
+    for (auto &it: g_coPoolMap) {
+        auto co = it.second;
+
+        std::unique_lock<decltype(co->m_mutex)>     lk(co->m_mutex);
+
+        for (auto ctx = co->m_contextList; ctx; ctx = ctx->next) {
+            if (((uint32_t *) ctx->stack)[0] == STACK_OVERFLOW_MARK) {
+                continue;
+            }
+
+            *loopName = co->getLoop()->getName();
+            *stackSize = ctx->stackSize;
+
+            return true;
         }
+    }
+    return false;
+}
 
-        *loopName = it->getLoop()->getName();
-        *stackSize = it->archContex->stack.size();
+// ################################################################
 
-        return true;
+Context::Context(int stackSize)
+{
+    id = g_contextId ++;
+    pri = 0;
+    co = nullptr;
+    migrateTo = nullptr;
+    alive = true;
+    firstRun = true;
+    running = true;
+    cancelled = false;
+    refCount = 0;
+    wakeTime = 0;
+    timerIndex = -1;
+    sliceStart = 0;
+    greedy = false;
+    group = nullptr;
+    groupIndex = -1;
+    prev = nullptr;
+    next = nullptr;
+
+    // 栈在 Context 之下
+    stack = ((char *) this) - stackSize;
+    this->stackSize = stackSize;
+
+    tag = nullptr;
+    painted = g_stackProfiling;
+
+    if (painted) {
+        memset(stack, STACK_PAINT_BYTE, stackSize);
+    }
+
+    // 栈向下增长，溢出标记放在栈底
+    ((uint32_t *) stack)[0] = STACK_OVERFLOW_MARK;
+
+    archRef = tb_context_make(stack, stackSize, archContextFun);
+    archFrom = nullptr;
+}
+
+Context::~Context()
+{
+
+}
+
+SharedContext Context::alloc(int stackSize)
+{
+    stackSize = (stackSize + CONTEXT_ALIGN - 1) & ~(CONTEXT_ALIGN - 1);
+
+    auto size = stackSize + ((sizeof(Context) + CONTEXT_ALIGN - 1) & ~(CONTEXT_ALIGN - 1));
+    auto block = (char *) aligned_alloc(CONTEXT_ALIGN, size);
+    if (! block) {
+        throw std::bad_alloc();
     }
+
+    return SharedContext(new (block + stackSize) Context(stackSize));
+}
+
+SharedContext Context::create(const Loop::WorkFun &work, int stackSize)
+{
+    auto sc = alloc(stackSize);
+
+    sc->work = work;
+
+    return sc;
+}
+
+SharedContext Context::create(Loop::WorkFun &&work, int stackSize)
+{
+    auto sc = alloc(stackSize);
+
+    sc->work = std::move(work);
+
+    return sc;
+}
+
+void Context::release()
+{
+    if (refCount.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    auto block = stack;
+
+    this->~Context();
+
+    free(block);
+}
+
+// ################################################################
+
+void CoWakeup::operator () ()
+{
+    if (co) {
+        co->wake(sc);
+    }
+    else if (sem) {
+        sem->post();
+    }
+}
+
+void CoWaitQueue::push(CoWaiter *w)
+{
+    w->prev = m_tail;
+    w->next = nullptr;
+
+    if (m_tail) {
+        m_tail->next = w;
+    }
+    else {
+        m_head = w;
+    }
+    m_tail = w;
+}
+
+void CoWaitQueue::remove(CoWaiter *w)
+{
+    // 已经被 notifyOne 取走
+    if (! w->prev && m_head != w) {
+        return;
+    }
+
+    if (w->prev) {
+        w->prev->next = w->next;
+    }
+    else {
+        m_head = w->next;
+    }
+
+    if (w->next) {
+        w->next->prev = w->prev;
+    }
+    else {
+        m_tail = w->prev;
+    }
+
+    w->prev = nullptr;
+    w->next = nullptr;
+}
+
+bool CoWaitQueue::notifyOne(CoWakeup &wakeup)
+{
+    while (m_head) {
+        auto w = m_head;
+
+        remove(w);
+
+        // 先拷贝，CAS 成功之后 waiter 随时可能失效
+        wakeup.co = w->co;
+        wakeup.sc = w->sc;
+        wakeup.sem = &w->sem;
+
+        int expected = CoWaiter::Waiting;
+        if (w->state.compare_exchange_strong(expected, CoWaiter::Notified)) {
+            return true;
+        }
+    }
+
+    wakeup = CoWakeup();
+
     return false;
 }
 
-Context::Context(const Loop::WorkFun &work, int stackSize)
+bool CoWaitQueue::empty()
 {
-    this->work = work;
+    return ! m_head;
+}
 
-    init(stackSize);
+void CoWaiter::prepare()
+{
+    co = Coroutine::getCurrentCoroutine();
+    if (co) {
+        sc = co->getCurrentContext();
+    }
+
+    if (! sc) {
+        co = nullptr;
+    }
 }
 
-Context::Context(Loop::WorkFun &&work, int stackSize)
+bool CoWaiter::sleep(const Seconds &sec)
 {
-    this->work = std::move(work);
+    if (! co) {
+        if (sec < 0) {
+            sem.wait();
+            return true;
+        }
+        if (sem.waitFor(sec)) {
+            return true;
+        }
+
+        int expected = Waiting;
+        if (state.compare_exchange_strong(expected, TimedOut)) {
+            return false;
+        }
+
+        // 超时的同时被通知，等待 post 完成后 sem 才能销毁
+        sem.wait();
+
+        return true;
+    }
+
+    if (sec < 0) {
+        // 可能被其他来源的 resume 唤醒，以 waiter 状态为准
+        while (! finished() && ! cancel()) {
+            Coroutine::pending();
+        }
+        return state.load() == Notified;
+    }
+
+    // 超时由所属协程的定时器堆驱动，到期后自行将状态置为 TimedOut
+    auto deadline = now() + sec;
+
+    while (! finished() && ! cancel()) {
+        auto left = deadline - now();
+        if (left > 0) {
+            Coroutine::pendingFor(left);
+            continue;
+        }
+
+        int expected = Waiting;
+        if (state.compare_exchange_strong(expected, TimedOut)) {
+            break;
+        }
 
-    init(stackSize);
+        // 通知方已经抢占，等待其唤醒
+        Coroutine::pending();
+    }
+
+    return state.load() == Notified;
 }
 
-Context::~Context()
+void CoWaiter::complete(CoWakeup &wakeup)
 {
-    compeleteCv.notify_all();
+    // 先拷贝，状态置为 Notified 之后 waiter 随时可能失效
+    wakeup.co = co;
+    wakeup.sc = sc;
+    wakeup.sem = &sem;
 
-    delete archContex;
+    state.store(Notified);
 }
 
-void Context::init(int stackSize)
+bool CoWaiter::cancel()
 {
-    id = g_contextId ++;
-    pri = 0;
-    alive = true;
-    firstRun = true;
-    running = true;
+    if (! cancellable || ! sc->cancelled.load()) {
+        return false;
+    }
 
-    auto archContex = new ArchContext();
-    archContex->stack.resize(stackSize);
-    ((uint32_t *) (& archContex->stack[stackSize - 4]))[0] = STACK_OVERFLOW_MARK;
-    archContex->ref = tb_context_make(archContex->stack.data(), stackSize, archContextFun);
+    // 失败说明通知方已经抢占，继续等待其完成
+    int expected = Waiting;
 
-    this->archContex = archContex;
+    return state.compare_exchange_strong(expected, TimedOut);
 }
 
 // ################################################################
@@ -156,44 +500,48 @@ Coroutine::~Coroutine()
     g_coPoolMap.erase(m_loop->getThread().get_id());
 }
 
-SharedContext Coroutine::work(const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri)
+SharedContext Coroutine::work(const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri, const char *tag)
 {
-    auto ss = stackSize;
-    if (ss < m_stackSize) {
-        ss = m_stackSize;
-    }
-
-    auto sc = std::make_shared<Context>(std::move(f), ss);
-    sc->moveToLoop(m_loop);
+    return work(Loop::WorkFun(f), stackSize, pri, tag);
+}
 
-    m_loop->work(
-        [=]
-        {
-            m_sharedContextSet.emplace(sc);
+SharedContext Coroutine::work(Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri, const char *tag)
+{
+    int ss;
 
-            m_runningContextMap.emplace(sc->pri, sc);
+    if (! (stackSize == 0 && tag && g_stackAdaptive && stackSizeForTag(tag, ss))) {
+        ss = stackSize;
+        if (ss < m_stackSize) {
+            ss = m_stackSize;
         }
-    );
+    }
 
-    return sc;
-}
+    auto sc = Context::create(std::move(f), ss);
+    sc->co = this;
+    sc->pri = pri;
+    sc->tag = tag;
 
-SharedContext Coroutine::work(Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri)
-{
-    auto ss = stackSize;
-    if (ss < m_stackSize) {
-        ss = m_stackSize;
-    }
+    m_workSetSize ++;
 
-    auto sc = std::make_shared<Context>(std::move(f), ss);
-    sc->moveToLoop(m_loop);
+    // 只捕获裸指针，lambda 可以放进 std::function 的内部存储，不再额外分配
+    auto ctx = sc.get();
+    ctx->addRef();
 
     m_loop->work(
-        [=]
+        [this, ctx]
         {
-            m_sharedContextSet.emplace(sc);
+            {
+                std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
 
-            m_runningContextMap.emplace(sc->pri, sc);
+                ctx->next = m_contextList;
+                if (m_contextList) {
+                    m_contextList->prev = ctx;
+                }
+                m_contextList = ctx;
+            }
+
+            // 预先增加的引用转交给链表，挂起中的上下文由它保持存活
+            m_runningContextMap.emplace(ctx->pri, SharedContext(ctx));
         }
     );
 
@@ -202,48 +550,85 @@ SharedContext Coroutine::work(Loop::WorkFun &&f, const int &stackSize, const Loo
 
 void Coroutine::join(const SharedContext &sc)
 {
-    auto co = getCurrentCoroutine();
+    CoWaiter    w;
+    {
+        std::unique_lock<decltype(sc->mutex)>       lk(sc->mutex);
 
-    if (! co) {
-        std::unique_lock<decltype(sc->compeleteCvMutex)>        lk(sc->compeleteCvMutex);
-        sc->compeleteCv.wait(lk,
-            [=]
-            {
-                return !sc->alive;
-            }
-        );
-        return;
+        if (! sc->alive) {
+            return;
+        }
+
+        w.prepare();
+
+        sc->completeQueue.push(&w);
     }
 
-    {
-        auto coSc = co->getCurrentContext();
+    w.sleep();
+}
 
+bool Coroutine::joinFor(const SharedContext &sc, const Seconds &sec)
+{
+    CoWaiter    w;
+    {
         std::unique_lock<decltype(sc->mutex)>       lk(sc->mutex);
 
         if (! sc->alive) {
-            return;
+            return true;
         }
 
-        connect(sc.get(), &sc->signalCompelte,
-            [=]
-            {
-                co->resume(coSc);
-            }
-        );
+        w.prepare();
+        w.cancellable = true;
+
+        sc->completeQueue.push(&w);
     }
 
-    pending();
+    if (! w.sleep(sec)) {
+        std::unique_lock<decltype(sc->mutex)>       lk(sc->mutex);
+
+        sc->completeQueue.remove(&w);
+
+        return false;
+    }
+
+    return true;
+}
+
+void Coroutine::cancel(const SharedContext &sc)
+{
+    sc->cancelled = true;
+
+    // 排队中的上下文会照常被调度，挂起中的需要唤醒
+    wake(sc);
 }
 
 void Coroutine::resume(const SharedContext &sc)
 {
     DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) sc->id);
 
+    wake(sc);
+
+    if (this == getCurrentCoroutine()) {
+        if (m_currentContext) {
+            yield();
+        }
+    }
+}
+
+void Coroutine::wake(const SharedContext &sc)
+{
+    auto ctx = sc.get();
+    ctx->addRef();
+
     m_loop->work(
-        [=]
+        [this, ctx]
         {
-            auto it = m_sharedContextSet.find(sc);
-            if (it == m_sharedContextSet.end()) {
+            SharedContext   sc(ctx);
+
+            ctx->release();
+
+            // 已迁移，转发给新的协程
+            if (sc->co != this) {
+                sc->co.load()->wake(sc);
                 return;
             }
 
@@ -254,77 +639,408 @@ void Coroutine::resume(const SharedContext &sc)
             DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) sc->id);
 
             sc->running = true;
-            m_runningContextMap.emplace(sc->pri, sc);
+            m_runningContextMap.emplace(sc->pri, std::move(sc));
         }
     );
-
-    if (this == getCurrentCoroutine()) {
-        if (m_currentContext) {
-            yield();
-        }
-    }
 }
 
 void Coroutine::pending()
 {
     auto co = getCurrentCoroutine();
-    if (! co) {
+    if (! co || ! co->m_currentContext) {
         printf("warning: SpaE::Coroutine::%s faild cause NOT_IN_COROUTINE \r\n", __FUNCTION__);
 
         return;
     }
 
-    auto sc = co->getCurrentContext();
+    auto ctx = co->m_currentContext.get();
 
-    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) sc->id);
+    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) ctx->id);
 
-    sc->archContex->from = tb_context_jump(sc->archContex->from.context, nullptr);
+    ctx->archFrom = tb_context_jump(ctx->archFrom, nullptr).context;
 }
 
 void Coroutine::yield()
 {
     auto co = getCurrentCoroutine();
-    if (! co) {
+    if (! co || ! co->m_currentContext) {
         std::this_thread::yield();
 
         return;
     }
 
-    auto sc = co->getCurrentContext();
+    auto ctx = co->m_currentContext.get();
 
-    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) sc->id);
+    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) ctx->id);
+
+    ctx->addRef();
 
     co->getLoop()->work(
-        [=]
+        [co, ctx]
         {
-            co->m_runningContextMap.emplace(sc->pri, sc);
+            SharedContext   sc(ctx);
+
+            ctx->release();
+
+            // 切出后被迁移
+            if (sc->co != co) {
+                sc->co.load()->wake(sc);
+                return;
+            }
+
+            // 期间可能已被 resume 重新加入队列
+            if (sc->running) {
+                return;
+            }
+
+            sc->running = true;
+            co->m_runningContextMap.emplace(sc->pri, std::move(sc));
         }
     );
 
-    sc->archContex->from = tb_context_jump(sc->archContex->from.context, nullptr);
+    ctx->archFrom = tb_context_jump(ctx->archFrom, nullptr).context;
 }
 
 void Coroutine::yieldFor(const Seconds &sec)
 {
     auto co = getCurrentCoroutine();
-    if (! co) {
+    if (! co || ! co->m_currentContext) {
         printf("warning: SpaE::Coroutine::%s faild cause NOT_IN_COROUTINE \r\n", __FUNCTION__);
 
         return;
     }
 
-    auto sc = co->getCurrentContext();
+    // 已被取消时不再挂起
+    if (co->m_currentContext->cancelled) {
+        return;
+    }
+
+    pendingFor(sec);
+}
+
+void Coroutine::pendingFor(const Seconds &sec)
+{
+    auto co = getCurrentCoroutine();
+    if (! co || ! co->m_currentContext) {
+        printf("warning: SpaE::Coroutine::%s faild cause NOT_IN_COROUTINE \r\n", __FUNCTION__);
+
+        return;
+    }
+
+    auto ctx = co->m_currentContext.get();
+
+    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) ctx->id);
+
+    ctx->wakeTime = now() + sec;
+
+    co->timerPush(ctx);
+
+    pending();
+
+    // 提前被唤醒，期间可能已迁移到其他协程，从上下文取所属协程
+    if (ctx->timerIndex >= 0) {
+        ctx->co.load()->timerRemove(ctx);
+    }
+}
+
+bool Coroutine::migrate(Coroutine *target, std::initializer_list<Object *> objects)
+{
+    auto co = getCurrentCoroutine();
+    if (! co || ! co->m_currentContext) {
+        printf("warning: SpaE::Coroutine::%s faild cause NOT_IN_COROUTINE \r\n", __FUNCTION__);
+
+        return false;
+    }
+
+    if (target == co) {
+        return true;
+    }
+
+    for (auto &it: objects) {
+        it->moveToLoop(target->getLoop());
+    }
+
+    // 切出后由 run() 转交，yield 的重新排队请求会被转发到 target
+    co->m_currentContext->migrateTo = target;
+
+    yield();
+
+    return true;
+}
+
+void Coroutine::migrate(const SharedContext &sc, Coroutine *target)
+{
+    auto ctx = sc.get();
+    ctx->addRef();
+
+    m_loop->work(
+        [this, ctx, target]
+        {
+            SharedContext   sc(ctx);
+
+            ctx->release();
+
+            if (ctx->co != this) {
+                ctx->co.load()->migrate(sc, target);
+                return;
+            }
+
+            if (! ctx->alive || target == this) {
+                return;
+            }
+
+            if (ctx->running) {
+                ctx->migrateTo = target;
+                return;
+            }
+
+            migrateHelper(ctx, target);
+        }
+    );
+}
+
+void Coroutine::migrateHelper(Context *ctx, Coroutine *target)
+{
+    auto timer = ctx->timerIndex >= 0;
+    if (timer) {
+        timerRemove(ctx);
+    }
+
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
 
-    setTimeout(sec,
-        [=]
+        if (ctx->prev) {
+            ctx->prev->next = ctx->next;
+        }
+        else {
+            m_contextList = ctx->next;
+        }
+        if (ctx->next) {
+            ctx->next->prev = ctx->prev;
+        }
+        ctx->prev = nullptr;
+        ctx->next = nullptr;
+    }
+
+    m_workSetSize --;
+
+    // 此后 ctx 只能由 target 线程访问，链表持有的引用一并转交
+    ctx->co = target;
+
+    target->m_workSetSize ++;
+
+    target->m_loop->work(
+        [target, ctx, timer]
         {
-            co->resume(sc);
+            {
+                std::unique_lock<decltype(target->m_mutex)>     lk(target->m_mutex);
+
+                ctx->next = target->m_contextList;
+                if (target->m_contextList) {
+                    target->m_contextList->prev = ctx;
+                }
+                target->m_contextList = ctx;
+            }
+
+            if (timer) {
+                target->timerPush(ctx);
+            }
         }
     );
+}
 
-    DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) sc->id);
+void Coroutine::timerPush(Context *ctx)
+{
+    ctx->timerIndex = m_timerHeap.size();
 
-    pending();
+    m_timerHeap.emplace_back(ctx);
+
+    timerSiftUp(ctx->timerIndex);
+}
+
+void Coroutine::timerRemove(Context *ctx)
+{
+    auto i = ctx->timerIndex;
+    auto last = (int) m_timerHeap.size() - 1;
+
+    if (i != last) {
+        timerSwap(i, last);
+    }
+
+    m_timerHeap.pop_back();
+
+    ctx->timerIndex = -1;
+
+    if (i != last) {
+        timerSiftUp(i);
+        timerSiftDown(i);
+    }
+}
+
+void Coroutine::timerSwap(int a, int b)
+{
+    std::swap(m_timerHeap[a], m_timerHeap[b]);
+
+    m_timerHeap[a]->timerIndex = a;
+    m_timerHeap[b]->timerIndex = b;
+}
+
+void Coroutine::timerSiftUp(int i)
+{
+    while (i > 0) {
+        auto parent = (i - 1) / 2;
+        if (m_timerHeap[parent]->wakeTime <= m_timerHeap[i]->wakeTime) {
+            break;
+        }
+
+        timerSwap(i, parent);
+        i = parent;
+    }
+}
+
+void Coroutine::timerSiftDown(int i)
+{
+    int size = m_timerHeap.size();
+
+    for (;;) {
+        auto min = i;
+        auto l = i * 2 + 1;
+        auto r = l + 1;
+
+        if (l < size && m_timerHeap[l]->wakeTime < m_timerHeap[min]->wakeTime) {
+            min = l;
+        }
+        if (r < size && m_timerHeap[r]->wakeTime < m_timerHeap[min]->wakeTime) {
+            min = r;
+        }
+        if (min == i) {
+            break;
+        }
+
+        timerSwap(i, min);
+        i = min;
+    }
+}
+
+Seconds Coroutine::timerProcess()
+{
+    if (m_timerHeap.empty()) {
+        return -1;
+    }
+
+    auto n = now();
+
+    while (m_timerHeap.size()) {
+        auto ctx = m_timerHeap[0];
+        if (ctx->wakeTime > n) {
+            return ctx->wakeTime - n;
+        }
+
+        timerRemove(ctx);
+
+        if (ctx->running) {
+            continue;
+        }
+
+        ctx->running = true;
+        m_runningContextMap.emplace(ctx->pri, SharedContext(ctx));
+    }
+
+    return -1;
+}
+
+bool Coroutine::isCancelled()
+{
+    auto co = getCurrentCoroutine();
+    if (! co || ! co->m_currentContext) {
+        return false;
+    }
+
+    return co->m_currentContext->cancelled.load();
+}
+
+bool Coroutine::checkpoint()
+{
+    auto co = getCurrentCoroutine();
+    if (! co || ! co->m_currentContext || ! co->m_sliceAutoYield) {
+        return false;
+    }
+
+    auto budget = co->m_sliceBudget.load();
+    if (budget <= 0 || uptime() - co->m_currentContext->sliceStart < budget) {
+        return false;
+    }
+
+    yield();
+
+    return true;
+}
+
+Seconds Coroutine::sliceElapsed()
+{
+    auto co = getCurrentCoroutine();
+    if (! co || ! co->m_currentContext) {
+        return 0;
+    }
+
+    return uptime() - co->m_currentContext->sliceStart;
+}
+
+void Coroutine::setSliceBudget(const Seconds &sec, bool autoYield)
+{
+    m_sliceBudget = sec;
+    m_sliceAutoYield = autoYield;
+}
+
+Seconds Coroutine::getSliceBudget()
+{
+    return m_sliceBudget;
+}
+
+Coroutine::SliceStats Coroutine::getSliceStats()
+{
+    std::unique_lock<decltype(m_sliceMutex)>    lk(m_sliceMutex);
+
+    auto s = m_sliceStats;
+    s.avg = s.slices ? s.total / s.slices : 0;
+
+    return s;
+}
+
+void Coroutine::resetSliceStats()
+{
+    std::unique_lock<decltype(m_sliceMutex)>    lk(m_sliceMutex);
+
+    m_sliceStats = SliceStats {};
+}
+
+void Coroutine::sliceRecord(Context *ctx, const Seconds &elapsed)
+{
+    auto budget = m_sliceBudget.load();
+    auto over = budget > 0 && elapsed > budget;
+
+    {
+        std::unique_lock<decltype(m_sliceMutex)>    lk(m_sliceMutex);
+
+        m_sliceStats.slices ++;
+        m_sliceStats.total += elapsed;
+
+        if (elapsed > m_sliceStats.max) {
+            m_sliceStats.max = elapsed;
+        }
+
+        if (over) {
+            m_sliceStats.overBudget ++;
+        }
+    }
+
+    // 每个上下文只警告一次
+    if (over && ! ctx->greedy) {
+        ctx->greedy = true;
+
+        printf("warning: SpaE::Coroutine %s context %lld (%s) ran %.3f ms, budget %.3f ms \r\n",
+            m_loop->getName(), (long long) ctx->id, ctx->tag ? ctx->tag : "-", elapsed * 1000, budget * 1000);
+    }
 }
 
 Loop *Coroutine::getLoop()
@@ -337,15 +1053,10 @@ SharedContext Coroutine::getCurrentContext()
     return m_currentContext;
 }
 
-Coroutine *Coroutine::getCurrentCoroutine()
+// 不能内联：上下文可能在 tb_context_jump 之后运行在另一个线程上，内联后编译器可能沿用切换前算出的 TLS 地址
+__attribute__((noinline)) Coroutine *Coroutine::getCurrentCoroutine()
 {
-    std::unique_lock<decltype(g_coPoolMutex)>       lk(g_coPoolMutex);
-
-    auto it = g_coPoolMap.find(std::this_thread::get_id());
-    if (it == g_coPoolMap.end()) {
-        return nullptr;
-    }
-    return it->second;
+    return t_currentCoroutine;
 }
 
 Coroutine *Coroutine::newInstance(const char *name)
@@ -392,17 +1103,62 @@ void Coroutine::setRun(bool sta)
     m_loop->setRun(sta);
 }
 
+void Coroutine::setStackProfiling(bool sta)
+{
+    g_stackProfiling = sta || g_stackAdaptive;
+}
+
+void Coroutine::setStackAdaptive(bool sta)
+{
+    g_stackAdaptive = sta;
+
+    if (sta) {
+        g_stackProfiling = true;
+    }
+}
+
+std::vector<Coroutine::StackProfile> Coroutine::getStackProfiles()
+{
+    std::vector<StackProfile>   ret;
+
+    std::unique_lock<decltype(g_stackProfileMutex)>     lk(g_stackProfileMutex);
+
+    for (auto &it: g_stackProfileMap) {
+        StackProfile    p;
+        p.tag = it.first;
+        p.samples = it.second.samples;
+        p.maxUsed = it.second.maxUsed;
+        p.overflows = it.second.overflows;
+        p.suggested = it.second.suggested;
+        p.histogram.assign(it.second.histogram, it.second.histogram + STACK_HISTOGRAM_SIZE);
+
+        ret.emplace_back(std::move(p));
+    }
+
+    return ret;
+}
+
 int Coroutine::workSetSize()
 {
-    return m_sharedContextSet.size();
+    return m_workSetSize;
 }
 
 void Coroutine::run()
 {
+    t_currentCoroutine = this;
+
     while (! m_terminate) {
+        auto timeout = timerProcess();
+
         auto it = m_runningContextMap.begin();
         if (it == m_runningContextMap.end()) {
-            m_loop->waitProcess();
+            // 等待新事件或最近的睡眠定时器到期
+            if (timeout < 0) {
+                m_loop->waitProcess();
+            }
+            else {
+                m_loop->waitProcessFor(timeout);
+            }
 
             // check if there new context get
             continue;
@@ -415,25 +1171,60 @@ void Coroutine::run()
 
         m_runningContextMap.erase(it);
 
-        DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) m_currentContext->id);
+        auto ctx = m_currentContext.get();
+
+        DBG_LOG("%s %d: %lld \r\n", __FUNCTION__, __LINE__, (long long) ctx->id);
 
-        if (m_currentContext->firstRun) {
-            m_currentContext->firstRun = false;
+        ctx->sliceStart = uptime();
 
-            m_currentContext->archContex->from = tb_context_jump(m_currentContext->archContex->ref, m_currentContext.get());
+        if (ctx->firstRun) {
+            ctx->firstRun = false;
+
+            ctx->archFrom = tb_context_jump(ctx->archRef, ctx).context;
         }
         else {
-            m_currentContext->archContex->from = tb_context_jump(m_currentContext->archContex->from.context, nullptr);
+            ctx->archFrom = tb_context_jump(ctx->archFrom, nullptr).context;
         }
 
-        m_currentContext->running = false;
+        ctx->running = false;
+
+        sliceRecord(ctx, uptime() - ctx->sliceStart);
+
+        if (! ctx->alive) {
+            {
+                std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+                if (ctx->prev) {
+                    ctx->prev->next = ctx->next;
+                }
+                else {
+                    m_contextList = ctx->next;
+                }
+                if (ctx->next) {
+                    ctx->next->prev = ctx->prev;
+                }
+                ctx->prev = nullptr;
+                ctx->next = nullptr;
+            }
+
+            m_workSetSize --;
+
+            m_currentContext = nullptr;
 
-        if (! m_currentContext->alive) {
-            m_sharedContextSet.erase(m_currentContext);
+            // 释放链表持有的引用
+            ctx->release();
+        }
+        else if (ctx->migrateTo) {
+            auto target = ctx->migrateTo;
+            ctx->migrateTo = nullptr;
+
+            migrateHelper(ctx, target);
         }
 
         m_currentContext = nullptr;
     }
 
+    t_currentCoroutine = nullptr;
+
     delete this;
 }
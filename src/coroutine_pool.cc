@@ -23,29 +23,39 @@ using namespace SpaE;
 static int g_poolSize = std::thread::hardware_concurrency();
 static int g_stackSize = 0;
 
-static SpinMutex                                g_poolMapMutex;
-static std::multimap<float, Coroutine *>        g_poolMap;
-static std::unordered_map<Coroutine *, float>   g_coroutineWorkSizeMap;
+struct PoolItem
+{
+    Coroutine           *co;
 
-void CoroutinePool::setPoolSize(int size)
+    // 已投递但尚未执行的 loopWork 数量
+    std::atomic<int>    loopWorkSize { 0 };
+};
+
+static SpinMutex                    g_poolMutex;
+static std::vector<PoolItem *>      g_pool;
+
+static void growPool(int size)
 {
-    g_poolSize = size;
+    std::unique_lock<decltype(g_poolMutex)>     lk(g_poolMutex);
 
-    std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
+    while ((int) g_pool.size() < size) {
+        char name[64];
+        sprintf(name, "SpaE::Co::Pool%d", (int) g_pool.size());
 
-    if ((int) g_poolMap.size() < size) {
-        for (size_t i = 0; i < size - g_poolMap.size(); i ++) {
-            char name[64];
-            sprintf(name, "SpaE::Co::Pool%d", (int) i + (int) g_poolMap.size());
+        auto item = new PoolItem();
+        item->co = Coroutine::newInstance(name);
 
-            auto co = Coroutine::newInstance(name);
-            auto workSize = 0 + (i + g_poolMap.size()) * 0.000001;
-            g_poolMap.emplace(workSize, co);
-            g_coroutineWorkSizeMap.emplace(co, workSize);
-        }
+        g_pool.emplace_back(item);
     }
 }
 
+void CoroutinePool::setPoolSize(int size)
+{
+    g_poolSize = size;
+
+    growPool(size);
+}
+
 int CoroutinePool::getPoolSize()
 {
     return g_poolSize;
@@ -68,150 +78,75 @@ static void initPool()
     if (! init) {
         init = true;
 
-        std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
-
-        if ((int) g_poolMap.size() < g_poolSize) {
-            for (size_t i = 0; i < g_poolSize - g_poolMap.size(); i ++) {
-                char name[64];
-                sprintf(name, "SpaE::Co::Pool%d", (int) i + (int) g_poolMap.size());
-
-                auto co = Coroutine::newInstance(name);
-                auto workSize = 0 + (i + g_poolMap.size()) * 0.000001;
-                g_poolMap.emplace(workSize, co);
-                g_coroutineWorkSizeMap.emplace(co, workSize);
-            }
-        }
+        growPool(g_poolSize);
     }
 }
 
-static inline void updateCoroutinePool(SharedContext &sc, Coroutine *co)
+// 负载 = 未结束的上下文 + 未执行的 loopWork，均由计数器直接读出，上下文结束时无需回调
+static PoolItem *leastLoaded()
 {
-    auto workSizeIt = g_coroutineWorkSizeMap.find(co);
-
-    g_poolMap.erase(workSizeIt->second);
-
-    workSizeIt->second += 1;
-
-    g_poolMap.emplace(workSizeIt->second, co);
-
-    connect(sc.get(), &sc->signalCompelte,
-        [=]
-        {
-            std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
+    PoolItem    *ret = nullptr;
+    int         min = 0;
 
-            auto workSizeIt = g_coroutineWorkSizeMap.find(co);
-            auto it = g_poolMap.find(workSizeIt->second);
+    for (auto &it: g_pool) {
+        auto load = it->co->workSetSize() + it->loopWorkSize.load(std::memory_order_relaxed);
 
-            g_poolMap.erase(it);
-
-            workSizeIt->second -= 1;
-
-            g_poolMap.emplace(workSizeIt->second, co);
+        if (! ret || load < min) {
+            ret = it;
+            min = load;
         }
-    );
+    }
+
+    return ret;
 }
 
-CoroutinePool::ContextInfo CoroutinePool::coroutineWork(const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri)
+CoroutinePool::ContextInfo CoroutinePool::coroutineWork(const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri, const char *tag)
 {
-    initPool();
-
-    ContextInfo     info;
-
-    SharedContext       sc;
-    {
-        std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
-
-        auto it = g_poolMap.begin();
-        auto co = it->second;
-        sc = it->second->work(f, stackSize, pri);
-
-        updateCoroutinePool(sc, co);
-
-        info.coroutine = it->second;
-        info.sharedContext = std::move(sc);
-    }
-
-    return info;
+    return coroutineWork(Loop::WorkFun(f), stackSize, pri, tag);
 }
 
-CoroutinePool::ContextInfo CoroutinePool::coroutineWork(Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri)
+CoroutinePool::ContextInfo CoroutinePool::coroutineWork(Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri, const char *tag)
 {
     initPool();
 
     ContextInfo     info;
 
-    SharedContext       sc;
-    {
-        std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
+    std::unique_lock<decltype(g_poolMutex)>     lk(g_poolMutex);
 
-        auto it = g_poolMap.begin();
-        auto co = it->second;
-        sc = it->second->work(std::move(f), stackSize, pri);
+    auto item = leastLoaded();
 
-        updateCoroutinePool(sc, co);
-
-        info.coroutine = it->second;
-        info.sharedContext = std::move(sc);
-    }
+    info.coroutine = item->co;
+    info.sharedContext = item->co->work(std::move(f), stackSize, pri, tag);
 
     return info;
 }
 
-static inline void updateLoopPool(Coroutine *co)
+static inline void updateLoopPool(PoolItem *item)
 {
-    auto workSizeIt = g_coroutineWorkSizeMap.find(co);
-
-    g_poolMap.erase(workSizeIt->second);
-
-    workSizeIt->second += 1;
-
-    g_poolMap.emplace(workSizeIt->second, co);
-
-    co->getLoop()->work(
+    item->co->getLoop()->work(
         [=]
         {
-            std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
-
-            auto workSizeIt = g_coroutineWorkSizeMap.find(co);
-            auto it = g_poolMap.find(workSizeIt->second);
-
-            g_poolMap.erase(it);
-
-            workSizeIt->second -= 1;
-
-            g_poolMap.emplace(workSizeIt->second, co);
+            item->loopWorkSize --;
         }
     );
 }
 
 void CoroutinePool::loopWork(const Loop::WorkFun &f, const Loop::Priority &pri)
 {
-    initPool();
-
-    {
-        std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
-
-        auto it = g_poolMap.begin();
-        auto co = it->second;
-
-        it->second->getLoop()->work(f, pri);
-
-        updateLoopPool(co);
-    }
+    loopWork(Loop::WorkFun(f), pri);
 }
 
 void CoroutinePool::loopWork(Loop::WorkFun &&f, const Loop::Priority &pri)
 {
     initPool();
 
-    {
-        std::unique_lock<decltype(g_poolMapMutex)>      lk(g_poolMapMutex);
+    std::unique_lock<decltype(g_poolMutex)>     lk(g_poolMutex);
 
-        auto it = g_poolMap.begin();
-        auto co = it->second;
+    auto item = leastLoaded();
 
-        it->second->getLoop()->work(std::move(f), pri);
+    item->loopWorkSize ++;
 
-        updateLoopPool(co);
-    }
+    item->co->getLoop()->work(std::move(f), pri);
+
+    updateLoopPool(item);
 }
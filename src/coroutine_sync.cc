@@ -0,0 +1,273 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/coroutine_sync.h>
+
+using namespace SpaE;
+
+/**
+ * @brief               将当前协程（或线程）加入等待队列并挂起
+ *                      调用时必须持有 mutex，返回时 mutex 已释放
+ *                      带超时的等待在上下文被取消时按超时返回
+ * @param release       入队后、挂起前需要释放的用户锁
+ * @param sec           小于 0 表示一直等待
+ * @return              false 表示超时
+ */
+static bool waitHelper(SpinMutex &mutex, CoWaitQueue &queue, const Seconds &sec, CoMutex *release = nullptr)
+{
+    CoWaiter    w;
+    w.prepare();
+
+    // 无超时的等待没有失败返回值，不响应取消
+    w.cancellable = sec >= 0;
+
+    queue.push(&w);
+    mutex.unlock();
+
+    if (release) {
+        release->unlock();
+    }
+
+    if (w.sleep(sec)) {
+        return true;
+    }
+
+    std::unique_lock<SpinMutex>     lk(mutex);
+
+    queue.remove(&w);
+
+    return false;
+}
+
+// ################################################################
+
+void CoMutex::lock()
+{
+    m_mutex.lock();
+
+    if (! m_locked) {
+        m_locked = true;
+
+        m_mutex.unlock();
+        return;
+    }
+
+    // unlock 时所有权直接转交，醒来即持有锁
+    waitHelper(m_mutex, m_waitQueue, -1);
+}
+
+bool CoMutex::tryLock()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    if (m_locked) {
+        return false;
+    }
+    m_locked = true;
+
+    return true;
+}
+
+void CoMutex::unlock()
+{
+    CoWakeup    wakeup;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        if (! m_waitQueue.notifyOne(wakeup)) {
+            m_locked = false;
+        }
+    }
+
+    wakeup();
+}
+
+// ################################################################
+
+CoSemaphore::CoSemaphore(int value)
+{
+    m_value = value;
+}
+
+void CoSemaphore::wait()
+{
+    waitFor(-1);
+}
+
+bool CoSemaphore::waitFor(const Seconds &sec)
+{
+    m_mutex.lock();
+
+    if (m_value > 0) {
+        m_value --;
+
+        m_mutex.unlock();
+        return true;
+    }
+
+    if (sec == 0) {
+        m_mutex.unlock();
+        return false;
+    }
+
+    // post 时计数直接转交给等待者
+    return waitHelper(m_mutex, m_waitQueue, sec);
+}
+
+bool CoSemaphore::tryWait()
+{
+    return waitFor(0);
+}
+
+void CoSemaphore::post()
+{
+    CoWakeup    wakeup;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        if (! m_waitQueue.notifyOne(wakeup)) {
+            m_value ++;
+        }
+    }
+
+    wakeup();
+}
+
+// ################################################################
+
+void CoConditionVariable::wait(CoMutex &mutex)
+{
+    waitFor(mutex, -1);
+}
+
+bool CoConditionVariable::waitFor(CoMutex &mutex, const Seconds &sec)
+{
+    m_mutex.lock();
+
+    auto ret = waitHelper(m_mutex, m_waitQueue, sec, &mutex);
+
+    mutex.lock();
+
+    return ret;
+}
+
+void CoConditionVariable::notifyOne()
+{
+    CoWakeup    wakeup;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        m_waitQueue.notifyOne(wakeup);
+    }
+
+    wakeup();
+}
+
+void CoConditionVariable::notifyAll()
+{
+    std::vector<CoWakeup>       wakeups;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        CoWakeup    wakeup;
+        while (m_waitQueue.notifyOne(wakeup)) {
+            wakeups.emplace_back(std::move(wakeup));
+        }
+    }
+
+    for (auto &it: wakeups) {
+        it();
+    }
+}
+
+// ################################################################
+
+CoEvent::CoEvent(bool autoReset)
+{
+    m_autoReset = autoReset;
+}
+
+void CoEvent::set()
+{
+    std::vector<CoWakeup>       wakeups;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        CoWakeup    wakeup;
+
+        if (m_autoReset) {
+            if (m_waitQueue.notifyOne(wakeup)) {
+                wakeups.emplace_back(std::move(wakeup));
+            }
+            else {
+                m_set = true;
+            }
+        }
+        else {
+            m_set = true;
+
+            while (m_waitQueue.notifyOne(wakeup)) {
+                wakeups.emplace_back(std::move(wakeup));
+            }
+        }
+    }
+
+    for (auto &it: wakeups) {
+        it();
+    }
+}
+
+void CoEvent::reset()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    m_set = false;
+}
+
+bool CoEvent::isSet()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_set;
+}
+
+void CoEvent::wait()
+{
+    waitFor(-1);
+}
+
+bool CoEvent::waitFor(const Seconds &sec)
+{
+    m_mutex.lock();
+
+    if (m_set) {
+        if (m_autoReset) {
+            m_set = false;
+        }
+
+        m_mutex.unlock();
+        return true;
+    }
+
+    if (sec == 0) {
+        m_mutex.unlock();
+        return false;
+    }
+
+    return waitHelper(m_mutex, m_waitQueue, sec);
+}
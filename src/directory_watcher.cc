@@ -0,0 +1,284 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/directory_watcher.h>
+
+using namespace SpaE;
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+
+#include <sys/stat.h>
+
+// 维护目录树所需的事件
+#define TreeMask        (IN_CREATE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+static bool isSubPath(const std::string &path, const std::string &dir)
+{
+    return path.size() > dir.size() && path[dir.size()] == '/' && ! path.compare(0, dir.size(), dir);
+}
+
+DirectoryWatcher::DirectoryWatcher(int isolate) : m_isolate(isolate)
+{
+
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    close();
+}
+
+bool DirectoryWatcher::watch(const char *root, uint32_t mask)
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    m_mask |= mask;
+
+    if (! m_notifier) {
+        m_notifier = new FdOperator(-1, root);
+        m_notifier->moveToLoop(getLoop());
+
+        connect(m_notifier, &m_notifier->signalInotifyEvents, this, &DirectoryWatcher::onEvents);
+
+        m_notifier->setInotifyCoalesce(m_coalesce);
+
+        // isolate 时先创建自己的 inotify fd，之后的关注都加在它上面
+        if (m_isolate) {
+            m_notifier->inotifyWatch(m_mask | TreeMask, m_isolate);
+        }
+    }
+
+    std::string dir = root;
+    while (dir.size() > 1 && dir.back() == '/') {
+        dir.pop_back();
+    }
+
+    return addTree(dir, nullptr);
+}
+
+void DirectoryWatcher::setCoalesce(double sec)
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    m_coalesce = sec;
+
+    if (m_notifier) {
+        m_notifier->setInotifyCoalesce(sec);
+    }
+}
+
+size_t DirectoryWatcher::getWatchCount()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_wdPaths.size();
+}
+
+size_t DirectoryWatcher::getErrorCount()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_errors;
+}
+
+void DirectoryWatcher::close()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    // 关闭时取消所有关注
+    delete m_notifier;
+    m_notifier = nullptr;
+
+    m_wdPaths.clear();
+    m_pathWds.clear();
+}
+
+bool DirectoryWatcher::addTree(const std::string &dir, std::vector<DirectoryEvent> *created)
+{
+    std::vector<std::string>    stack = { dir };
+
+    bool    ok = true;
+
+    while (! stack.empty()) {
+        auto path = std::move(stack.back());
+        stack.pop_back();
+
+        // 先关注再列目录，列出之后新建的条目由事件通知
+        auto wd = m_notifier->inotifyAdd(path.data(), m_mask | TreeMask);
+        if (wd < 0) {
+            if (path == dir) {
+                ok = false;
+            }
+            else {
+                m_errors ++;
+            }
+            continue;
+        }
+
+        m_wdPaths[wd] = path;
+        m_pathWds[path] = wd;
+
+        auto d = opendir(path.data());
+        if (! d) {
+            continue;
+        }
+
+        while (auto ent = readdir(d)) {
+            if (! strcmp(ent->d_name, ".") || ! strcmp(ent->d_name, "..")) {
+                continue;
+            }
+
+            auto child = path + "/" + ent->d_name;
+
+            auto isDir = ent->d_type == DT_DIR;
+
+            // 部分文件系统不提供 d_type，符号链接不跟随
+            if (ent->d_type == DT_UNKNOWN) {
+                struct stat st;
+                isDir = ! lstat(child.data(), &st) && S_ISDIR(st.st_mode);
+            }
+
+            if (created) {
+                created->emplace_back(DirectoryEvent { child, (uint32_t) (IN_CREATE | (isDir ? IN_ISDIR : 0)) });
+            }
+
+            if (isDir) {
+                stack.emplace_back(std::move(child));
+            }
+        }
+
+        closedir(d);
+    }
+
+    return ok;
+}
+
+void DirectoryWatcher::removeTree(const std::string &dir)
+{
+    for (auto it = m_pathWds.begin(); it != m_pathWds.end(); ) {
+        if (it->first != dir && ! isSubPath(it->first, dir)) {
+            it ++;
+            continue;
+        }
+
+        m_notifier->inotifyRemove(it->second);
+        m_wdPaths.erase(it->second);
+
+        it = m_pathWds.erase(it);
+    }
+}
+
+void DirectoryWatcher::renameTree(const std::string &from, const std::string &to)
+{
+    std::vector<std::pair<std::string, int>>    moved;
+
+    for (auto it = m_pathWds.begin(); it != m_pathWds.end(); ) {
+        if (it->first != from && ! isSubPath(it->first, from)) {
+            it ++;
+            continue;
+        }
+
+        moved.emplace_back(to + it->first.substr(from.size()), it->second);
+
+        it = m_pathWds.erase(it);
+    }
+
+    for (auto &m: moved) {
+        m_wdPaths[m.second] = m.first;
+        m_pathWds[m.first] = m.second;
+    }
+}
+
+void DirectoryWatcher::onEvents(InotifyBatch events)
+{
+    std::vector<DirectoryEvent>     out;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        if (! m_notifier) {
+            return;
+        }
+
+        auto created = m_mask & IN_CREATE ? &out : nullptr;
+
+        // 同一批中移出的目录，按 cookie 与移入配对即为树内改名
+        std::unordered_map<uint32_t, std::string>   movedFrom;
+
+        for (auto &e: *events) {
+            if (e.mask & IN_Q_OVERFLOW) {
+                out.emplace_back(DirectoryEvent { "", IN_Q_OVERFLOW });
+                continue;
+            }
+
+            auto it = m_wdPaths.find(e.wd);
+            if (it == m_wdPaths.end()) {
+                continue;
+            }
+
+            // 目录已删除，内核移除了关注
+            if (e.mask & IN_IGNORED) {
+                auto pw = m_pathWds.find(it->second);
+                if (pw != m_pathWds.end() && pw->second == e.wd) {
+                    m_pathWds.erase(pw);
+                }
+                m_wdPaths.erase(it);
+                continue;
+            }
+
+            auto path = e.name.empty() ? it->second : it->second + "/" + e.name;
+
+            if (e.mask & m_mask) {
+                out.emplace_back(DirectoryEvent { path, e.mask });
+            }
+
+            if (! (e.mask & IN_ISDIR)) {
+                continue;
+            }
+
+            if (e.mask & IN_CREATE) {
+                addTree(path, created);
+            }
+            else if (e.mask & IN_MOVED_FROM) {
+                movedFrom[e.cookie] = path;
+            }
+            else if (e.mask & IN_MOVED_TO) {
+                auto mf = movedFrom.find(e.cookie);
+                if (mf != movedFrom.end()) {
+                    renameTree(mf->second, path);
+                    movedFrom.erase(mf);
+                }
+                else {
+                    addTree(path, created);
+                }
+            }
+        }
+
+        // 没有配对的移出，目录离开了关注的树
+        for (auto &mf: movedFrom) {
+            removeTree(mf.second);
+        }
+    }
+
+    if (! out.empty()) {
+        emit signalEvents(std::make_shared<const std::vector<DirectoryEvent>>(std::move(out)));
+    }
+}
+
+#endif
@@ -17,153 +17,2309 @@
  */
 
 #include <SpaE/fd_operator.h>
+#include <SpaE/coroutine.h>
 
 using namespace SpaE;
 
 #ifdef __linux__
 
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <limits.h>
 #include <termios.h>
+#include <poll.h>
 
+#include <algorithm>
+#include <deque>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <SpaE/timer.h>
+
+#include "io_uring.h"
 
 #define EpollSize       8
 
-struct FdOperatorAliveInfo {
-    SharedAliveMutex    alive;
+// 缓冲写一次 writev 最多的缓冲块数
+#define OutIovMax       64
+
+// 缓冲写链尾新分配缓冲的最小容量，之后的小块数据拷贝进来合并写出
+#define OutChunkSize    4096
+
+// inotify 每次 read 的缓冲，一次可以取出几千个事件
+#define InotifyBufSize  (256 * 1024)
+
+// 一次就绪最多 read 的次数，避免持续写入时饿死同一线程上的其它 fd
+#define InotifyDrainRounds  16
+
+struct DatagramRing {
+    size_t      bufSize;
+
+    // 每个槽位一块接收缓冲，被接收者持有时换一块新的
+    std::vector<BufferRef>                  bufs;
+
+    std::vector<struct mmsghdr>             msgs;
+    std::vector<struct iovec>               iovs;
+    std::vector<struct sockaddr_storage>    addrs;
+
+    DatagramRing(int batch, size_t size) :
+        bufSize(size), bufs(batch), msgs(batch), iovs(batch), addrs(batch)
+    {
+
+    }
+};
+
+// 协程等待者，或一次性回调（在 SpaE::FdA 线程中执行）
+struct SpaE::AsyncWaiter {
+    // waitReady 栈上的等待者，取走时在 asyncMutex 内抢占，抢占失败说明已被取消
+    CoWaiter        *waiter = nullptr;
+
+    // 同在 waitReady 栈上，抢占成功后才写入，恢复后不需要访问 FdOperator 即可得知被关闭
+    bool            *cancelled = nullptr;
+
+    // 抢占后得到的唤醒动作，释放锁之后执行
+    CoWakeup        wakeup;
+
+    Loop::WorkFun   fun;
+
+    bool empty() const
+    {
+        return ! waiter && ! fun;
+    }
+};
+
+/**
+ * epoll / inotify / 异步等待的登记记录，epoll_event.data.ptr 直接指向它，分发时不需要查表和全局锁
+ * 由 FdOperator 持有，关闭后等所有反应器线程（含 SpaE::FdA）都经过静止点再释放（见 retireWatchRecord）
+ */
+struct SpaE::FdWatchRecord {
+    FdOperator      *o;
+
+    int     fd = -1;
+
+    // 登记所在的 epoll 实例
+    int     epollFd = -1;
+
+    enum Kind {
+        Epoll,
+
+        // 自己的 inotify fd（isolate），或共享 inotify 实例上的订阅者（不在 epoll 上，fd 为 -1）
+        Inotify,
+
+        // 共享 inotify 实例的 fd 和合并窗口的 timerfd
+        InotifyShared,
+        InotifyTimer,
+
+        // 协程异步读写的等待者，在 SpaE::FdA 的 epoll 实例上
+        Async,
+    };
+
+    Kind    kind = Epoll;
+
+    // 数据模式（dataWatch）的缓冲大小，0 表示只通知就绪事件
+    size_t  drainSize = 0;
+
+    // 数据报模式（datagramWatch）的接收环，只由关注该 fd 的反应器线程访问
+    std::unique_ptr<DatagramRing>   ring;
+
+    // 共享 inotify 实例上的订阅：wd → 关注的事件，以及合并窗口中的事件，由 InotifyHub::mutex 保护
+    std::unordered_map<int, uint32_t>   wds;
+
+    double  coalesce = 0;
+    double  coalesceDeadline = 0;
+
+    std::vector<InotifyEvent>   coalesced;
+    std::unordered_map<std::string, size_t>     coalescedIndex;
+
+    // Async 记录的等待者，由 asyncMutex 保护，每个方向可有多个，就绪时全部取走；
+    // asyncAdded 表示已加入 epoll（ONESHOT 触发后仍在其中）
+    SpinMutex       asyncMutex;
+
+    std::vector<AsyncWaiter>    readWaiters,
+                                writeWaiters;
+
+    bool            asyncAdded = false;
+
+    // 正在分发的线程数，关闭时等待归零，之后不会再 emit
+    std::atomic<int>    busy { 0 };
+    std::atomic<bool>   closed { false };
+};
+
+// 当前线程正在分发的记录，在槽函数中关闭自身时不等待
+static thread_local FdWatchRecord   *t_dispatching = nullptr;
+
+static inline bool watchRecordEnter(FdWatchRecord *rec)
+{
+    rec->busy ++;
+
+    if (rec->closed) {
+        rec->busy --;
+        return false;
+    }
+
+    t_dispatching = rec;
+    return true;
+}
+
+static inline void watchRecordLeave(FdWatchRecord *rec)
+{
+    t_dispatching = nullptr;
+
+    rec->busy --;
+}
+
+/**
+ * 反应器线程的静止计数：epoll_wait 返回后加一（奇数，分发中），分发完再加一（偶数）
+ */
+struct ReactorEpoch {
+    std::atomic<uint64_t>   seq { 0 };
+
+    std::atomic<bool>       exited { false };
+};
+
+using SharedReactorEpoch = std::shared_ptr<ReactorEpoch>;
+
+struct RetiredWatchRecord {
+    FdWatchRecord   *rec;
+
+    // 退休时各反应器线程的静止计数
+    std::vector<std::pair<SharedReactorEpoch, uint64_t>>    snapshot;
+};
+
+static std::vector<SharedReactorEpoch>      g_reactorEpochs;
+static std::vector<RetiredWatchRecord>      g_retiredRecords;
+static std::atomic<int>     g_retiredCount { 0 };
+static SpinMutex            g_reclaimMutex;
+
+static SharedReactorEpoch registerReactorEpoch()
+{
+    auto epoch = std::make_shared<ReactorEpoch>();
+
+    std::unique_lock<decltype(g_reclaimMutex)>  lk(g_reclaimMutex);
+
+    g_reactorEpochs.emplace_back(epoch);
+
+    return epoch;
+}
+
+static void unregisterReactorEpoch(const SharedReactorEpoch &epoch)
+{
+    std::unique_lock<decltype(g_reclaimMutex)>  lk(g_reclaimMutex);
+
+    epoch->exited = true;
+
+    g_reactorEpochs.erase(std::find(g_reactorEpochs.begin(), g_reactorEpochs.end(), epoch));
+}
+
+/**
+ * @brief               释放所有反应器线程都已经过静止点的记录
+ */
+static void reclaimWatchRecords()
+{
+    if (! g_retiredCount) {
+        return;
+    }
+
+    std::vector<FdWatchRecord *>    freed;
+    {
+        std::unique_lock<decltype(g_reclaimMutex)>  lk(g_reclaimMutex);
+
+        for (auto it = g_retiredRecords.begin(); it != g_retiredRecords.end(); ) {
+            bool    passed = true;
+
+            // 退休时正在分发（奇数）的线程要等这一轮结束；空闲（偶数）的线程可能刚取到事件还没开始分发，要再等一轮
+            for (auto &snap: it->snapshot) {
+                if (! snap.first->exited && snap.first->seq < (snap.second | 1) + 1) {
+                    passed = false;
+                    break;
+                }
+            }
+
+            if (passed) {
+                freed.emplace_back(it->rec);
+                it = g_retiredRecords.erase(it);
+            }
+            else {
+                it ++;
+            }
+        }
+
+        g_retiredCount = g_retiredRecords.size();
+    }
+
+    for (auto rec: freed) {
+        delete rec;
+    }
+}
+
+/**
+ * @brief               记录已从 epoll 上移除，但反应器线程可能已经取到指向它的事件，延迟到静止点之后释放
+ */
+static void retireWatchRecord(FdWatchRecord *rec)
+{
+    {
+        std::unique_lock<decltype(g_reclaimMutex)>  lk(g_reclaimMutex);
+
+        RetiredWatchRecord  retired;
+        retired.rec = rec;
+
+        for (auto &epoch: g_reactorEpochs) {
+            retired.snapshot.emplace_back(epoch, epoch->seq.load());
+        }
+
+        g_retiredRecords.emplace_back(std::move(retired));
+        g_retiredCount = g_retiredRecords.size();
+    }
+
+    reclaimWatchRecords();
+}
+
+// 协程异步读写的等待者记录，由 FdOperator 和 FdIoState 共同持有，最后一个持有者释放时交给回收
+using SharedAsyncRecord = std::shared_ptr<FdWatchRecord>;
+
+// readSubmit / writeSubmit 的状态，由进行中的请求共享，FdOperator 析构后仍可能存活
+struct SpaE::FdIoState {
+    SpinMutex       mutex;
+
+    FdOperator      *o;
+    int             fd;
+
+    SharedAliveMutex    alive;
+
+    SharedAsyncRecord   async;
+
+    std::atomic<bool>   closed { false };
+
+    // 曾经提交过 io_uring 请求，关闭时需要取消
+    std::atomic<bool>   usedUring { false };
+
+    // 排队中的读请求长度，reading 表示有一个读请求正在执行
+    std::deque<size_t>      reads;
+    bool            reading = false;
+
+    // 排队中的写缓冲，队首正在写，已写入 writeOffset 字节
+    std::deque<BufferRef>   writes;
+    size_t          writeOffset = 0;
+    bool            writing = false;
+
+    // 缓冲写（writeBuffered）的缓冲链，队首已写出 outOffset 字节，共积压 outSize 字节
+    std::deque<BufferRef>   outChain;
+    size_t          outOffset = 0;
+    size_t          outSize = 0;
+
+    // 链尾缓冲由本模块分配，可以继续追加
+    bool            outTailOwned = false;
+
+    // 有线程正在写出，或已在 epoll 上等待 EPOLLOUT
+    bool            outFlushing = false;
+
+    size_t          outHighWatermark = 1 << 20;
+    bool            outAboveHigh = false;
+
+    // 写出出错的 errno，之后不再接受缓冲写
+    int             outError = 0;
+};
+
+using SharedFdIoState = std::shared_ptr<FdIoState>;
+
+static std::atomic<bool>    g_uringEnabled { true };
+
+/**
+ * @brief               在 asyncMutex 内取走一个方向上的全部等待者
+ * @param cancelled     是否因关闭而取走
+ * @param out           取走的等待者追加于此，已被取消的协程等待者不会出现
+ */
+static inline void takeAsyncWaiters(std::vector<AsyncWaiter> &list, bool cancelled, std::vector<AsyncWaiter> &out)
+{
+    for (auto &w : list) {
+        if (! w.waiter) {
+            out.push_back(std::move(w));
+            continue;
+        }
+
+        // 抢占失败时等待者已因 Coroutine::cancel 返回，正等待锁以移出自己，栈随后失效
+        if (! w.waiter->claim()) {
+            continue;
+        }
+
+        if (cancelled) {
+            *w.cancelled = true;
+        }
+
+        AsyncWaiter     taken;
+        w.waiter->complete(taken.wakeup);
+
+        // 之后 waiter 随时可能失效
+        out.push_back(std::move(taken));
+    }
+
+    list.clear();
+}
+
+static inline void resumeAsyncWaiters(std::vector<AsyncWaiter> &&list)
+{
+    for (auto &w : list) {
+        if (w.fun) {
+            w.fun();
+        }
+
+        w.wakeup();
+    }
+}
+
+static inline uint32_t asyncWaitEvents(const FdWatchRecord *rec)
+{
+    uint32_t events = EPOLLONESHOT;
+
+    if (! rec->readWaiters.empty()) {
+        events |= EPOLLIN;
+    }
+    if (! rec->writeWaiters.empty()) {
+        events |= EPOLLOUT;
+    }
+    return events;
+}
+
+static bool armAsyncWaiterHelper(FdWatchRecord *rec, int events, AsyncWaiter &&w);
+
+static inline Uring *ioUring(const SharedFdIoState &st)
+{
+    auto uring = g_uringEnabled ? Uring::getInstance() : nullptr;
+    if (uring) {
+        st->usedUring = true;
+    }
+    return uring;
+}
+
+static void ioReadRun(const SharedFdIoState &st, size_t len);
+static void ioWriteRun(const SharedFdIoState &st);
+
+/**
+ * @brief               读请求完成，emit 后取出下一个读请求
+ * @return              下一个读请求的长度，0 表示没有
+ */
+static size_t ioReadDone(const SharedFdIoState &st, BufferRef &&buf, int res)
+{
+    if (res > 0) {
+        buf->size = res;
+    }
+
+    {
+        std::unique_lock<decltype(st->alive->mutex)>    lk(st->alive->mutex);
+
+        if (st->alive->alive && ! st->closed) {
+            emit st->o->signalReadDone(buf, res);
+        }
+    }
+
+    std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+    if (st->reads.empty() || st->closed) {
+        st->reading = false;
+        return 0;
+    }
+
+    auto len = st->reads.front();
+    st->reads.pop_front();
+
+    return len;
+}
+
+/**
+ * @brief               写请求（队首）完成，emit 并出队
+ */
+static void ioWriteDone(const SharedFdIoState &st, int res)
+{
+    {
+        std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+        st->writes.pop_front();
+        st->writeOffset = 0;
+    }
+
+    std::unique_lock<decltype(st->alive->mutex)>    lk(st->alive->mutex);
+
+    if (st->alive->alive && ! st->closed) {
+        emit st->o->signalWriteDone(res);
+    }
+}
+
+struct FdReadOp : public UringOp
+{
+    SharedFdIoState     st;
+
+    BufferRef       buf;
+
+    size_t          len;
+
+    void complete(int res) override
+    {
+        if (res == -EAGAIN && ! st->closed) {
+            // 非阻塞 fd，等待就绪后重新提交
+            auto st = this->st;
+            auto buf = this->buf;
+            auto len = this->len;
+
+            AsyncWaiter     w;
+            w.fun = [=]
+            {
+                auto op = new FdReadOp();
+                op->st = st;
+                op->buf = buf;
+                op->len = len;
+
+                // 关闭时也会调用，此时 fd 号可能随后被复用，不再提交
+                if (st->closed) {
+                    op->complete(-ECANCELED);
+                }
+                else if (! Uring::getInstance()->read(st->fd, buf->data(), len, op)) {
+                    op->complete(-EBUSY);
+                }
+            };
+
+            if (armAsyncWaiterHelper(st->async.get(), EPOLLIN, std::move(w))) {
+                delete this;
+                return;
+            }
+
+            res = -errno;
+        }
+
+        auto next = ioReadDone(st, std::move(buf), res);
+        if (next) {
+            ioReadRun(st, next);
+        }
+
+        delete this;
+    }
+};
+
+struct FdWriteOp : public UringOp
+{
+    SharedFdIoState     st;
+
+    BufferRef       buf;
+
+    void complete(int res) override
+    {
+        if (res == -EAGAIN && ! st->closed) {
+            auto st = this->st;
+
+            AsyncWaiter     w;
+            w.fun = [=]
+            {
+                ioWriteRun(st);
+            };
+
+            if (armAsyncWaiterHelper(st->async.get(), EPOLLOUT, std::move(w))) {
+                delete this;
+                return;
+            }
+
+            res = -errno;
+        }
+
+        if (res < 0) {
+            ioWriteDone(st, res);
+        }
+        else {
+            bool    done;
+            {
+                std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+                st->writeOffset += res;
+
+                done = st->writeOffset >= buf->size;
+            }
+
+            if (done) {
+                ioWriteDone(st, buf->size);
+            }
+        }
+
+        ioWriteRun(st);
+
+        delete this;
+    }
+};
+
+/**
+ * @brief               执行读请求，直到需要等待（io_uring 已提交或在 epoll 上等待就绪）
+ */
+static void ioReadRun(const SharedFdIoState &st, size_t len)
+{
+    while (len) {
+        if (st->closed) {
+            ioReadDone(st, BufferRef(), -ECANCELED);
+            return;
+        }
+
+        auto buf = Buffer::alloc(len);
+
+        auto uring = ioUring(st);
+        if (uring) {
+            auto op = new FdReadOp();
+            op->st = st;
+            op->buf = buf;
+            op->len = len;
+
+            if (uring->read(st->fd, buf->data(), len, op)) {
+                return;
+            }
+            delete op;
+        }
+
+        ssize_t     n;
+        do {
+            n = ::read(st->fd, buf->data(), len);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            AsyncWaiter     w;
+            w.fun = [st, len]
+            {
+                ioReadRun(st, len);
+            };
+
+            if (armAsyncWaiterHelper(st->async.get(), EPOLLIN, std::move(w))) {
+                return;
+            }
+        }
+
+        len = ioReadDone(st, std::move(buf), n < 0 ? -errno : n);
+    }
+}
+
+/**
+ * @brief               执行写队列，直到队列为空或需要等待
+ */
+static void ioWriteRun(const SharedFdIoState &st)
+{
+    for (;;) {
+        BufferRef   buf;
+        size_t      offset;
+        {
+            std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+            if (st->writes.empty() || st->closed) {
+                st->writing = false;
+                return;
+            }
+
+            buf = st->writes.front();
+            offset = st->writeOffset;
+        }
+
+        auto uring = ioUring(st);
+        if (uring) {
+            auto op = new FdWriteOp();
+            op->st = st;
+            op->buf = buf;
+
+            if (uring->write(st->fd, buf->data() + offset, buf->size - offset, op)) {
+                return;
+            }
+            delete op;
+        }
+
+        ssize_t     n;
+        do {
+            n = ::write(st->fd, buf->data() + offset, buf->size - offset);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            AsyncWaiter     w;
+            w.fun = [st]
+            {
+                ioWriteRun(st);
+            };
+
+            if (armAsyncWaiterHelper(st->async.get(), EPOLLOUT, std::move(w))) {
+                return;
+            }
+        }
+
+        if (n < 0) {
+            ioWriteDone(st, -errno);
+            continue;
+        }
+
+        bool    done;
+        {
+            std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+            st->writeOffset += n;
+
+            done = st->writeOffset >= buf->size;
+        }
+
+        if (done) {
+            ioWriteDone(st, buf->size);
+        }
+    }
+}
+
+/**
+ * @brief               写出缓冲链，直到清空、出错或需要等待 EPOLLOUT
+ */
+static void ioOutFlush(const SharedFdIoState &st)
+{
+    for (;;) {
+        struct iovec    iov[OutIovMax];
+        int             count = 0;
+        {
+            std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+            if (st->closed) {
+                st->outFlushing = false;
+                return;
+            }
+
+            if (st->outChain.empty()) {
+                st->outFlushing = false;
+                st->outAboveHigh = false;
+                break;
+            }
+
+            // 链尾之后追加的数据在下一轮写出
+            auto offset = st->outOffset;
+            for (auto &b: st->outChain) {
+                if (count == OutIovMax) {
+                    break;
+                }
+
+                iov[count].iov_base = b->data() + offset;
+                iov[count].iov_len = b->size - offset;
+                count ++;
+
+                offset = 0;
+            }
+        }
+
+        ssize_t     n;
+        do {
+            n = ::writev(st->fd, iov, count);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            AsyncWaiter     w;
+            w.fun = [st]
+            {
+                ioOutFlush(st);
+            };
+
+            if (armAsyncWaiterHelper(st->async.get(), EPOLLOUT, std::move(w))) {
+                return;
+            }
+        }
+
+        if (n < 0) {
+            auto err = errno;
+            {
+                std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+                st->outChain.clear();
+                st->outOffset = 0;
+                st->outSize = 0;
+                st->outTailOwned = false;
+                st->outFlushing = false;
+                st->outError = err;
+            }
+
+            std::unique_lock<decltype(st->alive->mutex)>    lk(st->alive->mutex);
+
+            if (st->alive->alive && ! st->closed) {
+                emit st->o->signalWriteDone(-err);
+            }
+            return;
+        }
+
+        std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+        st->outSize -= n;
+
+        while (n > 0) {
+            auto &b = st->outChain.front();
+            auto remain = b->size - st->outOffset;
+
+            if ((size_t) n < remain) {
+                st->outOffset += n;
+                break;
+            }
+
+            n -= remain;
+            st->outChain.pop_front();
+            st->outOffset = 0;
+        }
+
+        if (st->outChain.empty()) {
+            st->outTailOwned = false;
+        }
+    }
+
+    std::unique_lock<decltype(st->alive->mutex)>    lk(st->alive->mutex);
+
+    if (st->alive->alive && ! st->closed) {
+        emit st->o->signalDrained();
+    }
+}
+
+/**
+ * @brief               追加到缓冲链，ref 为空时把数据拷贝进链尾缓冲，否则直接链入 ref
+ *                      没有线程在写出时由调用线程开始写出
+ */
+static bool ioOutAppend(const SharedFdIoState &st, const void *data, size_t len, const BufferRef &ref)
+{
+    if (! len) {
+        return true;
+    }
+
+    bool    flush, high;
+    size_t  size;
+    {
+        std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+        if (st->closed || st->outError) {
+            return false;
+        }
+
+        auto tail = st->outChain.empty() ? nullptr : st->outChain.back().get();
+
+        if (ref) {
+            st->outChain.emplace_back(ref);
+            st->outTailOwned = false;
+        }
+        else if (st->outTailOwned && tail->capacity - tail->size >= len) {
+            // 写出中的只是链尾已有的部分，追加的区域不会被同时读取
+            memcpy(tail->data() + tail->size, data, len);
+            tail->size += len;
+        }
+        else {
+            auto b = Buffer::alloc(std::max(len, (size_t) OutChunkSize));
+
+            memcpy(b->data(), data, len);
+            b->size = len;
+
+            st->outChain.emplace_back(std::move(b));
+            st->outTailOwned = true;
+        }
+
+        st->outSize += len;
+        size = st->outSize;
+
+        high = ! st->outAboveHigh && size > st->outHighWatermark;
+        if (high) {
+            st->outAboveHigh = true;
+        }
+
+        flush = ! st->outFlushing;
+        st->outFlushing = true;
+    }
+
+    // 调用者即 FdOperator 本身，不需要 alive 锁
+    if (high) {
+        emit st->o->signalHighWatermark(size);
+    }
+
+    if (flush) {
+        ioOutFlush(st);
+    }
+
+    return true;
+}
+
+/**
+ * @brief               数据模式：边沿触发下把 fd 读空，每块数据 emit 一次 signalData
+ */
+static void epollDrain(FdWatchRecord *rec, uint32_t events)
+{
+    // 对端已关闭时要一直读到 EOF，之后不会再有新的边沿
+    auto hangup = events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR);
+
+    while (! rec->closed) {
+        auto buf = Buffer::alloc(rec->drainSize);
+
+        ssize_t     n;
+        do {
+            n = ::read(rec->fd, buf->data(), buf->capacity);
+        } while (n < 0 && errno == EINTR);
+
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+
+        // EOF 或出错，通知一次空 buffer 后不再关注
+        if (n <= 0) {
+            epoll_ctl(rec->epollFd, EPOLL_CTL_DEL, rec->fd, nullptr);
+
+            emit rec->o->signalData(BufferRef());
+            return;
+        }
+
+        buf->size = n;
+
+        emit rec->o->signalData(buf);
+
+        // 流式 fd 读不满说明内核缓冲已空，之后的数据会产生新的边沿
+        if ((size_t) n < buf->capacity && ! hangup) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief               数据报模式：边沿触发下用 recvmmsg 收空 fd，每批 emit 一次 signalDatagrams
+ */
+static void epollRecvBatch(FdWatchRecord *rec)
+{
+    auto &ring = *rec->ring;
+    auto batch = (int) ring.bufs.size();
+
+    while (! rec->closed) {
+        for (int i = 0; i < batch; i ++) {
+            auto &buf = ring.bufs[i];
+
+            // 上一批的缓冲仍被接收者持有时换一块，否则原地复用
+            if (! buf || buf->refCount.load(std::memory_order_acquire) != 1) {
+                buf = Buffer::alloc(ring.bufSize);
+            }
+
+            ring.iovs[i].iov_base = buf->data();
+            ring.iovs[i].iov_len = ring.bufSize;
+
+            auto &hdr = ring.msgs[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &ring.addrs[i];
+            hdr.msg_namelen = sizeof(ring.addrs[i]);
+            hdr.msg_iov = &ring.iovs[i];
+            hdr.msg_iovlen = 1;
+        }
+
+        int n;
+        do {
+            n = recvmmsg(rec->fd, ring.msgs.data(), batch, MSG_DONTWAIT, nullptr);
+        } while (n < 0 && errno == EINTR);
+
+        if (n <= 0) {
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                epoll_ctl(rec->epollFd, EPOLL_CTL_DEL, rec->fd, nullptr);
+            }
+            return;
+        }
+
+        auto msgs = std::make_shared<std::vector<Datagram>>(n);
+
+        for (int i = 0; i < n; i ++) {
+            auto &d = (*msgs)[i];
+            auto &hdr = ring.msgs[i].msg_hdr;
+
+            d.buf = ring.bufs[i];
+            d.buf->size = ring.msgs[i].msg_len;
+
+            d.addrLen = hdr.msg_namelen;
+            memcpy(&d.addr, &ring.addrs[i], hdr.msg_namelen);
+        }
+
+        emit rec->o->signalDatagrams(msgs);
+
+        // 收不满说明队列已空，之后的数据报会产生新的边沿
+        if (n < batch) {
+            return;
+        }
+    }
+}
+
+static void epollDispatch(FdWatchRecord *rec, uint32_t events)
+{
+    if (! watchRecordEnter(rec)) {
+        return;
+    }
+
+    if (rec->ring) {
+        epollRecvBatch(rec);
+    }
+    else if (rec->drainSize) {
+        epollDrain(rec, events);
+    }
+    else {
+        emit rec->o->signalEpollWatch(events);
+    }
+
+    watchRecordLeave(rec);
+}
+
+/**
+ * @brief               读空 inotify fd，每次 read 得到的事件调用一次 fn(events)
+ */
+template <typename Fn>
+static void inotifyDrain(int fd, Fn &&fn)
+{
+    // 只在实际读取 inotify 的线程上分配
+    static thread_local std::vector<char>   buf;
+
+    if (buf.empty()) {
+        buf.resize(InotifyBufSize);
+    }
+
+    for (int round = 0; round < InotifyDrainRounds; round ++) {
+        auto len = ::read(fd, buf.data(), buf.size());
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        std::vector<InotifyEvent>   events;
+
+        for (auto p = buf.data(); p < buf.data() + len; ) {
+            auto event = (struct inotify_event *) p;
+
+            events.emplace_back(InotifyEvent { event->wd, event->mask, event->cookie, event->len ? event->name : "" });
+
+            p += sizeof(struct inotify_event) + event->len;
+        }
+
+        fn(std::move(events));
+    }
+}
+
+static void inotifyEmit(FdWatchRecord *rec, std::vector<InotifyEvent> &&events)
+{
+    InotifyBatch    batch = std::make_shared<const std::vector<InotifyEvent>>(std::move(events));
+
+    emit rec->o->signalInotifyEvents(batch);
+
+    for (auto &event: *batch) {
+        emit rec->o->signalInotifyWatch(event.mask);
+    }
+}
+
+static void inotifyDispatch(FdWatchRecord *rec)
+{
+    if (! watchRecordEnter(rec)) {
+        return;
+    }
+
+    inotifyDrain(rec->fd,
+        [=] (std::vector<InotifyEvent> &&events)
+        {
+            inotifyEmit(rec, std::move(events));
+        }
+    );
+
+    watchRecordLeave(rec);
+}
+
+/**
+ * 进程共享的 inotify 实例，所有非 isolate 的关注都在一个 fd 上，由 SpaE::FdI 线程读取。
+ * 同一路径在内核中只有一个 wd，多个订阅者共享，内核中的关注掩码为各订阅者之和，分发时按订阅者各自的掩码过滤
+ */
+struct InotifyHub {
+    int     fd = -1;
+    int     timerFd = -1;
+
+    FdWatchRecord   readRec, timerRec;
+
+    std::unordered_map<int, std::vector<FdWatchRecord *>>   subs;
+
+    // 合并窗口中有事件的订阅者
+    std::vector<FdWatchRecord *>    coalescing;
+
+    // timerfd 当前的到期时间，0 表示未启动
+    double  timerDeadline = 0;
+
+    SpinMutex   mutex;
+};
+
+static InotifyHub   *g_inotifyHub = nullptr;
+
+struct InotifyDelivery {
+    FdWatchRecord   *rec;
+
+    std::vector<InotifyEvent>   events;
+};
+
+// 持有 hub->mutex 时调用
+static void inotifyArmTimer(InotifyHub *hub, double deadline)
+{
+    struct itimerspec   its;
+    memset(&its, 0, sizeof(its));
+
+    hub->timerDeadline = deadline;
+
+    if (deadline > 0) {
+        auto delay = std::max(deadline - uptime(), 1e-6);
+
+        its.it_value.tv_sec = (time_t) delay;
+        its.it_value.tv_nsec = (long) ((delay - its.it_value.tv_sec) * 1e9);
+    }
+
+    timerfd_settime(hub->timerFd, 0, &its, nullptr);
+}
+
+// 持有 hub->mutex 时调用
+static void inotifyCoalesce(InotifyHub *hub, FdWatchRecord *rec, InotifyEvent &&event)
+{
+    if (rec->coalesced.empty()) {
+        rec->coalesceDeadline = uptime() + rec->coalesce;
+        hub->coalescing.emplace_back(rec);
+
+        if (! hub->timerDeadline || rec->coalesceDeadline < hub->timerDeadline) {
+            inotifyArmTimer(hub, rec->coalesceDeadline);
+        }
+    }
+
+    auto key = std::to_string(event.wd) + "/" + event.name;
+
+    auto it = rec->coalescedIndex.find(key);
+    if (it != rec->coalescedIndex.end()) {
+        auto &merged = rec->coalesced[it->second];
+
+        merged.mask |= event.mask;
+        merged.cookie = event.cookie;
+        return;
+    }
+
+    rec->coalescedIndex.emplace(std::move(key), rec->coalesced.size());
+    rec->coalesced.emplace_back(std::move(event));
+}
+
+/**
+ * @brief               锁外 emit，订阅者在此期间关闭时，记录在本线程经过静止点之前不会被释放
+ */
+static void inotifyDeliver(std::vector<InotifyDelivery> &out)
+{
+    for (auto &d: out) {
+        if (! watchRecordEnter(d.rec)) {
+            continue;
+        }
+
+        inotifyEmit(d.rec, std::move(d.events));
+
+        watchRecordLeave(d.rec);
+    }
+}
+
+static void inotifySharedRead()
+{
+    auto hub = g_inotifyHub;
+
+    inotifyDrain(hub->fd,
+        [=] (std::vector<InotifyEvent> &&events)
+        {
+            std::vector<InotifyDelivery>    out;
+            {
+                std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+                std::unordered_map<FdWatchRecord *, size_t>     index;
+
+                auto deliver = [&] (FdWatchRecord *rec, const InotifyEvent &event)
+                {
+                    if (rec->coalesce > 0) {
+                        inotifyCoalesce(hub, rec, InotifyEvent(event));
+                        return;
+                    }
+
+                    auto it = index.find(rec);
+                    if (it == index.end()) {
+                        it = index.emplace(rec, out.size()).first;
+                        out.emplace_back(InotifyDelivery { rec, {} });
+                    }
+
+                    out[it->second].events.emplace_back(event);
+                };
+
+                for (auto &event: events) {
+                    // 队列溢出，通知所有订阅者
+                    if (event.mask & IN_Q_OVERFLOW) {
+                        std::vector<FdWatchRecord *>    all;
+
+                        for (auto &sub: hub->subs) {
+                            all.insert(all.end(), sub.second.begin(), sub.second.end());
+                        }
+
+                        std::sort(all.begin(), all.end());
+                        all.erase(std::unique(all.begin(), all.end()), all.end());
+
+                        for (auto rec: all) {
+                            deliver(rec, event);
+                        }
+                        continue;
+                    }
+
+                    auto it = hub->subs.find(event.wd);
+                    if (it == hub->subs.end()) {
+                        continue;
+                    }
+
+                    for (auto rec: it->second) {
+                        if (event.mask & (rec->wds[event.wd] | IN_IGNORED | IN_UNMOUNT)) {
+                            deliver(rec, event);
+                        }
+                    }
+
+                    // 被关注的路径已删除，内核移除了该 wd
+                    if (event.mask & IN_IGNORED) {
+                        for (auto rec: it->second) {
+                            rec->wds.erase(event.wd);
+                        }
+                        hub->subs.erase(it);
+                    }
+                }
+            }
+
+            inotifyDeliver(out);
+        }
+    );
+}
+
+static void inotifySharedFlush()
+{
+    auto hub = g_inotifyHub;
+
+    uint64_t    expirations;
+    ::read(hub->timerFd, &expirations, sizeof(expirations));
+
+    std::vector<InotifyDelivery>    out;
+    {
+        std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+        auto now = uptime();
+        double next = 0;
+
+        for (auto it = hub->coalescing.begin(); it != hub->coalescing.end(); ) {
+            auto rec = *it;
+
+            if (rec->coalesceDeadline > now) {
+                if (! next || rec->coalesceDeadline < next) {
+                    next = rec->coalesceDeadline;
+                }
+                it ++;
+                continue;
+            }
+
+            it = hub->coalescing.erase(it);
+
+            out.emplace_back(InotifyDelivery { rec, std::move(rec->coalesced) });
+
+            rec->coalesced.clear();
+            rec->coalescedIndex.clear();
+        }
+
+        inotifyArmTimer(hub, next);
+    }
+
+    inotifyDeliver(out);
+}
+
+/**
+ * @brief               反应器线程主循环，data.ptr 为空的事件（分片的唤醒 eventfd）使其返回
+ */
+static void reactorRun(int epollFd)
+{
+    auto epoch = registerReactorEpoch();
+
+    struct epoll_event events[EpollSize];
+
+    for (bool quit = false; ! quit; ) {
+        auto ret = epoll_wait(epollFd, events, EpollSize, -1);
+
+        epoch->seq ++;
+
+        for(auto i = 0; i < ret; i ++) {
+            auto rec = (FdWatchRecord *) events[i].data.ptr;
+
+            if (! rec) {
+                quit = true;
+            }
+            else if (rec->kind == FdWatchRecord::Inotify) {
+                inotifyDispatch(rec);
+            }
+            else if (rec->kind == FdWatchRecord::InotifyShared) {
+                inotifySharedRead();
+            }
+            else if (rec->kind == FdWatchRecord::InotifyTimer) {
+                inotifySharedFlush();
+            }
+            else {
+                epollDispatch(rec, events[i].events);
+            }
+        }
+
+        epoch->seq ++;
+
+        reclaimWatchRecords();
+    }
+
+    unregisterReactorEpoch(epoch);
+}
+
+static int getEpollFd()
+{
+    static int fd = 0;
+    if(! fd) {
+        fd = epoll_create(EpollSize);
+
+        auto el = Loop::newInstance("SpaE::FdE");
+
+        el->work(
+            [=]
+            {
+                // 本线程不处理 Loop 队列，io_uring 请求需要立即提交
+                Uring::setSubmitImmediately(true);
+
+                reactorRun(fd);
+            }
+        );
+    }
+    return fd;
+}
+
+static int getInotifyEpollFd()
+{
+    static int fd = 0;
+
+    if(! fd) {
+        fd = epoll_create(EpollSize);
+
+        auto el = Loop::newInstance("SpaE::FdI");
+
+        el->work([=] {
+            Uring::setSubmitImmediately(true);
+
+            reactorRun(fd);
+        });
+    }
+    return fd;
+}
+
+static InotifyHub *getInotifyHub()
+{
+    static InotifyHub *hub = []
+    {
+        auto h = new InotifyHub();
+
+        h->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        h->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+        h->readRec.fd = h->fd;
+        h->readRec.kind = FdWatchRecord::InotifyShared;
+
+        h->timerRec.fd = h->timerFd;
+        h->timerRec.kind = FdWatchRecord::InotifyTimer;
+
+        g_inotifyHub = h;
+
+        auto epollFd = getInotifyEpollFd();
+
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+
+        ev.data.ptr = &h->readRec;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, h->fd, &ev);
+
+        ev.data.ptr = &h->timerRec;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, h->timerFd, &ev);
+
+        return h;
+    }();
+
+    return hub;
+}
+
+static int inotifySharedAdd(FdWatchRecord *rec, const char *path, uint32_t mask)
+{
+    auto hub = getInotifyHub();
+
+    std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+    // 与其它订阅者已有的关注合并，不覆盖
+    auto wd = inotify_add_watch(hub->fd, path, mask | IN_MASK_ADD);
+    if (wd < 0) {
+        return -1;
+    }
+
+    auto &subs = hub->subs[wd];
+    if (std::find(subs.begin(), subs.end(), rec) == subs.end()) {
+        subs.emplace_back(rec);
+    }
+
+    rec->wds[wd] |= mask;
+
+    return wd;
+}
+
+// 持有 hub->mutex 时调用
+static void inotifySharedRemoveLocked(InotifyHub *hub, FdWatchRecord *rec, int wd)
+{
+    rec->wds.erase(wd);
+
+    auto it = hub->subs.find(wd);
+    if (it == hub->subs.end()) {
+        return;
+    }
+
+    auto &subs = it->second;
+    subs.erase(std::remove(subs.begin(), subs.end(), rec), subs.end());
+
+    // 最后一个订阅者，其余情况内核中的掩码不收窄，多出的事件在分发时过滤
+    if (subs.empty()) {
+        inotify_rm_watch(hub->fd, wd);
+        hub->subs.erase(it);
+    }
+}
+
+static bool inotifySharedRemove(FdWatchRecord *rec, int wd)
+{
+    auto hub = getInotifyHub();
+
+    std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+    if (! rec->wds.count(wd)) {
+        return false;
+    }
+
+    inotifySharedRemoveLocked(hub, rec, wd);
+    return true;
+}
+
+/**
+ * @brief               关闭时取消所有订阅，合并窗口中尚未 emit 的事件被丢弃
+ */
+static void inotifySharedUnsubscribe(FdWatchRecord *rec)
+{
+    auto hub = getInotifyHub();
+
+    std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+    while (! rec->wds.empty()) {
+        inotifySharedRemoveLocked(hub, rec, rec->wds.begin()->first);
+    }
+
+    auto &coalescing = hub->coalescing;
+    coalescing.erase(std::remove(coalescing.begin(), coalescing.end(), rec), coalescing.end());
+}
+
+/**
+ * isolate 模式的反应器分片：一个 epoll 实例和一个线程，承载一个或多个 fd
+ */
+struct SpaE::ReactorShard {
+    int     epollFd = -1;
+    int     wakeFd = -1;
+
+    // 已登记的 fd 数量，归零时分片退出
+    int     fdCount = 0;
+
+    bool    dedicated = false;
+
+    // 在分片线程自身中释放时由线程退出前自行回收
+    std::atomic<bool>   selfRelease { false };
+
+    std::thread     thread;
+};
+
+static std::vector<ReactorShard *>      g_reactorShards;
+static SpinMutex        g_reactorShardsMutex;
+
+static int              g_shardLimit = 4;
+static int              g_fdsPerShard = 64;
+
+static std::atomic<int>     g_shardSeq { 0 };
+
+static void reactorShardRun(ReactorShard *shard, int seq)
+{
+    char nameBuf[16];
+    snprintf(nameBuf, sizeof(nameBuf), "SpaE::FdW::%d", seq);
+
+    pthread_setname_np(pthread_self(), nameBuf);
+
+    Uring::setSubmitImmediately(true);
+
+    reactorRun(shard->epollFd);
+
+    if (shard->selfRelease) {
+        shard->thread.detach();
+
+        ::close(shard->epollFd);
+        ::close(shard->wakeFd);
+
+        delete shard;
+    }
+}
+
+/**
+ * @brief               为一个 fd 选择分片，计数加一，需要时新建分片
+ */
+static ReactorShard *acquireReactorShard(bool dedicated)
+{
+    std::unique_lock<decltype(g_reactorShardsMutex)>    lk(g_reactorShardsMutex);
+
+    ReactorShard    *best = nullptr;
+
+    if (! dedicated) {
+        int shared = 0;
+
+        for (auto shard: g_reactorShards) {
+            if (shard->dedicated) {
+                continue;
+            }
+
+            shared ++;
+
+            if (! best || shard->fdCount < best->fdCount) {
+                best = shard;
+            }
+        }
+
+        // 最空的分片也满了，还能新建时新建
+        if (best && best->fdCount >= g_fdsPerShard && shared < g_shardLimit) {
+            best = nullptr;
+        }
+    }
+
+    if (! best) {
+        best = new ReactorShard();
+        best->dedicated = dedicated;
+        best->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        best->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;
+
+        epoll_ctl(best->epollFd, EPOLL_CTL_ADD, best->wakeFd, &ev);
+
+        best->thread = std::thread(reactorShardRun, best, g_shardSeq ++);
+
+        g_reactorShards.emplace_back(best);
+    }
+
+    best->fdCount ++;
+
+    return best;
+}
+
+/**
+ * @brief               fd 离开分片，分片上没有 fd 时退出线程并 join
+ */
+static void releaseReactorShard(ReactorShard *shard, int fd)
+{
+    epoll_ctl(shard->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+
+    {
+        std::unique_lock<decltype(g_reactorShardsMutex)>    lk(g_reactorShardsMutex);
+
+        if (-- shard->fdCount > 0) {
+            return;
+        }
+
+        g_reactorShards.erase(std::find(g_reactorShards.begin(), g_reactorShards.end(), shard));
+    }
+
+    // 在分片自己的线程中（比如 Sync 连接的槽函数里关闭）不能 join 自己
+    auto self = shard->thread.get_id() == std::this_thread::get_id();
+    if (self) {
+        shard->selfRelease = true;
+    }
+
+    uint64_t    v = 1;
+    ::write(shard->wakeFd, &v, sizeof(v));
+
+    if (self) {
+        return;
+    }
+
+    shard->thread.join();
+
+    ::close(shard->epollFd);
+    ::close(shard->wakeFd);
+
+    delete shard;
+}
+
+static int getAsyncEpollFd()
+{
+    static int fd = []
+    {
+        auto fd = epoll_create(EpollSize);
+
+        auto el = Loop::newInstance("SpaE::FdA");
+
+        el->work(
+            [=]
+            {
+                // 本线程不处理 Loop 队列，io_uring 请求需要立即提交
+                Uring::setSubmitImmediately(true);
+
+                // 与反应器线程一样参与记录回收，data.ptr 指向的记录在静止点之前不会释放
+                auto epoch = registerReactorEpoch();
+
+                struct epoll_event events[EpollSize];
+
+                while(true) {
+                    auto ret = epoll_wait(fd, events, EpollSize, -1);
+
+                    epoch->seq ++;
+
+                    for(auto i = 0; i < ret; i ++) {
+                        auto rec = (FdWatchRecord *) events[i].data.ptr;
+                        auto ev = events[i].events;
+
+                        if (! watchRecordEnter(rec)) {
+                            continue;
+                        }
+
+                        std::vector<AsyncWaiter>    woken;
+                        {
+                            std::unique_lock<decltype(rec->asyncMutex)>     lk(rec->asyncMutex);
+
+                            if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                                takeAsyncWaiters(rec->readWaiters, false, woken);
+                            }
+                            if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+                                takeAsyncWaiters(rec->writeWaiters, false, woken);
+                            }
+
+                            // 另一方向仍在等待, ONESHOT 需要重新武装
+                            if (! rec->readWaiters.empty() || ! rec->writeWaiters.empty()) {
+                                struct epoll_event rearm = {0};
+                                rearm.events = asyncWaitEvents(rec);
+                                rearm.data.ptr = rec;
+
+                                epoll_ctl(fd, EPOLL_CTL_MOD, rec->fd, &rearm);
+                            }
+                        }
+
+                        watchRecordLeave(rec);
+
+                        // 恢复的协程或回调可能关闭并释放 FdOperator，记录由回收保证仍然有效
+                        resumeAsyncWaiters(std::move(woken));
+                    }
+
+                    epoch->seq ++;
+
+                    reclaimWatchRecords();
+                }
+            }
+        );
+
+        return fd;
+    }();
+
+    return fd;
+}
+
+FdOperator::FdOperator(int fd, const char *path)
+{
+    m_fd = fd;
+    m_path = path;
+}
+
+FdOperator::FdOperator(const char *path, int o_flags)
+{
+    m_path = path;
+
+    m_fd = ::open(path, o_flags);
+    if(m_fd < 0) {
+        char buf[256];
+        sprintf(buf, "FdOperator open file(%s) error: ", path);
+        perror(buf);
+    }
+}
+
+FdOperator::~FdOperator()
+{
+    close();
+}
+
+int FdOperator::write(const void *buf, size_t len)
+{
+    return ::write(m_fd, buf, len);
+}
+
+int FdOperator::read(void *buf, size_t len)
+{
+    return ::read(m_fd, buf, len);
+}
+
+int FdOperator::readAsync(void *buf, size_t len)
+{
+    setNonBlock(true);
+
+    for (;;) {
+        auto ret = ::read(m_fd, buf, len);
+        if (ret >= 0) {
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return ret;
+        }
+
+        if (! waitReady(EPOLLIN)) {
+            return -1;
+        }
+    }
+}
+
+int FdOperator::writeAsync(const void *buf, size_t len)
+{
+    setNonBlock(true);
+
+    size_t  written = 0;
+
+    while (written < len) {
+        auto ret = ::write(m_fd, (const char *) buf + written, len - written);
+        if (ret >= 0) {
+            written += ret;
+            continue;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return written ? (int) written : -1;
+        }
+
+        if (! waitReady(EPOLLOUT)) {
+            return written ? (int) written : -1;
+        }
+    }
+
+    return written;
+}
+
+int FdOperator::readvAsync(const struct iovec *iov, int count)
+{
+    setNonBlock(true);
+
+    for (;;) {
+        auto ret = ::readv(m_fd, iov, count);
+        if (ret >= 0) {
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return ret;
+        }
+
+        if (! waitReady(EPOLLIN)) {
+            return -1;
+        }
+    }
+}
+
+int FdOperator::writevAsync(const struct iovec *iov, int count)
+{
+    setNonBlock(true);
+
+    // 部分写出后需要调整 iov，使用副本
+    std::vector<struct iovec>   vec(iov, iov + count);
+
+    auto    cur = vec.data();
+    auto    end = cur + count;
+    size_t  written = 0;
+
+    while (cur < end) {
+        auto ret = ::writev(m_fd, cur, std::min<ptrdiff_t>(end - cur, IOV_MAX));
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return written ? (int) written : -1;
+            }
+
+            if (! waitReady(EPOLLOUT)) {
+                return written ? (int) written : -1;
+            }
+            continue;
+        }
+
+        written += ret;
+
+        while (cur < end && (size_t) ret >= cur->iov_len) {
+            ret -= cur->iov_len;
+            cur ++;
+        }
+
+        if (cur < end) {
+            cur->iov_base = (char *) cur->iov_base + ret;
+            cur->iov_len -= ret;
+        }
+    }
+
+    return written;
+}
+
+static bool isPipe(int fd)
+{
+    struct stat st;
+
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+// spliceTo 的中转管道，用完后归还；管道中还有残留数据时直接关闭，不归还
+static std::vector<std::pair<int, int>>     g_splicePipes;
+static SpinMutex        g_splicePipesMutex;
+
+static bool acquireSplicePipe(int fds[2])
+{
+    {
+        std::unique_lock<decltype(g_splicePipesMutex)>  lk(g_splicePipesMutex);
+
+        if (! g_splicePipes.empty()) {
+            fds[0] = g_splicePipes.back().first;
+            fds[1] = g_splicePipes.back().second;
+            g_splicePipes.pop_back();
+
+            return true;
+        }
+    }
+
+    return pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0;
+}
+
+static void releaseSplicePipe(int fds[2], bool clean)
+{
+    if (clean) {
+        std::unique_lock<decltype(g_splicePipesMutex)>  lk(g_splicePipesMutex);
+
+        g_splicePipes.emplace_back(fds[0], fds[1]);
+        return;
+    }
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+/**
+ * @brief               一次协程感知的 splice，EAGAIN 时等待 waitOn 上的 events 就绪
+ * @return              同 ::splice，等待失败时返回 -1
+ */
+static ssize_t spliceOnce(int in, int out, size_t len, FdOperator *waitOn, int events)
+{
+    for (;;) {
+        auto ret = ::splice(in, nullptr, out, nullptr, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (ret >= 0) {
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return ret;
+        }
+
+        if (! waitOn->waitReady(events)) {
+            return -1;
+        }
+    }
+}
+
+ssize_t FdOperator::spliceTo(FdOperator *out, size_t len)
+{
+    setNonBlock(true);
+    out->setNonBlock(true);
+
+    size_t  moved = 0;
+
+    // 一端是管道时直接 splice
+    if (isPipe(m_fd) || isPipe(out->m_fd)) {
+        while (moved < len) {
+            // 管道为空和对端不可写都会得到 EAGAIN，先按读端等待，读端就绪后再按写端等待
+            auto ret = ::splice(m_fd, nullptr, out->m_fd, nullptr, len - moved, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (ret > 0) {
+                moved += ret;
+                continue;
+            }
+            if (ret == 0) {
+                break;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return moved ? (ssize_t) moved : -1;
+            }
+
+            struct pollfd pfd = { m_fd, POLLIN, 0 };
+
+            auto ok = ::poll(&pfd, 1, 0) > 0 ? out->waitReady(EPOLLOUT) : waitReady(EPOLLIN);
+            if (! ok) {
+                return moved ? (ssize_t) moved : -1;
+            }
+        }
+
+        return moved;
+    }
+
+    int pipeFds[2];
+    if (! acquireSplicePipe(pipeFds)) {
+        return -1;
+    }
+
+    // 中转管道中尚未写出的字节数
+    size_t  buffered = 0;
+    bool    failed = false;
+
+    while (moved < len) {
+        auto ret = spliceOnce(m_fd, pipeFds[1], len - moved, this, EPOLLIN);
+        if (ret <= 0) {
+            failed = ret < 0;
+            break;
+        }
+
+        for (buffered = ret; buffered; ) {
+            ret = spliceOnce(pipeFds[0], out->m_fd, buffered, out, EPOLLOUT);
+            if (ret <= 0) {
+                failed = true;
+                break;
+            }
+
+            buffered -= ret;
+            moved += ret;
+        }
+
+        if (failed) {
+            break;
+        }
+    }
+
+    releaseSplicePipe(pipeFds, ! buffered);
+
+    if (failed && ! moved) {
+        return -1;
+    }
+    return moved;
+}
+
+ssize_t FdOperator::teeTo(FdOperator *out, size_t len)
+{
+    setNonBlock(true);
+    out->setNonBlock(true);
+
+    for (;;) {
+        auto ret = ::tee(m_fd, out->m_fd, len, SPLICE_F_NONBLOCK);
+        if (ret >= 0) {
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN) {
+            return ret;
+        }
+
+        int avail = 0;
+        ioctl(m_fd, FIONREAD, &avail);
+
+        auto ok = avail > 0 ? out->waitReady(EPOLLOUT) : waitReady(EPOLLIN);
+        if (! ok) {
+            return -1;
+        }
+    }
+}
+
+ssize_t FdOperator::sendFileFrom(FdOperator *file, off_t offset, size_t len)
+{
+    setNonBlock(true);
+
+    size_t  sent = 0;
+
+    while (sent < len) {
+        auto ret = ::sendfile(m_fd, file->m_fd, &offset, len - sent);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if (ret == 0) {
+            break;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return sent ? (ssize_t) sent : -1;
+        }
+
+        if (! waitReady(EPOLLOUT)) {
+            return sent ? (ssize_t) sent : -1;
+        }
+    }
+
+    return sent;
+}
+
+int FdOperator::acceptAsync(struct sockaddr *addr, socklen_t *addrLen)
+{
+    setNonBlock(true);
+
+    for (;;) {
+        auto ret = ::accept4(m_fd, addr, addrLen, SOCK_CLOEXEC);
+        if (ret >= 0) {
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return ret;
+        }
+
+        if (! waitReady(EPOLLIN)) {
+            return -1;
+        }
+    }
+}
+
+int FdOperator::connectAsync(const struct sockaddr *addr, socklen_t addrLen)
+{
+    setNonBlock(true);
+
+    auto ret = ::connect(m_fd, addr, addrLen);
+    if (ret == 0) {
+        return 0;
+    }
+    if (errno != EINPROGRESS) {
+        return -1;
+    }
+
+    if (! waitReady(EPOLLOUT)) {
+        return -1;
+    }
+
+    int         err = 0;
+    socklen_t   errLen = sizeof(err);
+
+    if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &errLen) < 0) {
+        return -1;
+    }
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+bool FdOperator::waitReady(int events)
+{
+    auto co = Coroutine::getCurrentCoroutine();
+    SharedContext   sc;
+
+    if (co) {
+        sc = co->getCurrentContext();
+    }
+
+    // 已被取消的上下文不再挂起，循环等待的调用者（splice 等）借此结束
+    if (m_closed || (sc && Coroutine::isCancelled())) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    if (! sc) {
+        struct pollfd pfd = { m_fd, (short) events, 0 };
+
+        auto ret = ::poll(&pfd, 1, -1);
+
+        if (m_closed) {
+            errno = ECANCELED;
+            return false;
+        }
+        return ret > 0;
+    }
+
+    // 记录由 shared_ptr 持有，等待期间对象被关闭也不会失效
+    auto    rec = getAsyncRecord();
+    bool    cancelled = false;
+
+    CoWaiter    waiter;
+    waiter.prepare();
+    waiter.cancellable = true;
+
+    AsyncWaiter     w;
+    w.waiter = &waiter;
+    w.cancelled = &cancelled;
+
+    if (! armAsyncWaiterHelper(rec.get(), events, std::move(w))) {
+        return false;
+    }
+
+    // 以等待者状态为准，其他来源的 resume 不会使这里提前返回
+    if (! waiter.sleep()) {
+        // 上下文被取消，等待者仍在槽位中，移出之后栈才能释放
+        std::unique_lock<decltype(rec->asyncMutex)>     lk(rec->asyncMutex);
 
-    FdOperator      *o;
-};
+        auto &list = (events & EPOLLIN) ? rec->readWaiters : rec->writeWaiters;
+        list.erase(std::remove_if(list.begin(), list.end(), [&] (const AsyncWaiter &w) { return w.waiter == &waiter; }), list.end());
 
-static std::unordered_map<ObjectId, FdOperatorAliveInfo>    g_fdOperatorMap;
-static SpinMutex        g_fdOperatorMapMutex;
+        errno = ECANCELED;
+        return false;
+    }
 
-static int getEpollFd()
+    // 被 close 取消时对象可能已析构，不访问成员；其余情况下 close 可能发生在就绪之后、恢复之前
+    if (cancelled || m_closed) {
+        errno = ECANCELED;
+        return false;
+    }
+
+    return true;
+}
+
+bool FdOperator::notifyReady(int events, Loop::WorkFun &&f)
 {
-    static int fd = 0;
-    if(! fd) {
-        fd = epoll_create(EpollSize);
+    AsyncWaiter     w;
+    w.fun = std::move(f);
 
-        auto el = Loop::newInstance("SpaE::FdE");
+    return armAsyncWaiter(events, std::move(w));
+}
 
-        el->work(
-            [=]
-            {
-                struct epoll_event events[EpollSize];
+bool FdOperator::armAsyncWaiter(int events, AsyncWaiter &&w)
+{
+    return armAsyncWaiterHelper(getAsyncRecord().get(), events, std::move(w));
+}
 
-                while(true) {
-                    auto ret = epoll_wait(fd, events, EpollSize, -1);
+static bool armAsyncWaiterHelper(FdWatchRecord *rec, int events, AsyncWaiter &&w)
+{
+    if (rec->fd < 0) {
+        errno = EBADF;
+        return false;
+    }
 
-                    for(auto i = 0; i < ret; i ++) {
-                        auto id = events[i].data.u64;
-                        {
-                            std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    // 不使用 watchRecordEnter，可能在分发其他记录的槽函数中调用
+    rec->busy ++;
 
-                            auto it = g_fdOperatorMap.find(id);
-                            if (it == g_fdOperatorMap.end()) {
-                                continue;
-                            }
+    if (rec->closed) {
+        rec->busy --;
+        errno = ECANCELED;
+        return false;
+    }
 
-                            auto &info = it->second;
-                            {
-                                std::unique_lock<decltype(info.alive->mutex)>       lk(info.alive->mutex);
+    bool    ok = true;
+    {
+        std::unique_lock<decltype(rec->asyncMutex)>     lk(rec->asyncMutex);
 
-                                if (info.alive->alive) {
-                                    emit info.o->signalEpollWatch(events[i].events);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        );
+        auto &list = (events & EPOLLIN) ? rec->readWaiters : rec->writeWaiters;
+        list.push_back(std::move(w));
+
+        struct epoll_event ev = {0};
+        ev.events = asyncWaitEvents(rec);
+        ev.data.ptr = rec;
+
+        if (epoll_ctl(rec->epollFd, rec->asyncAdded ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, rec->fd, &ev) < 0) {
+            auto err = errno;
+            list.pop_back();
+            errno = err;
+
+            ok = false;
+        }
+        else {
+            rec->asyncAdded = true;
+        }
     }
-    return fd;
+
+    rec->busy --;
+
+    return ok;
 }
 
-static int getInotifyEpollFd()
+std::shared_ptr<FdWatchRecord> FdOperator::getAsyncRecord()
 {
-    static int fd = 0;
-    static char buf[1024];
+    std::unique_lock<decltype(m_ioStateMutex)>  lk(m_ioStateMutex);
 
-    if(! fd) {
-        fd = epoll_create(EpollSize);
+    return getAsyncRecordLocked();
+}
 
-        auto el = Loop::newInstance("SpaE::FdI");
+std::shared_ptr<FdWatchRecord> FdOperator::getAsyncRecordLocked()
+{
+    if (! m_asyncRecord) {
+        auto rec = new FdWatchRecord();
+        rec->o = this;
+        rec->fd = m_fd;
+        rec->epollFd = getAsyncEpollFd();
+        rec->kind = FdWatchRecord::Async;
+
+        m_asyncRecord = SharedAsyncRecord(rec, retireWatchRecord);
+    }
 
-        el->work([=] {
-            struct epoll_event events[EpollSize];
+    return m_asyncRecord;
+}
 
-            while(true) {
-                auto ret = epoll_wait(fd, events, EpollSize, -1);
+std::shared_ptr<FdIoState> FdOperator::getIoState()
+{
+    std::unique_lock<decltype(m_ioStateMutex)>  lk(m_ioStateMutex);
+
+    if (! m_ioState) {
+        m_ioState = std::make_shared<FdIoState>();
+        m_ioState->o = this;
+        m_ioState->fd = m_fd;
+        m_ioState->alive = getSharedAliveMutex();
+        m_ioState->async = getAsyncRecordLocked();
+    }
 
-                for(auto i = 0; i < ret; i ++) {
-                    auto id = events[i].data.u64;
-                    {
-                        std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    return m_ioState;
+}
 
-                        auto it = g_fdOperatorMap.find(id);
-                        if (it == g_fdOperatorMap.end()) {
-                            continue;
-                        }
+bool FdOperator::readSubmit(size_t len)
+{
+    if (m_fd < 0) {
+        return false;
+    }
 
-                        auto &info = it->second;
-                        {
-                            std::unique_lock<decltype(info.alive->mutex)>       lk(info.alive->mutex);
+    // 退化为 epoll 时需要非阻塞读
+    if (! (g_uringEnabled && Uring::getInstance())) {
+        setNonBlock(true);
+    }
 
-                            if (info.alive->alive) {
-                                auto len = ::read(info.o->getInotifyFd(), buf, sizeof(buf));
-                                char *p = buf;
+    auto st = getIoState();
+    {
+        std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
 
-                                for(; p < (buf + len); ) {
-                                    auto event = (struct inotify_event *) p;
+        if (st->closed) {
+            return false;
+        }
 
-                                    emit info.o->signalInotifyWatch(event->mask);
+        if (st->reading) {
+            st->reads.emplace_back(len);
+            return true;
+        }
 
-                                    p += sizeof(struct inotify_event) + event->len;
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        });
+        st->reading = true;
     }
-    return fd;
+
+    ioReadRun(st, len);
+
+    return true;
 }
 
-FdOperator::FdOperator(int fd, const char *path)
+bool FdOperator::writeSubmit(const void *buf, size_t len)
 {
-    m_fd = fd;
-    m_path = path;
+    return writeSubmit(Buffer::copy(buf, len));
 }
 
-FdOperator::FdOperator(const char *path, int o_flags)
+bool FdOperator::writeSubmit(const BufferRef &buf)
 {
-    m_path = path;
+    if (m_fd < 0) {
+        return false;
+    }
 
-    m_fd = ::open(path, o_flags);
-    if(m_fd < 0) {
-        char buf[256];
-        sprintf(buf, "FdOperator open file(%s) error: ", path);
-        perror(buf);
+    if (! (g_uringEnabled && Uring::getInstance())) {
+        setNonBlock(true);
+    }
+
+    auto st = getIoState();
+    {
+        std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+        if (st->closed) {
+            return false;
+        }
+
+        st->writes.emplace_back(buf);
+
+        if (st->writing) {
+            return true;
+        }
+
+        st->writing = true;
     }
+
+    ioWriteRun(st);
+
+    return true;
 }
 
-FdOperator::~FdOperator()
+bool FdOperator::writeBuffered(const void *buf, size_t len)
 {
-    close();
+    if (m_fd < 0) {
+        return false;
+    }
+
+    setNonBlock(true);
+
+    return ioOutAppend(getIoState(), buf, len, BufferRef());
 }
 
-int FdOperator::write(const void *buf, size_t len)
+bool FdOperator::writeBuffered(const BufferRef &buf)
 {
-    return ::write(m_fd, buf, len);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    setNonBlock(true);
+
+    return ioOutAppend(getIoState(), buf.data(), buf.size(), buf);
 }
 
-int FdOperator::read(void *buf, size_t len)
+void FdOperator::setWriteHighWatermark(size_t bytes)
 {
-    return ::read(m_fd, buf, len);
+    auto st = getIoState();
+
+    std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+    st->outHighWatermark = bytes;
+}
+
+size_t FdOperator::getPendingWriteSize()
+{
+    auto st = getIoState();
+
+    std::unique_lock<decltype(st->mutex)>   lk(st->mutex);
+
+    return st->outSize;
+}
+
+void FdOperator::setUringEnabled(bool sta)
+{
+    g_uringEnabled = sta;
+}
+
+bool FdOperator::isUringAvailable()
+{
+    return Uring::getInstance() != nullptr;
+}
+
+void FdOperator::setNonBlock(bool sta)
+{
+    if (m_nonBlock == sta) {
+        return;
+    }
+
+    auto flags = fcntl(m_fd, F_GETFL, 0);
+    if (flags < 0) {
+        return;
+    }
+
+    if (sta) {
+        flags |= O_NONBLOCK;
+    }
+    else {
+        flags &= ~O_NONBLOCK;
+    }
+
+    if (fcntl(m_fd, F_SETFL, flags) == 0) {
+        m_nonBlock = sta;
+    }
 }
 
 void FdOperator::configSerial()
@@ -184,173 +2340,308 @@ int FdOperator::getFd()
     return m_fd;
 }
 
+bool FdOperator::isClosed()
+{
+    return m_closed;
+}
+
 int FdOperator::getInotifyFd()
 {
+    if (m_watchInotifyFd < 0 && m_watchInotifyRecord) {
+        return getInotifyHub()->fd;
+    }
     return m_watchInotifyFd;
 }
 
-void FdOperator::epollWatch(int flags, bool isolate)
+void FdOperator::setIsolatePool(int shards, int fdsPerShard)
 {
-    struct epoll_event ev = {0};
-    ev.events = flags;
-    ev.data.u64 = getId();
+    std::unique_lock<decltype(g_reactorShardsMutex)>    lk(g_reactorShardsMutex);
 
-    if(! isolate) {
-        auto fd = getEpollFd();
+    g_shardLimit = std::max(shards, 1);
+    g_fdsPerShard = std::max(fdsPerShard, 1);
+}
 
-        FdOperatorAliveInfo info;
-        info.alive = getSharedAliveMutex();
-        info.o = this;
+int FdOperator::getIsolateShardCount()
+{
+    std::unique_lock<decltype(g_reactorShardsMutex)>    lk(g_reactorShardsMutex);
 
-        {
-            std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    return g_reactorShards.size();
+}
 
-            g_fdOperatorMap.emplace((ObjectId) ev.data.u64, std::move(info));
-        }
+void FdOperator::epollWatch(int flags, int isolate)
+{
+    epollWatchHelper(flags, 0, 0, isolate);
+}
 
-        epoll_ctl(fd, EPOLL_CTL_ADD, m_fd, &ev);
-    }
-    else {
-        (new std::thread([=]
-            {
-                char nameBuf[64];
-                sprintf(nameBuf, "SpaE::FdW::%d", m_fd);
+void FdOperator::dataWatch(size_t bufSize, int isolate)
+{
+    setNonBlock(true);
 
-                pthread_setname_np(pthread_self(), nameBuf);
+    epollWatchHelper(EPOLLIN | EPOLLET | EPOLLRDHUP, bufSize, 0, isolate);
+}
 
-                epoll_event events[1];
-                auto tempEv = ev;
+void FdOperator::datagramWatch(int batch, size_t bufSize, int isolate)
+{
+    setNonBlock(true);
 
-                m_watchEpollFd = epoll_create(1);
+    epollWatchHelper(EPOLLIN | EPOLLET, bufSize, batch > 0 ? batch : 1, isolate);
+}
 
-                epoll_ctl(m_watchEpollFd, EPOLL_CTL_ADD, m_fd, &tempEv);
+int FdOperator::sendBatch(const std::vector<Datagram> &msgs)
+{
+    // 一次 sendmmsg 最多 UIO_MAXIOV 个
+    const size_t    maxBatch = 1024;
 
-                while(true) {
-                    auto ret = epoll_wait(m_watchEpollFd, events, 1, -1);
+    std::vector<struct mmsghdr>     hdrs(std::min(msgs.size(), maxBatch));
+    std::vector<struct iovec>       iovs(hdrs.size());
 
-                    if(ret < 0) {
-                        if(errno == EBADF) {
-                            break;
-                        }
-                    }
+    size_t  sent = 0;
 
-                    for(auto i = 0; i < ret; i ++) {
-                        auto id = events[i].data.u64;
-                        {
-                            std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    while (sent < msgs.size()) {
+        auto count = std::min(msgs.size() - sent, maxBatch);
 
-                            auto it = g_fdOperatorMap.find(id);
-                            if (it == g_fdOperatorMap.end()) {
-                                continue;
-                            }
+        for (size_t i = 0; i < count; i ++) {
+            auto &d = msgs[sent + i];
 
-                            auto &info = it->second;
-                            {
-                                std::unique_lock<decltype(info.alive->mutex)>       lk(info.alive->mutex);
+            iovs[i].iov_base = d.buf.data();
+            iovs[i].iov_len = d.buf.size();
 
-                                if (info.alive->alive) {
-                                    emit info.o->signalEpollWatch(events[i].events);
-                                }
-                            }
-                        }
-                    }
-                }
+            auto &hdr = hdrs[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = d.addrLen ? (void *) &d.addr : nullptr;
+            hdr.msg_namelen = d.addrLen;
+            hdr.msg_iov = &iovs[i];
+            hdr.msg_iovlen = 1;
+        }
+
+        auto n = sendmmsg(m_fd, hdrs.data(), count, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
             }
-        ))->detach();
+            break;
+        }
+
+        sent += n;
+
+        // 发送缓冲满（非阻塞）时只发送了一部分
+        if ((size_t) n < count) {
+            break;
+        }
     }
+
+    return sent ? (int) sent : -1;
 }
 
-void FdOperator::inotifyWatch(int flags, bool isolate)
+void FdOperator::epollWatchHelper(int flags, size_t drainSize, int batch, int isolate)
 {
-    struct epoll_event ev = {0};
-    ev.events = EPOLLIN;
-    ev.data.u64 = getId();
+    // 同一对象只登记一次
+    if (m_watchRecord) {
+        return;
+    }
+
+    auto rec = new FdWatchRecord();
+    rec->o = this;
+    rec->fd = m_fd;
+    rec->drainSize = drainSize;
 
-    m_watchInotifyFd = inotify_init();
-    auto path = m_path.data();
-    inotify_add_watch(m_watchInotifyFd, path, flags);
+    if (batch) {
+        rec->ring.reset(new DatagramRing(batch, drainSize));
+    }
 
     if(! isolate) {
-        auto fd = getInotifyEpollFd();
+        rec->epollFd = getEpollFd();
+    }
+    else {
+        m_watchShard = acquireReactorShard(isolate == IsolateDedicated);
 
-        FdOperatorAliveInfo info;
-        info.alive = getSharedAliveMutex();
-        info.o = this;
+        rec->epollFd = m_watchShard->epollFd;
+    }
 
-        {
-            std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    m_watchRecord = rec;
 
-            g_fdOperatorMap.emplace((ObjectId) ev.data.u64, std::move(info));
-        }
+    struct epoll_event ev = {0};
+    ev.events = flags;
+    ev.data.ptr = rec;
+
+    epoll_ctl(rec->epollFd, EPOLL_CTL_ADD, m_fd, &ev);
+}
 
-        epoll_ctl(fd, EPOLL_CTL_ADD, m_watchInotifyFd, &ev);
+void FdOperator::inotifyWatch(int flags, int isolate)
+{
+    if (m_watchInotifyRecord) {
+        return;
     }
-    else {
-        (new std::thread([=]
-            {
-                char nameBuf[64];
-                sprintf(nameBuf, "SpaE::FdW::%d", m_fd);
 
-                pthread_setname_np(pthread_self(), nameBuf);
+    auto rec = new FdWatchRecord();
+    rec->o = this;
+    rec->kind = FdWatchRecord::Inotify;
 
-                epoll_event events[1];
-                auto tempEv = ev;
-                char buf[1024];
+    if(! isolate) {
+        rec->coalesce = m_inotifyCoalesce;
 
-                m_watchInotifyEpollFd = epoll_create(1);
+        m_watchInotifyRecord = rec;
 
-                epoll_ctl(m_watchInotifyEpollFd, EPOLL_CTL_ADD, m_watchInotifyFd, &tempEv);
+        inotifySharedAdd(rec, m_path.data(), flags);
+        return;
+    }
 
-                while(true) {
-                    auto ret = epoll_wait(m_watchInotifyEpollFd, events, 1, -1);
+    m_watchInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    inotify_add_watch(m_watchInotifyFd, m_path.data(), flags);
 
-                    if(ret < 0) {
-                        if(errno == EBADF) {
-                            break;
-                        }
-                    }
+    m_watchInotifyShard = acquireReactorShard(isolate == IsolateDedicated);
 
-                    for(auto i = 0; i < ret; i ++) {
-                        auto id = events[i].data.u64;
-                        {
-                            std::unique_lock<decltype(g_fdOperatorMapMutex)>    lk(g_fdOperatorMapMutex);
+    rec->fd = m_watchInotifyFd;
+    rec->epollFd = m_watchInotifyShard->epollFd;
 
-                            auto it = g_fdOperatorMap.find(id);
-                            if (it == g_fdOperatorMap.end()) {
-                                continue;
-                            }
+    m_watchInotifyRecord = rec;
+
+    struct epoll_event ev = {0};
+    ev.events = EPOLLIN;
+    ev.data.ptr = rec;
 
-                            auto &info = it->second;
-                            {
-                                std::unique_lock<decltype(info.alive->mutex)>       lk(info.alive->mutex);
+    epoll_ctl(rec->epollFd, EPOLL_CTL_ADD, m_watchInotifyFd, &ev);
+}
 
-                                if (info.alive->alive) {
-                                    auto len = ::read(info.o->getInotifyFd(), buf, sizeof(buf));
-                                    char *p = buf;
+int FdOperator::inotifyAdd(const char *path, uint32_t mask)
+{
+    if (! m_watchInotifyRecord) {
+        auto rec = new FdWatchRecord();
+        rec->o = this;
+        rec->kind = FdWatchRecord::Inotify;
+        rec->coalesce = m_inotifyCoalesce;
 
-                                    for(; p < (buf + len); ) {
-                                        auto event = (struct inotify_event *) p;
+        m_watchInotifyRecord = rec;
+    }
 
-                                        emit info.o->signalInotifyWatch(event->mask);
+    if (m_watchInotifyFd >= 0) {
+        return inotify_add_watch(m_watchInotifyFd, path, mask);
+    }
 
-                                        p += sizeof(struct inotify_event) + event->len;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        ))->detach();
+    return inotifySharedAdd(m_watchInotifyRecord, path, mask);
+}
+
+bool FdOperator::inotifyRemove(int wd)
+{
+    if (! m_watchInotifyRecord) {
+        return false;
+    }
+
+    if (m_watchInotifyFd >= 0) {
+        return inotify_rm_watch(m_watchInotifyFd, wd) == 0;
+    }
+
+    return inotifySharedRemove(m_watchInotifyRecord, wd);
+}
+
+void FdOperator::setInotifyCoalesce(double sec)
+{
+    m_inotifyCoalesce = sec;
+
+    if (m_watchInotifyRecord && m_watchInotifyFd < 0) {
+        auto hub = getInotifyHub();
+
+        std::unique_lock<decltype(hub->mutex)>  lk(hub->mutex);
+
+        m_watchInotifyRecord->coalesce = sec;
+    }
+}
+
+/**
+ * @brief               停止分发：等待进行中的 emit 结束，之后不会再 emit，并从 epoll 上移除
+ */
+static void closeWatchRecord(FdWatchRecord *rec)
+{
+    rec->closed = true;
+
+    if (t_dispatching != rec) {
+        while (rec->busy) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (rec->epollFd >= 0) {
+        epoll_ctl(rec->epollFd, EPOLL_CTL_DEL, rec->fd, nullptr);
     }
 }
 
 void FdOperator::close()
 {
-    ::close(m_watchEpollFd);
-    ::close(m_watchInotifyFd);
-    ::close(m_watchInotifyEpollFd);
-    ::close(m_fd);
+    // 可重复调用（如 close 之后 delete），只有第一次生效
+    if (m_closed.exchange(true)) {
+        return;
+    }
+
+    std::shared_ptr<FdIoState>  st;
+    SharedAsyncRecord           async;
+    {
+        std::unique_lock<decltype(m_ioStateMutex)>  lk(m_ioStateMutex);
+
+        st = m_ioState;
+        async = std::move(m_asyncRecord);
+    }
+
+    // 进行中的 io_uring 请求以 -ECANCELED 完成，不再 emit
+    if (st) {
+        st->closed = true;
+
+        if (st->usedUring) {
+            Uring::getInstance()->cancelFd(st->fd);
+        }
+    }
+
+    // 之后不会再登记或取走等待者，FdIoState 仍持有时记录随它一起回收
+    std::vector<AsyncWaiter>    woken;
+    if (async) {
+        closeWatchRecord(async.get());
+
+        std::unique_lock<decltype(async->asyncMutex)>   lk(async->asyncMutex);
+
+        takeAsyncWaiters(async->readWaiters, true, woken);
+        takeAsyncWaiters(async->writeWaiters, true, woken);
+    }
+
+    if (m_watchRecord) {
+        closeWatchRecord(m_watchRecord);
+    }
+    if (m_watchInotifyRecord) {
+        closeWatchRecord(m_watchInotifyRecord);
+
+        if (m_watchInotifyFd < 0) {
+            inotifySharedUnsubscribe(m_watchInotifyRecord);
+        }
+    }
+
+    // 再从分片上移除，分片空了会在这里 join 分片线程
+    if (m_watchShard) {
+        releaseReactorShard(m_watchShard, m_fd);
+        m_watchShard = nullptr;
+    }
+    if (m_watchInotifyShard) {
+        releaseReactorShard(m_watchInotifyShard, m_watchInotifyFd);
+        m_watchInotifyShard = nullptr;
+    }
+
+    if (m_watchRecord) {
+        retireWatchRecord(m_watchRecord);
+        m_watchRecord = nullptr;
+    }
+    if (m_watchInotifyRecord) {
+        retireWatchRecord(m_watchInotifyRecord);
+        m_watchInotifyRecord = nullptr;
+    }
+
+    // 挂起的读写以 ECANCELED 返回，必须在 fd 关闭之前，否则 fd 号可能已被复用
+    resumeAsyncWaiters(std::move(woken));
+
+    if (m_watchInotifyFd >= 0) {
+        ::close(m_watchInotifyFd);
+        m_watchInotifyFd = -1;
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
 
     emit signalClosed();
 }
@@ -0,0 +1,698 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/framer.h>
+
+using namespace SpaE;
+
+#ifdef __linux__
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define SlipEnd         ((char) 0xC0)
+#define SlipEsc         ((char) 0xDB)
+#define SlipEscEnd      ((char) 0xDC)
+#define SlipEscEsc      ((char) 0xDD)
+
+// 未完成帧的零碎尾部拷贝到的缓冲的最小容量
+#define PendingChunkSize    4096
+
+using FindFun = size_t (*)(const char *p, size_t len, char c);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("sse2")))
+static size_t findSse2(const char *p, size_t len, char c)
+{
+    auto v = _mm_set1_epi8(c);
+
+    size_t i = 0;
+
+    // 每次 64 字节，四次比较合并后只判断一次
+    for (; i + 64 <= len; i += 64) {
+        auto a = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i)), v);
+        auto b = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i + 16)), v);
+        auto d = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i + 32)), v);
+        auto e = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i + 48)), v);
+
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(d, e)))) {
+            break;
+        }
+    }
+
+    for (; i + 16 <= len; i += 16) {
+        auto m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + i)), v));
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    for (; i < len; i ++) {
+        if (p[i] == c) {
+            return i;
+        }
+    }
+    return len;
+}
+
+__attribute__((target("avx2")))
+static size_t findAvx2(const char *p, size_t len, char c)
+{
+    auto v = _mm256_set1_epi8(c);
+
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        auto a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + i)), v);
+        auto b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + i + 32)), v);
+
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b))) {
+            break;
+        }
+    }
+
+    for (; i + 32 <= len; i += 32) {
+        uint32_t m = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (p + i)), v));
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+
+    // 不足 32 字节的尾部
+    return i + findSse2(p + i, len - i, c);
+}
+
+#elif defined(__ARM_NEON)
+
+static size_t findNeon(const char *p, size_t len, char c)
+{
+    auto v = vdupq_n_u8((uint8_t) c);
+
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        auto eq = vceqq_u8(vld1q_u8((const uint8_t *) (p + i)), v);
+
+        // 每字节收窄为 4 位，得到 64 位掩码
+        uint64_t m = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        if (m) {
+            return i + (__builtin_ctzll(m) >> 2);
+        }
+    }
+
+    for (; i < len; i ++) {
+        if (p[i] == c) {
+            return i;
+        }
+    }
+    return len;
+}
+
+#endif
+
+struct ScanImpl {
+    FindFun     fun;
+
+    const char  *name;
+};
+
+static ScanImpl chooseScanImpl()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) {
+        return { findAvx2, "avx2" };
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return { findSse2, "sse2" };
+    }
+#elif defined(__ARM_NEON)
+    return { findNeon, "neon" };
+#endif
+
+    return { Framer::findScalar, "scalar" };
+}
+
+static const ScanImpl   g_scanImpl = chooseScanImpl();
+
+Framer::Framer(Mode mode) : m_mode(mode)
+{
+    if (mode == Slip) {
+        m_delimiter = SlipEnd;
+    }
+    else if (mode == Cobs) {
+        m_delimiter = 0;
+    }
+}
+
+void Framer::setDelimiter(char c)
+{
+    m_delimiter = c;
+}
+
+void Framer::setLengthPrefix(int bytes, bool bigEndian)
+{
+    m_prefixBytes = bytes;
+    m_bigEndian = bigEndian;
+}
+
+void Framer::setMaxFrameSize(size_t bytes)
+{
+    m_maxFrameSize = bytes;
+}
+
+void Framer::setScalarScan(bool sta)
+{
+    m_scalar = sta;
+}
+
+void Framer::attach(FdOperator *o)
+{
+    connect(o, &o->signalData, this,
+        [this] (BufferRef buf)
+        {
+            if (! buf) {
+                emit signalEnd();
+                return;
+            }
+
+            feed(buf);
+        }
+    );
+}
+
+void Framer::feed(const BufferRef &buf)
+{
+    if (! buf.size()) {
+        return;
+    }
+
+    if (m_mode == LengthPrefixed) {
+        feedLengthPrefixed(buf);
+    }
+    else {
+        feedDelimited(buf);
+    }
+}
+
+void Framer::reset()
+{
+    m_pending.clear();
+
+    m_pendingOffset = 0;
+    m_pendingSize = 0;
+    m_pendingTailOwned = false;
+
+    m_discarding = false;
+}
+
+size_t Framer::find(const char *p, size_t len, char c)
+{
+    return g_scanImpl.fun(p, len, c);
+}
+
+size_t Framer::findScalar(const char *p, size_t len, char c)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (p[i] == c) {
+            return i;
+        }
+    }
+    return len;
+}
+
+const char *Framer::getScanImpl()
+{
+    return g_scanImpl.name;
+}
+
+size_t Framer::scan(const char *p, size_t len, char c)
+{
+    return m_scalar ? findScalar(p, len, c) : find(p, len, c);
+}
+
+void Framer::feedDelimited(const BufferRef &buf)
+{
+    auto p = buf.data();
+    auto len = buf.size();
+
+    size_t  pos = 0;
+
+    std::vector<Frame>  out;
+
+    // 先补全跨块的帧
+    if (! m_pending.empty() || m_discarding) {
+        auto k = scan(p, len, m_delimiter);
+
+        if (k == len) {
+            if (m_discarding) {
+                return;
+            }
+
+            if (m_pendingSize + len > m_maxFrameSize) {
+                auto dropped = m_pendingSize + len;
+
+                reset();
+                m_discarding = true;
+
+                emit signalOverflow(dropped);
+                return;
+            }
+
+            pushPending(buf, 0);
+            return;
+        }
+
+        if (m_discarding) {
+            m_discarding = false;
+        }
+        else if (m_pendingSize + k > m_maxFrameSize) {
+            auto dropped = m_pendingSize + k;
+
+            reset();
+
+            emit signalOverflow(dropped);
+        }
+        else {
+            auto joined = joinPending(buf, k);
+
+            addFrame(joined, 0, joined.size(), out);
+        }
+
+        pos = k + 1;
+    }
+
+    while (pos < len) {
+        auto k = scan(p + pos, len - pos, m_delimiter);
+        if (k == len - pos) {
+            break;
+        }
+
+        if (k > m_maxFrameSize) {
+            emit signalOverflow(k);
+        }
+        else {
+            addFrame(buf, pos, k, out);
+        }
+
+        pos += k + 1;
+    }
+
+    if (pos < len) {
+        if (len - pos > m_maxFrameSize) {
+            m_discarding = true;
+
+            emit signalOverflow(len - pos);
+        }
+        else {
+            pushPending(buf, pos);
+        }
+    }
+
+    if (! out.empty()) {
+        emit signalFrames(std::make_shared<const std::vector<Frame>>(std::move(out)));
+    }
+}
+
+static size_t readLength(const uint8_t *h, int bytes, bool bigEndian)
+{
+    size_t  n = 0;
+
+    for (int i = 0; i < bytes; i ++) {
+        n = (n << 8) | (bigEndian ? h[i] : h[bytes - 1 - i]);
+    }
+    return n;
+}
+
+void Framer::feedLengthPrefixed(const BufferRef &buf)
+{
+    auto p = (const uint8_t *) buf.data();
+    auto len = buf.size();
+
+    size_t  pos = 0;
+
+    std::vector<Frame>  out;
+
+    if (! m_pending.empty()) {
+        size_t  frameLen;
+
+        // 长度头可能也跨块
+        if (! peekLength(buf, frameLen)) {
+            pushPending(buf, 0);
+            return;
+        }
+
+        // 长度不可信，流已错位
+        if (frameLen > m_maxFrameSize) {
+            auto dropped = m_pendingSize + len;
+
+            reset();
+
+            emit signalOverflow(dropped);
+            return;
+        }
+
+        auto need = m_prefixBytes + frameLen;
+
+        if (m_pendingSize + len < need) {
+            pushPending(buf, 0);
+            return;
+        }
+
+        auto take = need - m_pendingSize;
+
+        auto joined = joinPending(buf, take);
+
+        out.emplace_back(Frame { joined, (uint32_t) m_prefixBytes, (uint32_t) frameLen });
+
+        pos = take;
+    }
+
+    while (len - pos >= (size_t) m_prefixBytes) {
+        auto frameLen = readLength(p + pos, m_prefixBytes, m_bigEndian);
+
+        if (frameLen > m_maxFrameSize) {
+            emit signalOverflow(len - pos);
+
+            pos = len;
+            break;
+        }
+
+        if (len - pos - m_prefixBytes < frameLen) {
+            break;
+        }
+
+        out.emplace_back(Frame { buf, (uint32_t) (pos + m_prefixBytes), (uint32_t) frameLen });
+
+        pos += m_prefixBytes + frameLen;
+    }
+
+    if (pos < len) {
+        pushPending(buf, pos);
+    }
+
+    if (! out.empty()) {
+        emit signalFrames(std::make_shared<const std::vector<Frame>>(std::move(out)));
+    }
+}
+
+void Framer::addFrame(const BufferRef &buf, size_t offset, size_t len, std::vector<Frame> &out)
+{
+    auto src = buf.data() + offset;
+
+    switch (m_mode)
+    {
+    case Line: {
+        if (len && src[len - 1] == '\r') {
+            len --;
+        }
+    } break;
+
+    case Slip: {
+        if (! len) {
+            return;
+        }
+
+        // 没有转义字节的帧直接引用
+        if (scan(src, len, SlipEsc) == len) {
+            break;
+        }
+
+        auto nb = Buffer::alloc(len);
+        auto dst = nb.data();
+
+        size_t n = 0;
+
+        for (size_t i = 0; i < len; i ++) {
+            auto c = src[i];
+
+            if (c == SlipEsc && i + 1 < len) {
+                auto e = src[++ i];
+
+                c = e == SlipEscEnd ? SlipEnd : e == SlipEscEsc ? SlipEsc : e;
+            }
+
+            dst[n ++] = c;
+        }
+
+        nb->size = n;
+
+        out.emplace_back(Frame { nb, 0, (uint32_t) n });
+    } return;
+
+    case Cobs: {
+        if (! len) {
+            return;
+        }
+
+        auto nb = Buffer::alloc(len);
+        auto dst = nb.data();
+
+        size_t n = 0;
+
+        for (size_t i = 0; i < len; ) {
+            auto code = (uint8_t) src[i ++];
+
+            // 无效编码的帧被丢弃
+            if (! code || i + code - 1 > len) {
+                return;
+            }
+
+            memcpy(dst + n, src + i, code - 1);
+
+            n += code - 1;
+            i += code - 1;
+
+            if (code < 0xFF && i < len) {
+                dst[n ++] = 0;
+            }
+        }
+
+        nb->size = n;
+
+        out.emplace_back(Frame { nb, 0, (uint32_t) n });
+    } return;
+
+    default:
+        break;
+    }
+
+    out.emplace_back(Frame { buf, (uint32_t) offset, (uint32_t) len });
+}
+
+bool Framer::peekLength(const BufferRef &buf, size_t &len)
+{
+    uint8_t     header[4];
+    size_t      have = 0;
+
+    auto need = (size_t) m_prefixBytes;
+
+    for (size_t i = 0; i < m_pending.size() && have < need; i ++) {
+        auto &b = m_pending[i];
+
+        for (auto off = i ? 0 : m_pendingOffset; off < b.size() && have < need; off ++) {
+            header[have ++] = b.data()[off];
+        }
+    }
+    for (size_t off = 0; off < buf.size() && have < need; off ++) {
+        header[have ++] = buf.data()[off];
+    }
+
+    if (have < need) {
+        return false;
+    }
+
+    len = readLength(header, m_prefixBytes, m_bigEndian);
+    return true;
+}
+
+BufferRef Framer::joinPending(const BufferRef &buf, size_t len)
+{
+    auto nb = Buffer::alloc(m_pendingSize + len);
+    auto dst = nb.data();
+
+    size_t n = 0;
+
+    for (size_t i = 0; i < m_pending.size(); i ++) {
+        auto &b = m_pending[i];
+        auto off = i ? 0 : m_pendingOffset;
+
+        memcpy(dst + n, b.data() + off, b.size() - off);
+        n += b.size() - off;
+    }
+
+    memcpy(dst + n, buf.data(), len);
+    n += len;
+
+    nb->size = n;
+
+    m_pending.clear();
+    m_pendingOffset = 0;
+    m_pendingSize = 0;
+    m_pendingTailOwned = false;
+
+    return nb;
+}
+
+size_t Framer::getPendingCapacity()
+{
+    size_t  n = 0;
+
+    for (auto &b: m_pending) {
+        n += b->capacity;
+    }
+    return n;
+}
+
+void Framer::pushPending(const BufferRef &buf, size_t offset)
+{
+    auto len = buf.size() - offset;
+
+    m_pendingSize += len;
+
+    // 有效数据占一半以上的块直接引用，不拷贝
+    if (len * 2 >= buf->capacity) {
+        if (m_pending.empty()) {
+            m_pendingOffset = offset;
+        }
+
+        m_pending.emplace_back(buf);
+        m_pendingTailOwned = false;
+        return;
+    }
+
+    // 零碎的尾部拷贝出来，避免每个几字节的尾部都占住一整块
+    if (m_pendingTailOwned) {
+        auto &tail = m_pending.back();
+
+        if (tail->capacity - tail->size >= len) {
+            memcpy(tail.data() + tail->size, buf.data() + offset, len);
+            tail->size += len;
+            return;
+        }
+    }
+
+    auto nb = Buffer::alloc(std::max<size_t>(len, PendingChunkSize));
+
+    memcpy(nb.data(), buf.data() + offset, len);
+    nb->size = len;
+
+    if (m_pending.empty()) {
+        m_pendingOffset = 0;
+    }
+
+    m_pending.emplace_back(std::move(nb));
+    m_pendingTailOwned = true;
+}
+
+BufferRef Framer::encode(const void *data, size_t len)
+{
+    auto src = (const char *) data;
+
+    BufferRef   nb;
+    size_t      n = 0;
+
+    switch (m_mode)
+    {
+    case LengthPrefixed: {
+        nb = Buffer::alloc(m_prefixBytes + len);
+
+        for (int i = 0; i < m_prefixBytes; i ++) {
+            auto shift = 8 * (m_bigEndian ? m_prefixBytes - 1 - i : i);
+
+            nb.data()[n ++] = (char) (len >> shift);
+        }
+
+        memcpy(nb.data() + n, src, len);
+        n += len;
+    } break;
+
+    case Slip: {
+        nb = Buffer::alloc(2 * len + 2);
+
+        auto dst = nb.data();
+
+        // 开头的 END 结束线路上可能残留的噪声
+        dst[n ++] = SlipEnd;
+
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i] == SlipEnd) {
+                dst[n ++] = SlipEsc;
+                dst[n ++] = SlipEscEnd;
+            }
+            else if (src[i] == SlipEsc) {
+                dst[n ++] = SlipEsc;
+                dst[n ++] = SlipEscEsc;
+            }
+            else {
+                dst[n ++] = src[i];
+            }
+        }
+
+        dst[n ++] = SlipEnd;
+    } break;
+
+    case Cobs: {
+        nb = Buffer::alloc(len + len / 254 + 2);
+
+        auto dst = nb.data();
+
+        size_t  codePos = n ++;
+        uint8_t code = 1;
+
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i]) {
+                dst[n ++] = src[i];
+                code ++;
+            }
+
+            if (! src[i] || code == 0xFF) {
+                dst[codePos] = (char) code;
+
+                codePos = n ++;
+                code = 1;
+            }
+        }
+
+        dst[codePos] = (char) code;
+        dst[n ++] = 0;
+    } break;
+
+    default: {
+        nb = Buffer::alloc(len + 1);
+
+        memcpy(nb.data(), src, len);
+        n = len;
+
+        nb.data()[n ++] = m_mode == Line ? '\n' : m_delimiter;
+    } break;
+    }
+
+    nb->size = n;
+
+    return nb;
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/generator.h>
+
+#include <stdlib.h>
+
+#include <new>
+
+#include "context.h"
+
+using namespace SpaE;
+
+#define GENERATOR_STACK_ALIGN       (16)
+
+struct SpaE::GeneratorEntry
+{
+    static void fun(tb_context_from_t from)
+    {
+        auto g = (GeneratorBase *) from.priv;
+
+        g->m_consumerRef = from.context;
+
+        try {
+            g->body();
+        }
+        catch (GeneratorBase::Stop &) {
+
+        }
+        catch (...) {
+            g->m_exception = std::current_exception();
+        }
+
+        g->m_finished = true;
+        g->m_value = nullptr;
+
+        // 不再返回
+        tb_context_jump(g->m_consumerRef, nullptr);
+    }
+};
+
+GeneratorBase::GeneratorBase(int stackSize)
+{
+    m_stackSize = (stackSize + GENERATOR_STACK_ALIGN - 1) & ~(GENERATOR_STACK_ALIGN - 1);
+}
+
+GeneratorBase::~GeneratorBase()
+{
+    free(m_stack);
+}
+
+void GeneratorBase::stop()
+{
+    if (! m_started || m_finished) {
+        return;
+    }
+
+    m_stopping = true;
+
+    // 生产者捕获了 Stop 仍继续 yield 时再次抛出
+    while (! m_finished) {
+        m_producerRef = tb_context_jump(m_producerRef, this).context;
+    }
+
+    m_exception = nullptr;
+}
+
+bool GeneratorBase::resume()
+{
+    if (m_finished) {
+        return false;
+    }
+
+    if (! m_started) {
+        m_started = true;
+
+        m_stack = (char *) aligned_alloc(GENERATOR_STACK_ALIGN, m_stackSize);
+        if (! m_stack) {
+            throw std::bad_alloc();
+        }
+
+        m_producerRef = tb_context_make(m_stack, m_stackSize, GeneratorEntry::fun);
+    }
+
+    m_producerRef = tb_context_jump(m_producerRef, this).context;
+
+    if (m_exception) {
+        auto e = m_exception;
+        m_exception = nullptr;
+
+        std::rethrow_exception(e);
+    }
+
+    return ! m_finished;
+}
+
+void GeneratorBase::suspend(const void *value)
+{
+    m_value = value;
+
+    m_consumerRef = tb_context_jump(m_consumerRef, nullptr).context;
+
+    if (m_stopping) {
+        throw Stop();
+    }
+}
@@ -0,0 +1,313 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include "io_uring.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include <SpaE/loop.h>
+
+using namespace SpaE;
+
+#define UringEntries        256
+
+// 在 SpaE::FdU 线程收割完成时，新请求在本批收割结束后一起提交
+static thread_local bool    t_reaping = false;
+
+static thread_local bool    t_submitImmediately = false;
+
+// 本线程的事件循环中已排队 flush，每个提交线程各自一份，繁忙的循环不会拖住其他线程的提交
+static thread_local bool    t_flushPending = false;
+
+static int uringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+Uring *Uring::getInstance()
+{
+    static Uring *instance = []
+    {
+        auto u = new Uring();
+        if (u->init()) {
+            return u;
+        }
+
+        delete u;
+        return (Uring *) nullptr;
+    }();
+
+    return instance;
+}
+
+void Uring::setSubmitImmediately(bool sta)
+{
+    t_submitImmediately = sta;
+}
+
+bool Uring::init()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    m_fd = uringSetup(UringEntries, &p);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    // IORING_OP_READ / WRITE 与按 fd 取消都需要较新的内核
+    if (! (p.features & IORING_FEAT_RW_CUR_POS)) {
+        ::close(m_fd);
+        return false;
+    }
+
+    size_t sqSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size_t cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        sqSize = cqSize = std::max(sqSize, cqSize);
+    }
+
+    auto sq = (char *) mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        ::close(m_fd);
+        return false;
+    }
+
+    auto cq = sq;
+    if (! (p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = (char *) mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            munmap(sq, sqSize);
+            ::close(m_fd);
+            return false;
+        }
+    }
+
+    m_sqes = (struct io_uring_sqe *) mmap(nullptr, p.sq_entries * sizeof(struct io_uring_sqe),
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        if (cq != sq) {
+            munmap(cq, cqSize);
+        }
+        munmap(sq, sqSize);
+        ::close(m_fd);
+        return false;
+    }
+
+    m_sqHead = (std::atomic<uint32_t> *) (sq + p.sq_off.head);
+    m_sqTail = (std::atomic<uint32_t> *) (sq + p.sq_off.tail);
+    m_sqMask = * (uint32_t *) (sq + p.sq_off.ring_mask);
+    m_sqEntries = p.sq_entries;
+    m_sqArray = (uint32_t *) (sq + p.sq_off.array);
+
+    m_cqHead = (std::atomic<uint32_t> *) (cq + p.cq_off.head);
+    m_cqTail = (std::atomic<uint32_t> *) (cq + p.cq_off.tail);
+    m_cqMask = * (uint32_t *) (cq + p.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    auto el = Loop::newInstance("SpaE::FdU");
+
+    el->work(
+        [this]
+        {
+            while (true) {
+                auto ret = uringEnter(m_fd, 0, 1, IORING_ENTER_GETEVENTS);
+                if (ret < 0 && errno != EINTR) {
+                    break;
+                }
+
+                reap();
+            }
+        }
+    );
+
+    return true;
+}
+
+bool Uring::read(int fd, void *buf, uint32_t len, UringOp *op, int64_t offset)
+{
+    return prepare(IORING_OP_READ, fd, (uint64_t) buf, len, offset, op);
+}
+
+bool Uring::write(int fd, const void *buf, uint32_t len, UringOp *op, int64_t offset)
+{
+    return prepare(IORING_OP_WRITE, fd, (uint64_t) buf, len, offset, op);
+}
+
+bool Uring::writev(int fd, const struct iovec *iov, uint32_t count, UringOp *op, int64_t offset)
+{
+    return prepare(IORING_OP_WRITEV, fd, (uint64_t) iov, count, offset, op);
+}
+
+bool Uring::cancelFd(int fd)
+{
+    if (! prepare(IORING_OP_ASYNC_CANCEL, fd, 0, 0, 0, nullptr, IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL)) {
+        return false;
+    }
+
+    // 需要在调用者关闭 fd 之前生效
+    flush();
+
+    return true;
+}
+
+bool Uring::prepare(uint8_t opcode, int fd, uint64_t addr, uint32_t len, int64_t offset, UringOp *op, uint32_t cancelFlags)
+{
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        auto tail = m_sqTail->load(std::memory_order_relaxed);
+
+        // SQ 已满，先把已有的提交掉
+        if (tail - m_sqHead->load(std::memory_order_acquire) >= m_sqEntries) {
+            submitLocked();
+
+            if (tail - m_sqHead->load(std::memory_order_acquire) >= m_sqEntries) {
+                return false;
+            }
+        }
+
+        auto idx = tail & m_sqMask;
+        auto sqe = &m_sqes[idx];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->addr = addr;
+        sqe->len = len;
+        sqe->off = (uint64_t) offset;
+        sqe->cancel_flags = cancelFlags;
+        sqe->user_data = (uint64_t) op;
+
+        m_sqArray[idx] = idx;
+
+        m_sqTail->store(tail + 1, std::memory_order_release);
+        m_toSubmit ++;
+
+        if (t_submitImmediately) {
+            submitLocked();
+            return true;
+        }
+
+        if (t_reaping) {
+            return true;
+        }
+
+        if (t_flushPending) {
+            return true;
+        }
+
+        // 不在事件循环线程中，flush 会排到其他线程上，直接提交
+        if (! Loop::isLoopThread()) {
+            submitLocked();
+            return true;
+        }
+
+        t_flushPending = true;
+    }
+
+    // 本轮事件中后续的请求一起提交
+    Loop::getCurrentLoop()->work(std::bind(&Uring::flush, this));
+
+    return true;
+}
+
+int Uring::submitLocked()
+{
+    int submitted = 0;
+
+    while (m_toSubmit) {
+        auto ret = uringEnter(m_fd, m_toSubmit, 0, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        m_toSubmit -= ret;
+        submitted += ret;
+    }
+
+    return submitted;
+}
+
+void Uring::flush()
+{
+    // 由本线程排队，或 cancelFd 直接调用，本线程已写入的请求都会随之提交
+    t_flushPending = false;
+
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    submitLocked();
+}
+
+void Uring::reap()
+{
+    t_reaping = true;
+
+    auto head = m_cqHead->load(std::memory_order_relaxed);
+
+    for (;;) {
+        auto tail = m_cqTail->load(std::memory_order_acquire);
+        if (head == tail) {
+            break;
+        }
+
+        for (; head != tail; head ++) {
+            auto &cqe = m_cqes[head & m_cqMask];
+
+            auto op = (UringOp *) cqe.user_data;
+            auto res = cqe.res;
+
+            // 先归还 CQ 项，complete 中可能提交新的请求
+            m_cqHead->store(head + 1, std::memory_order_release);
+
+            if (op) {
+                op->complete(res);
+            }
+        }
+    }
+
+    t_reaping = false;
+
+    // complete 中提交的请求
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    submitLocked();
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <stdint.h>
+
+#include <sys/uio.h>
+
+#include <atomic>
+
+#include <SpaE/spin_mutex.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace SpaE
+{
+
+/**
+ * 一次 io_uring 请求，完成时在 SpaE::FdU 线程中调用 complete，之后由实现自行释放
+ */
+struct UringOp
+{
+    virtual ~UringOp() = default;
+
+    /**
+     * @param res           同系统调用返回值，失败时为 -errno
+     */
+    virtual void complete(int res) = 0;
+};
+
+/**
+ * 进程内共享的 io_uring 实例，不依赖 liburing，直接使用系统调用
+ * 提交的请求先写入 SQ，在当前事件循环的本轮事件结束后统一 io_uring_enter，
+ * 同一轮中的多个请求只需一次系统调用；完成由 SpaE::FdU 线程收割
+ */
+class Uring
+{
+public:
+    /**
+     * @brief               运行时检测，内核不支持或被禁用（seccomp 等）时返回 nullptr
+     */
+    static Uring    *getInstance();
+
+    /**
+     * @brief               当前线程提交请求时不再等到本轮事件结束，立即 io_uring_enter
+     *                      用于不处理 Loop 队列的阻塞线程（如各 epoll 线程）
+     */
+    static void     setSubmitImmediately(bool sta);
+
+    // offset 为 -1 时使用并推进文件当前位置
+    bool    read(int fd, void *buf, uint32_t len, UringOp *op, int64_t offset = -1);
+    bool    write(int fd, const void *buf, uint32_t len, UringOp *op, int64_t offset = -1);
+    bool    writev(int fd, const struct iovec *iov, uint32_t count, UringOp *op, int64_t offset = -1);
+
+    /**
+     * @brief               取消 fd 上所有未完成的请求，被取消的请求以 -ECANCELED 完成
+     *                      立即提交，内核不支持按 fd 取消时返回 false
+     */
+    bool    cancelFd(int fd);
+
+private:
+    Uring() = default;
+
+    bool    init();
+
+    bool    prepare(uint8_t opcode, int fd, uint64_t addr, uint32_t len, int64_t offset, UringOp *op, uint32_t cancelFlags = 0);
+
+    // 持有 m_mutex 时调用
+    int     submitLocked();
+
+    void    flush();
+    void    reap();
+
+private:
+    int     m_fd = -1;
+
+    // SQ
+    std::atomic<uint32_t>   *m_sqHead = nullptr,
+                            *m_sqTail = nullptr;
+    uint32_t        m_sqMask = 0;
+    uint32_t        m_sqEntries = 0;
+    uint32_t        *m_sqArray = nullptr;
+
+    ::io_uring_sqe           *m_sqes = nullptr;
+
+    // CQ，仅 SpaE::FdU 线程访问
+    std::atomic<uint32_t>   *m_cqHead = nullptr,
+                            *m_cqTail = nullptr;
+    uint32_t        m_cqMask = 0;
+
+    ::io_uring_cqe           *m_cqes = nullptr;
+
+    // 已写入 SQ 尚未提交的数量
+    uint32_t        m_toSubmit = 0;
+
+    SpinMutex       m_mutex;
+};
+
+};
+
+#endif
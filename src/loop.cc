@@ -207,6 +207,21 @@ void Loop::waitProcess()
     processData();
 }
 
+bool Loop::waitProcessFor(double sec)
+{
+    if (this != getCurrentLoop()) {
+        throw std::runtime_error("Loop::waitProcessFor() incorrect call in another thread \r\n");
+    }
+
+    if (! m_runSem.waitFor(sec)) {
+        return false;
+    }
+
+    processData();
+
+    return true;
+}
+
 const char *Loop::getName()
 {
     return m_name.data();
@@ -217,7 +232,8 @@ SharedLoopAlive Loop::getSharedAlive()
     return m_sharedAlive;
 }
 
-Loop *Loop::getCurrentLoop()
+// 同 Coroutine::getCurrentCoroutine，迁移后需要重新取线程号
+__attribute__((noinline)) Loop *Loop::getCurrentLoop()
 {
     {
         std::unique_lock<decltype(g_loopPoolMutex)> lk(g_loopPoolMutex);
@@ -232,6 +248,13 @@ Loop *Loop::getCurrentLoop()
     return getInstance();
 }
 
+bool Loop::isLoopThread()
+{
+    std::unique_lock<decltype(g_loopPoolMutex)> lk(g_loopPoolMutex);
+
+    return g_loopPoolMap.count(std::this_thread::get_id()) > 0;
+}
+
 Loop *Loop::getInstance()
 {
     static Loop *instance = nullptr;
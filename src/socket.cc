@@ -0,0 +1,498 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/socket.h>
+#include <SpaE/timer.h>
+
+using namespace SpaE;
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+
+// accept 因 fd 等资源不足失败后的重试间隔（秒）
+#define AcceptRetryInterval     0.1
+
+static bool toSockAddr(const char *host, uint16_t port, struct sockaddr_in &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (! host || ! *host) {
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        return true;
+    }
+
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return false;
+    }
+    return true;
+}
+
+static bool toSockAddr(const char *path, struct sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    strcpy(addr.sun_path, path);
+    return true;
+}
+
+static uint16_t localPort(int fd)
+{
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+
+    if (getsockname(fd, (struct sockaddr *) &addr, &len) < 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+TcpSocket::TcpSocket() : FdOperator(::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), "tcp")
+{
+
+}
+
+TcpSocket::TcpSocket(int fd) : FdOperator(fd, "tcp")
+{
+
+}
+
+TcpSocket::~TcpSocket()
+{
+    // 基类析构中的 close 不会再调用到这里
+    releaseLoad();
+}
+
+bool TcpSocket::connectTo(const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    if (! toSockAddr(host, port, addr)) {
+        return false;
+    }
+
+    return connectAsync((struct sockaddr *) &addr, sizeof(addr)) == 0;
+}
+
+bool TcpSocket::setNoDelay(bool sta)
+{
+    int v = sta;
+
+    return setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v)) == 0;
+}
+
+std::string TcpSocket::getPeerAddress()
+{
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+
+    if (getpeername(m_fd, (struct sockaddr *) &addr, &len) < 0) {
+        return "";
+    }
+
+    char buf[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, buf, sizeof(buf));
+
+    return buf;
+}
+
+uint16_t TcpSocket::getPeerPort()
+{
+    struct sockaddr_in  addr;
+    socklen_t           len = sizeof(addr);
+
+    if (getpeername(m_fd, (struct sockaddr *) &addr, &len) < 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+void TcpSocket::close()
+{
+    releaseLoad();
+
+    FdOperator::close();
+}
+
+void TcpSocket::releaseLoad()
+{
+    if (m_load) {
+        (*m_load) --;
+        m_load.reset();
+    }
+}
+
+TcpServer::TcpServer()
+{
+
+}
+
+TcpServer::~TcpServer()
+{
+    close();
+}
+
+bool TcpServer::listen(const char *host, uint16_t port, const std::vector<Loop *> &acceptLoops, int backlog)
+{
+    if (! m_shards.empty()) {
+        errno = EBUSY;
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    if (! toSockAddr(host, port, addr)) {
+        return false;
+    }
+
+    auto loops = acceptLoops;
+    if (loops.empty()) {
+        loops.emplace_back(getLoop());
+    }
+
+    std::vector<int>    fds;
+
+    bool    ok = true;
+
+    for (size_t i = 0; ok && i < loops.size(); i ++) {
+        auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            ok = false;
+            break;
+        }
+        fds.emplace_back(fd);
+
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        if (loops.size() > 1 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+            ok = false;
+            break;
+        }
+
+        // 端口由系统分配时，其余分片绑定到第一个分片得到的端口
+        ok = ::bind(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 && ::listen(fd, backlog) == 0;
+
+        addr.sin_port = htons(localPort(fd));
+    }
+
+    if (! ok) {
+        auto err = errno;
+        for (auto fd: fds) {
+            ::close(fd);
+        }
+        errno = err;
+
+        return false;
+    }
+
+    m_port = ntohs(addr.sin_port);
+
+    for (size_t i = 0; i < loops.size(); i ++) {
+        auto loop = loops[i];
+        auto fd = fds[i];
+
+        FdOperator  *listener;
+
+        auto state = std::make_shared<ShardState>();
+
+        // 监听对象属于分片所在的循环，就绪信号在该循环中处理
+        loop->workSync(
+            [&]
+            {
+                listener = new FdOperator(fd, "tcp:listen");
+
+                connect(listener, &listener->signalEpollWatch, nullptr,
+                    [this, listener, state] (int)
+                    {
+                        acceptReady(listener, state);
+                    }
+                );
+
+                listener->epollWatch(EPOLLIN | EPOLLET);
+            }
+        );
+
+        m_shards.emplace_back(Shard { loop, listener, state });
+    }
+
+    return true;
+}
+
+void TcpServer::setConnectionLoops(const std::vector<Loop *> &loops)
+{
+    m_connLoops = loops;
+
+    m_connLoads.clear();
+    for (size_t i = 0; i < loops.size(); i ++) {
+        m_connLoads.emplace_back(std::make_shared<std::atomic<int>>(0));
+    }
+}
+
+std::vector<int> TcpServer::getConnectionCounts()
+{
+    std::vector<int>    counts;
+
+    for (auto &load: m_connLoads) {
+        counts.emplace_back(load->load());
+    }
+    return counts;
+}
+
+uint16_t TcpServer::getPort()
+{
+    return m_port;
+}
+
+void TcpServer::close()
+{
+    for (auto &shard: m_shards) {
+        auto listener = shard.listener;
+        auto state = shard.state;
+
+        shard.loop->workSync(
+            [=]
+            {
+                // 与重试定时器在同一循环中，之后不会再 accept
+                state->alive = false;
+
+                delete listener;
+            }
+        );
+    }
+
+    m_shards.clear();
+}
+
+void TcpServer::acceptReady(FdOperator *listener, const std::shared_ptr<ShardState> &state)
+{
+    // 边沿触发，需要一直 accept 到 EAGAIN
+    for (;;) {
+        auto fd = ::accept4(listener->getFd(), nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+
+            // 资源不足时已排队的连接不会再产生新的边沿，由定时器稍后重试；EAGAIN 等待下一次就绪
+            if ((errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) && ! state->retrying) {
+                state->retrying = true;
+
+                setTimeout(AcceptRetryInterval,
+                    [this, listener, state]
+                    {
+                        state->retrying = false;
+
+                        if (state->alive) {
+                            acceptReady(listener, state);
+                        }
+                    }
+                );
+            }
+            return;
+        }
+
+        auto sock = new TcpSocket(fd);
+
+        std::shared_ptr<std::atomic<int>>   load;
+
+        auto loop = pickConnectionLoop(load);
+        if (loop) {
+            sock->m_load = std::move(load);
+            sock->moveToLoop(loop);
+        }
+
+        emit signalNewConnection(sock);
+    }
+}
+
+Loop *TcpServer::pickConnectionLoop(std::shared_ptr<std::atomic<int>> &load)
+{
+    if (m_connLoops.empty()) {
+        return nullptr;
+    }
+
+    // 多个分片同时选择时，只有负载仍是选择时看到的值才计入，否则重新选择
+    for (;;) {
+        size_t  best = 0;
+        int     value = m_connLoads[0]->load();
+
+        for (size_t i = 1; i < m_connLoops.size(); i ++) {
+            auto v = m_connLoads[i]->load();
+            if (v < value) {
+                best = i;
+                value = v;
+            }
+        }
+
+        if (m_connLoads[best]->compare_exchange_weak(value, value + 1)) {
+            load = m_connLoads[best];
+
+            return m_connLoops[best];
+        }
+    }
+}
+
+UdpSocket::UdpSocket() : FdOperator(::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0), "udp")
+{
+
+}
+
+bool UdpSocket::bind(const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    if (! toSockAddr(host, port, addr)) {
+        return false;
+    }
+
+    return ::bind(m_fd, (struct sockaddr *) &addr, sizeof(addr)) == 0;
+}
+
+uint16_t UdpSocket::getLocalPort()
+{
+    return localPort(m_fd);
+}
+
+int UdpSocket::sendTo(const void *buf, size_t len, const char *host, uint16_t port)
+{
+    struct sockaddr_in addr;
+    if (! toSockAddr(host, port, addr)) {
+        return -1;
+    }
+
+    return ::sendto(m_fd, buf, len, 0, (struct sockaddr *) &addr, sizeof(addr));
+}
+
+int UdpSocket::recvFrom(void *buf, size_t len, std::string *host, uint16_t *port)
+{
+    setNonBlock(true);
+
+    for (;;) {
+        struct sockaddr_in  addr;
+        socklen_t           addrLen = sizeof(addr);
+
+        auto ret = ::recvfrom(m_fd, buf, len, 0, (struct sockaddr *) &addr, &addrLen);
+        if (ret >= 0) {
+            if (host) {
+                char str[INET_ADDRSTRLEN];
+                inet_ntop(AF_INET, &addr.sin_addr, str, sizeof(str));
+
+                *host = str;
+            }
+            if (port) {
+                *port = ntohs(addr.sin_port);
+            }
+            return ret;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            return ret;
+        }
+
+        if (! waitReady(EPOLLIN)) {
+            return -1;
+        }
+    }
+}
+
+UnixSocket::UnixSocket(Type type) :
+    FdOperator(::socket(AF_UNIX, (type == Stream ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0), "unix"),
+    m_type(type)
+{
+
+}
+
+UnixSocket::UnixSocket(int fd, Type type) : FdOperator(fd, "unix"), m_type(type)
+{
+
+}
+
+bool UnixSocket::bind(const char *path)
+{
+    struct sockaddr_un addr;
+    if (! toSockAddr(path, addr)) {
+        return false;
+    }
+
+    unlink(path);
+
+    if (::bind(m_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        return false;
+    }
+
+    m_path = path;
+    return true;
+}
+
+bool UnixSocket::listen(int backlog)
+{
+    return ::listen(m_fd, backlog) == 0;
+}
+
+UnixSocket *UnixSocket::accept()
+{
+    auto fd = acceptAsync();
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    return new UnixSocket(fd, m_type);
+}
+
+bool UnixSocket::connectTo(const char *path)
+{
+    struct sockaddr_un addr;
+    if (! toSockAddr(path, addr)) {
+        return false;
+    }
+
+    return connectAsync((struct sockaddr *) &addr, sizeof(addr)) == 0;
+}
+
+int UnixSocket::sendTo(const void *buf, size_t len, const char *path)
+{
+    struct sockaddr_un addr;
+    if (! toSockAddr(path, addr)) {
+        return -1;
+    }
+
+    return ::sendto(m_fd, buf, len, 0, (struct sockaddr *) &addr, sizeof(addr));
+}
+
+UnixSocket::Type UnixSocket::getType()
+{
+    return m_type;
+}
+
+#endif
@@ -0,0 +1,263 @@
+/*!The Sparrow Event Library
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Copyright (C) 2024-present, bluewings.
+ *
+ */
+
+#include <SpaE/task_group.h>
+
+using namespace SpaE;
+
+TaskGroup::~TaskGroup()
+{
+    // 子上下文结束时会访问任务组
+    waitAll();
+}
+
+SharedContext TaskGroup::spawn(Coroutine *co, const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri, const char *tag)
+{
+    return attach(co->work(f, stackSize, pri, tag));
+}
+
+SharedContext TaskGroup::spawn(Coroutine *co, Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri, const char *tag)
+{
+    return attach(co->work(std::move(f), stackSize, pri, tag));
+}
+
+SharedContext TaskGroup::spawn(const Loop::WorkFun &f, const int &stackSize, const Loop::Priority &pri, const char *tag)
+{
+    return attach(CoroutinePool::coroutineWork(f, stackSize, pri, tag).sharedContext);
+}
+
+SharedContext TaskGroup::spawn(Loop::WorkFun &&f, const int &stackSize, const Loop::Priority &pri, const char *tag)
+{
+    return attach(CoroutinePool::coroutineWork(std::move(f), stackSize, pri, tag).sharedContext);
+}
+
+SharedContext TaskGroup::attach(SharedContext &&sc)
+{
+    CoWakeup    wakeup;
+    bool        cancelled;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        cancelled = m_cancelled;
+
+        // 子上下文可能已经在其他线程上运行结束
+        std::unique_lock<decltype(sc->mutex)>   lk2(sc->mutex);
+
+        if (sc->alive) {
+            sc->group = this;
+            sc->groupIndex = m_children.size();
+
+            m_children.emplace_back(sc);
+        }
+        else {
+            m_done.emplace_back(sc->id);
+
+            m_anyQueue.notifyOne(wakeup);
+        }
+    }
+
+    wakeup();
+
+    if (cancelled) {
+        cancelContext(sc);
+    }
+
+    return std::move(sc);
+}
+
+void TaskGroup::complete(Context *ctx)
+{
+    CoWakeup                anyWakeup;
+    std::vector<CoWakeup>   allWakeups;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        auto i = ctx->groupIndex;
+
+        if (i != (int) m_children.size() - 1) {
+            m_children[i] = std::move(m_children.back());
+            m_children[i]->groupIndex = i;
+        }
+        m_children.pop_back();
+
+        ctx->groupIndex = -1;
+
+        m_done.emplace_back(ctx->id);
+
+        m_anyQueue.notifyOne(anyWakeup);
+
+        // 只有最后一个子上下文结束时唤醒 waitAll
+        if (m_children.empty()) {
+            CoWakeup    wakeup;
+            while (m_allQueue.notifyOne(wakeup)) {
+                allWakeups.emplace_back(std::move(wakeup));
+            }
+        }
+    }
+
+    // 此后任务组可能已被销毁，只能使用局部变量
+    anyWakeup();
+
+    for (auto &it: allWakeups) {
+        it();
+    }
+}
+
+void TaskGroup::waitAll()
+{
+    waitFor(-1);
+}
+
+bool TaskGroup::waitFor(const Seconds &sec)
+{
+    auto deadline = uptime() + sec;
+    auto propagated = false;
+
+    for (;;) {
+        Seconds     left = -1;
+        if (sec >= 0) {
+            left = deadline - uptime();
+        }
+
+        m_mutex.lock();
+
+        if (m_children.empty()) {
+            m_mutex.unlock();
+            return true;
+        }
+
+        if (sec >= 0 && left <= 0) {
+            m_mutex.unlock();
+            return false;
+        }
+
+        CoWaiter    w;
+        w.prepare();
+        w.cancellable = ! propagated;
+
+        m_allQueue.push(&w);
+        m_mutex.unlock();
+
+        if (w.sleep(left)) {
+            return true;
+        }
+
+        {
+            std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+            m_allQueue.remove(&w);
+        }
+
+        if (! propagated && Coroutine::isCancelled()) {
+            propagated = true;
+
+            cancel();
+        }
+    }
+}
+
+ContextId TaskGroup::waitAny(const Seconds &sec)
+{
+    auto deadline = uptime() + sec;
+    auto propagated = false;
+
+    for (;;) {
+        Seconds     left = -1;
+        if (sec >= 0) {
+            left = deadline - uptime();
+        }
+
+        m_mutex.lock();
+
+        if (m_doneRead < m_done.size()) {
+            auto id = m_done[m_doneRead ++];
+
+            if (m_doneRead == m_done.size()) {
+                m_done.clear();
+                m_doneRead = 0;
+            }
+
+            m_mutex.unlock();
+            return id;
+        }
+
+        if (m_children.empty() || (sec >= 0 && left <= 0)) {
+            m_mutex.unlock();
+            return 0;
+        }
+
+        CoWaiter    w;
+        w.prepare();
+        w.cancellable = ! propagated;
+
+        m_anyQueue.push(&w);
+        m_mutex.unlock();
+
+        // 被通知后重新检查，结果可能已被其他 waitAny 取走
+        if (w.sleep(left)) {
+            continue;
+        }
+
+        {
+            std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+            m_anyQueue.remove(&w);
+        }
+
+        if (! propagated && Coroutine::isCancelled()) {
+            propagated = true;
+
+            cancel();
+        }
+    }
+}
+
+void TaskGroup::cancelContext(const SharedContext &sc)
+{
+    sc->co.load()->cancel(sc);
+}
+
+void TaskGroup::cancel()
+{
+    std::vector<SharedContext>      children;
+    {
+        std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+        m_cancelled = true;
+
+        children = m_children;
+    }
+
+    for (auto &it: children) {
+        cancelContext(it);
+    }
+}
+
+bool TaskGroup::isCancelled()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_cancelled;
+}
+
+int TaskGroup::size()
+{
+    std::unique_lock<decltype(m_mutex)>     lk(m_mutex);
+
+    return m_children.size();
+}
@@ -218,10 +218,12 @@ Timer *SpaE::setTimeout(const Seconds &sec, const std::function<void ()> &f)
 {
     auto t = new Timer();
 
-    connect(t, &t->signalTimeout, f);
+    // 同一信号上各连接的调用顺序不确定，放在一个槽函数中保证先回调再删除
     connect(t, &t->signalTimeout,
         [=]
         {
+            f();
+
             delete t;
         }
     );
@@ -235,10 +237,11 @@ Timer *SpaE::setTimeout(const Seconds &sec, std::function<void ()> &&f)
 {
     auto t = new Timer();
 
-    connect(t, &t->signalTimeout, std::move(f));
     connect(t, &t->signalTimeout,
-        [=]
+        [t, f = std::move(f)]
         {
+            f();
+
             delete t;
         }
     );
@@ -0,0 +1,302 @@
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <SpaE/coroutine.h>
+#include <SpaE/coroutine_sync.h>
+#include <SpaE/generator.h>
+
+#include "../src/context.h"
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f benchCoroutine " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co = nullptr, *g_co2 = nullptr;
+
+/**
+ * 周期计数：x86 / x64 为 TSC，arm64 为通用定时器 cntvct_el0（频率通常远低于主频），
+ * arm 用户态没有可用的计数器，记为 0。qemu-user 下为模拟值，只用于同一环境前后对比
+ */
+static inline uint64_t benchCycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t v;
+
+    asm volatile("mrs %0, cntvct_el0" : "=r" (v));
+
+    return v;
+#else
+    return 0;
+#endif
+}
+
+// 同时统计耗时和周期数，按次数输出 ns/op 与 cycles/op
+struct BenchClock
+{
+    Seconds     begin = uptime();
+    uint64_t    cycles = benchCycles();
+
+    void report(const char *fun, const char *what, int64_t count)
+    {
+        auto cost = uptime() - begin;
+        auto c = benchCycles() - cycles;
+
+        LOG("%s, %lld %s: %.3f s, %.1f ns/op, %.1f cycles/op \r\n", fun,
+            (long long) count, what, cost, cost * 1e9 / count, (double) c / count);
+    }
+};
+
+static void benchJumpFun(tb_context_from_t from)
+{
+    for (;;) {
+        from = tb_context_jump(from.context, nullptr);
+    }
+}
+
+// 裸 tb_context_jump 往返（两次切换），不经过调度器
+void benchContextJump1(int count)
+{
+    static char     stack[16 * 1024] __attribute__((aligned(16)));
+
+    auto ref = tb_context_make(stack, sizeof(stack), benchJumpFun);
+
+    BenchClock  clock;
+
+    for (int i = 0; i < count; i ++) {
+        ref = tb_context_jump(ref, nullptr).context;
+    }
+
+    clock.report(__FUNCTION__, "jump round trips", count);
+}
+
+// 同一协程上两个上下文交替 yield，每次 yield 经过 Loop 队列切换到另一个上下文
+void benchYield1(int count)
+{
+    auto fun = __FUNCTION__;
+
+    auto driver = g_co->work(
+        [=]
+        {
+            auto w = [=]
+            {
+                for (int i = 0; i < count; i ++) {
+                    Coroutine::yield();
+                }
+            };
+
+            BenchClock  clock;
+
+            auto a = g_co->work(w);
+            auto b = g_co->work(w);
+
+            g_co->join(a);
+            g_co->join(b);
+
+            clock.report(fun, "yields", count * 2);
+        }
+    );
+
+    g_co->join(driver);
+}
+
+// 在协程内部批量创建子上下文并逐个 join，统计单次 spawn + join 的耗时
+void benchSpawnJoin1(int count, int batch)
+{
+    auto fun = __FUNCTION__;
+
+    auto driver = g_co->work(
+        [=]
+        {
+            std::vector<SharedContext>      scs(batch);
+
+            BenchClock  clock;
+
+            for (int i = 0; i < count; i += batch) {
+                for (auto &it: scs) {
+                    it = g_co->work([] {}, 16 * 1024);
+                }
+                for (auto &it: scs) {
+                    g_co->join(it);
+                }
+            }
+
+            char    what[64];
+            snprintf(what, sizeof(what), "spawn + join (batch %d)", batch);
+
+            clock.report(fun, what, count);
+        }
+    );
+
+    g_co->join(driver);
+}
+
+// 两个协程线程之间用 CoSemaphore 乒乓，包含跨线程唤醒
+void benchPingPong1(int count)
+{
+    static CoSemaphore  ping, pong;
+
+    auto a = g_co2->work(
+        [=]
+        {
+            for (int i = 0; i < count; i ++) {
+                ping.wait();
+                pong.post();
+            }
+        }
+    );
+
+    auto fun = __FUNCTION__;
+
+    auto b = g_co->work(
+        [=]
+        {
+            BenchClock  clock;
+
+            for (int i = 0; i < count; i ++) {
+                ping.post();
+                pong.wait();
+            }
+
+            clock.report(fun, "cross-thread round trips", count);
+        }
+    );
+
+    g_co2->join(a);
+    g_co->join(b);
+}
+
+// 大量上下文以固定间隔轮询，统计调度误差
+void benchSleep1(int count, int rounds, Seconds interval)
+{
+    static std::atomic<int64_t>     lateUs;
+
+    lateUs = 0;
+
+    std::vector<SharedContext>      scs;
+
+    auto begin = uptime();
+
+    for (int i = 0; i < count; i ++) {
+        scs.emplace_back(g_co->work(
+            [=]
+            {
+                for (int j = 0; j < rounds; j ++) {
+                    auto t = uptime();
+
+                    Coroutine::yieldFor(interval);
+
+                    lateUs += (int64_t) ((uptime() - t - interval) * 1e6);
+                }
+            },
+            16 * 1024
+        ));
+    }
+
+    for (auto &it: scs) {
+        g_co->join(it);
+    }
+
+    LOG("%s, %d contexts x %d sleeps of %.3f s: %.3f s, average late %.1f us \r\n", __FUNCTION__,
+        count, rounds, interval, uptime() - begin, (double) lateUs / count / rounds);
+}
+
+class BenchSender : public Object
+{
+signals:
+    Signal<int>     signalPing;
+    Signal<int>     signalPong;
+};
+
+// 同一协程上的两个上下文通过 waitSignal 乒乓
+void benchWaitSignal1(int count)
+{
+    auto fun = __FUNCTION__;
+
+    auto driver = g_co->work(
+        [=]
+        {
+            auto sender = new BenchSender();
+
+            auto a = g_co->work(
+                [=]
+                {
+                    for (int i = 0; i < count; i ++) {
+                        auto r = Coroutine::waitSignal(sender, &sender->signalPing);
+
+                        emit sender->signalPong(std::get<0>(*r));
+                    }
+                }
+            );
+
+            BenchClock  clock;
+
+            auto b = g_co->work(
+                [=]
+                {
+                    for (int i = 0; i < count; i ++) {
+                        emit sender->signalPing(i);
+
+                        Coroutine::waitSignal(sender, &sender->signalPong);
+                    }
+                }
+            );
+
+            g_co->join(a);
+            g_co->join(b);
+
+            clock.report(fun, "round trips", count);
+
+            delete sender;
+        }
+    );
+
+    g_co->join(driver);
+}
+
+// 生成器逐个产出，统计每个值的耗时（两次栈切换）
+void benchGenerator1(int count)
+{
+    Generator<int> gen(
+        [=] (Generator<int>::Yield &yield)
+        {
+            for (int i = 0; i < count; i ++) {
+                yield(i);
+            }
+        }
+    );
+
+    BenchClock  clock;
+
+    int64_t sum = 0;
+    for (auto &v: gen) {
+        sum += v;
+    }
+
+    clock.report(__FUNCTION__, "values", count);
+
+    LOG("%s, sum %lld (expect %lld) \r\n", __FUNCTION__, (long long) sum, (long long) count * (count - 1) / 2);
+}
+
+void benchCoroutine()
+{
+    g_co = Coroutine::newInstance("coBench");
+    g_co2 = Coroutine::newInstance("coBench2");
+
+    benchContextJump1(10000000);
+
+    benchYield1(1000000);
+
+    benchSpawnJoin1(100000, 1);
+    benchSpawnJoin1(100000, 100);
+
+    benchPingPong1(100000);
+
+    benchSleep1(50000, 10, 0.01);
+
+    benchWaitSignal1(100000);
+
+    benchGenerator1(1000000);
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <string>
+
+#include <SpaE/directory_watcher.h>
+#include <SpaE/timer.h>
+#include <SpaE/semaphore.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f benchDirectoryWatcher " fmt, uptime(), __VA_ARGS__)
+
+/**
+ * fanout * fanout 个叶子目录（加上中间层共 fanout * (fanout + 1) + 1 个目录），
+ * 先计时遍历并关注整棵树，再在每个叶子目录中创建一个文件，计时到全部事件送达
+ */
+void benchDirectoryWatcher1(int fanout)
+{
+    std::string root = "/tmp/spae_dw_bench";
+
+    system(("rm -rf " + root).data());
+    mkdir(root.data(), 0755);
+
+    for (int i = 0; i < fanout; i ++) {
+        auto mid = root + "/d" + std::to_string(i);
+        mkdir(mid.data(), 0755);
+
+        for (int j = 0; j < fanout; j ++) {
+            mkdir((mid + "/d" + std::to_string(j)).data(), 0755);
+        }
+    }
+
+    auto files = fanout * fanout;
+
+    static std::atomic<int>     events, batches;
+    static Semaphore            done;
+    static int                  expect;
+
+    events = 0;
+    batches = 0;
+    expect = files;
+
+    auto loop = Loop::newInstance("dirWatchBench");
+
+    DirectoryWatcher    *w;
+    bool                ok;
+
+    auto t = uptime();
+
+    loop->workSync(
+        [&]
+        {
+            w = new DirectoryWatcher();
+
+            connect(w, &w->signalEvents, nullptr,
+                [] (DirectoryEventBatch batch)
+                {
+                    batches ++;
+
+                    if ((events += batch->size()) == expect) {
+                        done.post();
+                    }
+                }
+            );
+
+            ok = w->watch(root.data(), IN_CREATE);
+        }
+    );
+
+    auto watchCost = uptime() - t;
+
+    LOG("%s, watch %d, %d dirs in %.3f s (%.1f us/dir), errors %d \r\n", __FUNCTION__,
+        ok, (int) w->getWatchCount(), watchCost, watchCost * 1e6 / w->getWatchCount(), (int) w->getErrorCount());
+
+    t = uptime();
+
+    for (int i = 0; i < fanout; i ++) {
+        for (int j = 0; j < fanout; j ++) {
+            auto path = root + "/d" + std::to_string(i) + "/d" + std::to_string(j) + "/f";
+
+            ::close(::open(path.data(), O_CREAT | O_WRONLY, 0644));
+        }
+    }
+
+    auto received = done.waitFor(10);
+
+    auto cost = uptime() - t;
+
+    LOG("%s, %d events (expect %d, ok %d) in %d batches, %.3f s, %.0f events/s \r\n", __FUNCTION__,
+        events.load(), files, received, batches.load(), cost, events / cost);
+
+    loop->workSync(
+        [=]
+        {
+            delete w;
+        }
+    );
+
+    system(("rm -rf " + root).data());
+}
+
+void benchDirectoryWatcher()
+{
+    // 约 1 万个目录，需要 fs.inotify.max_user_watches 不小于此数
+    benchDirectoryWatcher1(100);
+}
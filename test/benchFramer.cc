@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <SpaE/framer.h>
+#include <SpaE/timer.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f benchFramer " fmt, uptime(), __VA_ARGS__)
+
+static void benchReport(const char *fun, const char *what, size_t bytes, Seconds cost)
+{
+    LOG("%s, %s: %.3f s, %.0f MB/s \r\n", fun, what, cost, bytes / cost / (1 << 20));
+}
+
+// 在 len 字节中不断查找分隔符，行长为 lineLen
+void benchFramerFind1(size_t lineLen, int rounds)
+{
+    std::string buf(1 << 20, 'a');
+    for (size_t i = lineLen - 1; i < buf.size(); i += lineLen) {
+        buf[i] = '\n';
+    }
+
+    auto run = [&] (const char *what, size_t (*find)(const char *, size_t, char))
+    {
+        size_t  found = 0;
+
+        auto t = uptime();
+
+        for (int r = 0; r < rounds; r ++) {
+            for (size_t pos = 0; pos < buf.size(); ) {
+                auto k = find(buf.data() + pos, buf.size() - pos, '\n');
+
+                found += k < buf.size() - pos;
+                pos += k + 1;
+            }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "line %d, %s (%d found)", (int) lineLen, what, (int) found);
+
+        benchReport(__FUNCTION__, name, buf.size() * rounds, uptime() - t);
+    };
+
+    run(Framer::getScanImpl(), Framer::find);
+    run("scalar", Framer::findScalar);
+    run("memchr",
+        [] (const char *p, size_t len, char c) -> size_t
+        {
+            auto q = (const char *) memchr(p, c, len);
+            return q ? q - p : len;
+        }
+    );
+}
+
+// 整个分帧流程：4KB 的块，含跨块的帧拼接与信号发送
+void benchFramerLine1(size_t lineLen, int rounds)
+{
+    std::vector<BufferRef>  chunks;
+
+    size_t total = 0;
+
+    for (int i = 0; i < 256; i ++) {
+        auto b = Buffer::alloc(4096);
+
+        for (size_t j = 0; j < 4096; j ++) {
+            b.data()[j] = (total + j) % lineLen == lineLen - 1 ? '\n' : 'a';
+        }
+        b->size = 4096;
+
+        total += 4096;
+        chunks.emplace_back(b);
+    }
+
+    for (auto scalar: { false, true }) {
+        Framer  f(Framer::Line);
+
+        f.setScalarScan(scalar);
+
+        size_t  frames = 0;
+
+        connect(&f, &f.signalFrames, nullptr,
+            [&] (FrameBatch batch)
+            {
+                frames += batch->size();
+            }
+        );
+
+        auto t = uptime();
+
+        for (int r = 0; r < rounds; r ++) {
+            for (auto &b: chunks) {
+                f.feed(b);
+            }
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "line %d, %s (%d frames)", (int) lineLen, scalar ? "scalar" : Framer::getScanImpl(), (int) frames);
+
+        benchReport(__FUNCTION__, name, total * rounds, uptime() - t);
+    }
+}
+
+void benchFramer()
+{
+    benchFramerFind1(64, 200);
+    benchFramerFind1(1024, 200);
+    benchFramerFind1(16384, 200);
+
+    benchFramerLine1(64, 50);
+    benchFramerLine1(1024, 50);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include <unistd.h>
 
@@ -150,6 +151,30 @@ void testContext()
 
 extern void testCoroutine();
 
+extern void testFdOperator();
+
+extern void testCoroutineSync();
+
+extern void testChannel();
+
+extern void testTaskGroup();
+
+extern void testTask();
+
+extern void testGenerator();
+
+extern void testSocket();
+
+extern void testDirectoryWatcher();
+
+extern void testFramer();
+
+extern void benchCoroutine();
+
+extern void benchDirectoryWatcher();
+
+extern void benchFramer();
+
 void testFRef(const std::function<void ()> &f)
 {
     printf("%s %d \r\n", __FUNCTION__, __LINE__);
@@ -166,6 +191,16 @@ void testFRef(std::function<void ()> &&f)
 
 int main(int argc, char **argv)
 {
+    if (argc > 1 && ! strcmp(argv[1], "bench")) {
+        benchCoroutine();
+
+        benchDirectoryWatcher();
+
+        benchFramer();
+
+        return 0;
+    }
+
     testTemplate();
 
     testTimer();
@@ -174,6 +209,24 @@ int main(int argc, char **argv)
 
     testCoroutine();
 
+    testFdOperator();
+
+    testCoroutineSync();
+
+    testChannel();
+
+    testTaskGroup();
+
+    testTask();
+
+    testGenerator();
+
+    testSocket();
+
+    testDirectoryWatcher();
+
+    testFramer();
+
     // std::function<void ()> f = [] {
     //     printf("f \r\n");
     // };
@@ -0,0 +1,148 @@
+#include <SpaE/channel.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testChannel " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co1 = nullptr, *g_co2 = nullptr;
+
+void testChannelBuffered1()
+{
+    static Channel<int>     ch(4);
+
+    // 缓冲满时生产者被挂起
+    auto producer = g_co1->work(
+        [=]
+        {
+            for (int i = 0; i < 100; i ++) {
+                ch.send(i);
+            }
+            ch.close();
+
+            LOG("%s, producer done \r\n", __FUNCTION__);
+        }
+    );
+
+    auto consumer = g_co2->work(
+        [=]
+        {
+            int v, sum = 0, maxSize = 0;
+
+            while (ch.recv(v)) {
+                sum += v;
+
+                if ((int) ch.size() > maxSize) {
+                    maxSize = ch.size();
+                }
+
+                if (v % 10 == 0) {
+                    Coroutine::yieldFor(0.01);
+                }
+            }
+
+            LOG("%s, consumer sum = %d (expect 4950), max size = %d (expect <= 4) \r\n", __FUNCTION__, sum, maxSize);
+        }
+    );
+
+    g_co1->join(producer);
+    g_co2->join(consumer);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testChannelUnbuffered1()
+{
+    static Channel<std::string>     ping, pong;
+
+    // 同一个协程线程上的乒乓
+    auto a = g_co1->work(
+        [=]
+        {
+            std::string s;
+
+            for (int i = 0; i < 3; i ++) {
+                ping.send("ping");
+                pong.recv(s);
+
+                LOG("%s, a got %s \r\n", __FUNCTION__, s.data());
+            }
+        }
+    );
+
+    auto b = g_co1->work(
+        [=]
+        {
+            std::string s;
+
+            for (int i = 0; i < 3; i ++) {
+                ping.recv(s);
+
+                LOG("%s, b got %s \r\n", __FUNCTION__, s.data());
+
+                pong.send("pong");
+            }
+        }
+    );
+
+    g_co1->join(a);
+    g_co1->join(b);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testChannelSelect1()
+{
+    static Channel<int>     ch1, ch2(1);
+
+    auto sender = g_co2->work(
+        [=]
+        {
+            Coroutine::yieldFor(0.3);
+
+            ch2.send(2);
+
+            Coroutine::yieldFor(0.3);
+
+            ch1.send(1);
+        }
+    );
+
+    auto selector = g_co1->work(
+        [=]
+        {
+            for (int i = 0; i < 4; i ++) {
+                int v1 = 0, v2 = 0;
+
+                ChannelSelect   sel;
+                auto c1 = sel.recv(ch1, v1);
+                auto c2 = sel.recv(ch2, v2);
+
+                auto r = sel.wait(0.2);
+                if (r == c1) {
+                    LOG("%s, select ch1 = %d \r\n", __FUNCTION__, v1);
+                }
+                else if (r == c2) {
+                    LOG("%s, select ch2 = %d \r\n", __FUNCTION__, v2);
+                }
+                else {
+                    LOG("%s, select timeout \r\n", __FUNCTION__);
+                }
+            }
+        }
+    );
+
+    g_co2->join(sender);
+    g_co1->join(selector);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testChannel()
+{
+    g_co1 = Coroutine::newInstance("coCh1");
+    g_co2 = Coroutine::newInstance("coCh2");
+
+    testChannelBuffered1();
+    testChannelUnbuffered1();
+    testChannelSelect1();
+}
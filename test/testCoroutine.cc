@@ -1,3 +1,5 @@
+#include <unistd.h>
+
 #include <SpaE/coroutine.h>
 
 using namespace SpaE;
@@ -130,6 +132,315 @@ void testPending1()
     LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
 }
 
+void testSleep1()
+{
+    static std::atomic<int>     rounds { 0 };
+
+    std::vector<SharedContext>  scs;
+
+    // 睡眠定时器由协程自身维护，到期时间不应偏差太多
+    auto begin = uptime();
+
+    for (int i = 0; i < 1000; i ++) {
+        scs.emplace_back(g_co2->work(
+            [=]
+            {
+                for (int j = 0; j < 10; j ++) {
+                    Coroutine::yieldFor(0.01 + (i % 10) * 0.001);
+
+                    rounds ++;
+                }
+            },
+            16 * 1024
+        ));
+    }
+
+    for (auto &it: scs) {
+        g_co2->join(it);
+    }
+
+    LOG("%s, rounds = %d (expect 10000), cost %.3f s (expect about 0.19) \r\n", __FUNCTION__, rounds.load(), uptime() - begin);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+class CoSender : public Object
+{
+signals:
+    Signal<int, std::string>    signalData;
+};
+
+void testWaitSignal1()
+{
+    static CoSender     *sender = nullptr;
+
+    // 发送者属于另一个协程线程
+    g_co2->getLoop()->workSync([] { sender = new CoSender(); });
+
+    auto w = g_co1->work(
+        []
+        {
+            auto r = Coroutine::waitSignal(sender, &sender->signalData, 0.1);
+
+            LOG("%s, timeout has value = %d (expect 0) \r\n", __FUNCTION__, (bool) r);
+
+            r = Coroutine::waitSignal(sender, &sender->signalData, 1);
+            if (r) {
+                auto &[i, s] = *r;
+
+                LOG("%s, got %d %s (expect 7 seven) \r\n", __FUNCTION__, i, s.data());
+            }
+        }
+    );
+
+    g_co2->work(
+        []
+        {
+            Coroutine::yieldFor(0.2);
+
+            emit sender->signalData(7, "seven");
+        }
+    );
+
+    g_co1->join(w);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testWaitSignal2()
+{
+    static CoSender     *sender = nullptr;
+
+    g_co2->getLoop()->workSync([] { sender = new CoSender(); });
+
+    // 发送者在发射前被销毁，一直等待的一方应立即返回空
+    auto w = g_co1->work(
+        []
+        {
+            auto begin = uptime();
+
+            auto r = Coroutine::waitSignal(sender, &sender->signalData);
+
+            LOG("%s, has value = %d (expect 0), cost %.3f s (expect about 0.2) \r\n", __FUNCTION__, (bool) r, uptime() - begin);
+        }
+    );
+
+    g_co2->work(
+        []
+        {
+            Coroutine::yieldFor(0.2);
+
+            delete sender;
+            sender = nullptr;
+        }
+    );
+
+    g_co1->join(w);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+static int useStack(int size)
+{
+    volatile char buf[size];
+
+    for (int i = 0; i < size; i += 64) {
+        buf[i] = i;
+    }
+
+    return buf[0];
+}
+
+void testStackProfile1()
+{
+    Coroutine::setStackAdaptive(true);
+
+    for (int i = 0; i < 4; i ++) {
+        auto s = g_co1->work([] { useStack(1000); }, 0, 0, "small");
+        auto b = g_co1->work([] { useStack(40000); }, 0, 0, "big");
+
+        g_co1->join(s);
+        g_co1->join(b);
+    }
+
+    for (auto &it: Coroutine::getStackProfiles()) {
+        LOG("%s, %s: samples = %d, max used = %d, suggested = %d KB \r\n", __FUNCTION__,
+            it.tag.data(), it.samples, it.maxUsed, it.suggested / 1024);
+    }
+
+    // 自适应后按统计选择栈大小
+    auto s = g_co1->work([] {}, 0, 0, "small");
+    auto b = g_co1->work([] {}, 0, 0, "big");
+
+    LOG("%s, small stack = %d KB (expect 16), big stack = %d KB (expect 64) \r\n", __FUNCTION__,
+        s->stackSize / 1024, b->stackSize / 1024);
+
+    g_co1->join(s);
+    g_co1->join(b);
+
+    Coroutine::setStackAdaptive(false);
+    Coroutine::setStackProfiling(false);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testMigrate1()
+{
+    // 上下文自己迁移，同时迁移其创建的对象
+    auto sc = g_co1->work(
+        []
+        {
+            auto sender = new CoSender();
+
+            LOG("%s, before on co1 = %d (expect 1) \r\n", __FUNCTION__, Coroutine::getCurrentCoroutine() == g_co1);
+
+            Coroutine::migrate(g_co2, { sender });
+
+            LOG("%s, after on co2 = %d (expect 1), sender on co2 = %d (expect 1) \r\n", __FUNCTION__,
+                Coroutine::getCurrentCoroutine() == g_co2, sender->getLoop() == g_co2->getLoop());
+
+            delete sender;
+        }
+    );
+
+    // 迁移后 join 仍然有效
+    g_co1->join(sc);
+
+    // 从外部迁移正在睡眠的上下文
+    auto sleeper = g_co1->work(
+        []
+        {
+            Coroutine::yieldFor(0.2);
+
+            LOG("%s, sleeper waked on co2 = %d (expect 1) \r\n", __FUNCTION__, Coroutine::getCurrentCoroutine() == g_co2);
+        }
+    );
+
+    g_co1->getLoop()->work(
+        [=]
+        {
+            g_co1->migrate(sleeper, g_co2);
+        }
+    );
+
+    g_co2->join(sleeper);
+
+    usleep(50 * 1000);
+
+    LOG("%s, workSetSize co1 = %d (expect 0), co2 = %d (expect 0) \r\n", __FUNCTION__, g_co1->workSetSize(), g_co2->workSetSize());
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testSliceBudget1()
+{
+    static int  ticks = 0;
+
+    g_co1->setSliceBudget(0.01, true);
+    g_co1->resetSliceStats();
+
+    // 不主动让出的长任务，只在 checkpoint 处被切走
+    auto greedy = g_co1->work(
+        []
+        {
+            int yields = 0, ticksSeen = 0;
+
+            auto end = uptime() + 0.2;
+            while (uptime() < end) {
+                if (Coroutine::checkpoint()) {
+                    yields ++;
+                }
+            }
+            ticksSeen = ticks;
+
+            LOG("%s, greedy yields = %d (expect ~20), ticks seen = %d (expect > 0) \r\n", __FUNCTION__, yields, ticksSeen);
+        }, 0, 0, "greedy"
+    );
+
+    auto ticker = g_co1->work(
+        []
+        {
+            for (int i = 0; i < 10; i ++) {
+                ticks ++;
+
+                Coroutine::yield();
+            }
+        }
+    );
+
+    g_co1->join(greedy);
+    g_co1->join(ticker);
+
+    auto s = g_co1->getSliceStats();
+
+    LOG("%s, slices = %llu, max = %.3f ms (expect >= 10), avg = %.3f ms, over budget = %llu \r\n", __FUNCTION__,
+        (unsigned long long) s.slices, s.max * 1000, s.avg * 1000, (unsigned long long) s.overBudget);
+
+    g_co1->setSliceBudget(0);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testJoinCancel1()
+{
+    auto sleeper = g_co1->work(
+        []
+        {
+            Coroutine::yieldFor(0.3);
+        }
+    );
+
+    auto r1 = g_co1->joinFor(sleeper, 0.1);
+    auto r2 = g_co1->joinFor(sleeper, 1);
+
+    LOG("%s, joinFor timeout = %d (expect 0), joinFor done = %d (expect 1) \r\n", __FUNCTION__, r1, r2);
+
+    // 尚未开始运行即被取消，work 不会运行
+    static bool     ran = false;
+
+    auto driver = g_co1->work(
+        []
+        {
+            auto sc = g_co1->work(
+                []
+                {
+                    ran = true;
+                }
+            );
+
+            g_co1->cancel(sc);
+            g_co1->join(sc);
+
+            LOG("%s, not started ran = %d (expect 0) \r\n", __FUNCTION__, ran);
+        }
+    );
+
+    g_co1->join(driver);
+
+    // 取消挂起中的上下文
+    auto pending = g_co1->work(
+        []
+        {
+            auto begin = uptime();
+
+            Coroutine::yieldFor(10);
+
+            LOG("%s, pending waked after %.3f s (expect ~0.1), cancelled = %d (expect 1) \r\n", __FUNCTION__,
+                uptime() - begin, Coroutine::isCancelled());
+        }
+    );
+
+    usleep(100 * 1000);
+
+    g_co1->cancel(pending);
+
+    auto r3 = g_co1->joinFor(pending, 1);
+
+    LOG("%s, joinFor cancelled = %d (expect 1) \r\n", __FUNCTION__, r3);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
 void testCoroutine()
 {
     g_co1 = Coroutine::newInstance("co1");
@@ -142,4 +453,17 @@ void testCoroutine()
     testJoin3();
 
     testPending1();
+
+    testSleep1();
+
+    testWaitSignal1();
+    testWaitSignal2();
+
+    testStackProfile1();
+
+    testMigrate1();
+
+    testSliceBudget1();
+
+    testJoinCancel1();
 }
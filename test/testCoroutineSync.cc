@@ -0,0 +1,159 @@
+#include <unistd.h>
+
+#include <deque>
+
+#include <SpaE/coroutine_sync.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testCoroutineSync " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co1 = nullptr, *g_co2 = nullptr;
+
+void testCoMutex1()
+{
+    static CoMutex  mutex;
+    static int      count = 0;
+
+    auto w = [=]
+    {
+        for (int i = 0; i < 100; i ++) {
+            std::unique_lock<CoMutex>   lk(mutex);
+
+            auto c = count;
+
+            // 持锁期间让出, 其他上下文必须被挂起而不是进入临界区
+            Coroutine::yield();
+
+            count = c + 1;
+        }
+    };
+
+    auto sc1 = g_co1->work(w);
+    auto sc2 = g_co1->work(w);
+    auto sc3 = g_co2->work(w);
+
+    g_co1->join(sc1);
+    g_co1->join(sc2);
+    g_co2->join(sc3);
+
+    LOG("%s, count = %d (expect 300) \r\n\r\n", __FUNCTION__, count);
+}
+
+void testCoConditionVariable1()
+{
+    static CoMutex              mutex;
+    static CoConditionVariable  cv;
+    static std::deque<int>      queue;
+
+    // 生产者和消费者在同一个协程线程上, 使用线程锁会死锁
+    auto consumer = g_co1->work(
+        [=]
+        {
+            int sum = 0;
+
+            for (int i = 0; i < 100; i ++) {
+                std::unique_lock<CoMutex>   lk(mutex);
+
+                cv.wait(mutex, [] { return ! queue.empty(); });
+
+                sum += queue.front();
+                queue.pop_front();
+            }
+
+            LOG("%s, consumer sum = %d (expect 4950) \r\n", __FUNCTION__, sum);
+        }
+    );
+
+    auto producer = g_co1->work(
+        [=]
+        {
+            for (int i = 0; i < 100; i ++) {
+                {
+                    std::unique_lock<CoMutex>   lk(mutex);
+
+                    queue.push_back(i);
+                }
+                cv.notifyOne();
+
+                if (i % 10 == 0) {
+                    Coroutine::yield();
+                }
+            }
+        }
+    );
+
+    g_co1->join(producer);
+    g_co1->join(consumer);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCoSemaphore1()
+{
+    static CoSemaphore  sem;
+
+    auto waiter = g_co1->work(
+        [=]
+        {
+            auto ret = sem.waitFor(0.2);
+
+            LOG("%s, waitFor timeout ret = %d (expect 0) \r\n", __FUNCTION__, ret);
+
+            ret = sem.waitFor(5);
+
+            LOG("%s, waitFor post ret = %d (expect 1) \r\n", __FUNCTION__, ret);
+        }
+    );
+
+    // 跨协程线程唤醒
+    auto poster = g_co2->work(
+        [=]
+        {
+            Coroutine::yieldFor(0.5);
+
+            sem.post();
+        }
+    );
+
+    g_co2->join(poster);
+    g_co1->join(waiter);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCoEvent1()
+{
+    static CoEvent  event;
+
+    auto w = [=]
+    {
+        event.wait();
+
+        LOG("%s, event waked \r\n", __FUNCTION__);
+    };
+
+    auto sc1 = g_co1->work(w);
+    auto sc2 = g_co2->work(w);
+
+    usleep(200 * 1000);
+
+    // 普通线程 set
+    event.set();
+
+    g_co1->join(sc1);
+    g_co2->join(sc2);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCoroutineSync()
+{
+    g_co1 = Coroutine::newInstance("coSync1");
+    g_co2 = Coroutine::newInstance("coSync2");
+
+    testCoMutex1();
+    testCoConditionVariable1();
+    testCoSemaphore1();
+    testCoEvent1();
+}
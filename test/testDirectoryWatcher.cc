@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SpaE/directory_watcher.h>
+#include <SpaE/timer.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testDirectoryWatcher " fmt, uptime(), __VA_ARGS__)
+
+static std::vector<DirectoryEvent>  g_events;
+static std::mutex                   g_eventsMutex;
+
+static bool hasEvent(const std::string &path, uint32_t mask)
+{
+    std::unique_lock<decltype(g_eventsMutex)>   lk(g_eventsMutex);
+
+    return std::any_of(g_events.begin(), g_events.end(),
+        [&] (const DirectoryEvent &e)
+        {
+            return e.path == path && (e.mask & mask);
+        }
+    );
+}
+
+static void touch(const std::string &path)
+{
+    ::close(::open(path.data(), O_CREAT | O_WRONLY, 0644));
+}
+
+void testDirectoryWatcher1()
+{
+    std::string root = "/tmp/spae_dw";
+
+    mkdir(root.data(), 0755);
+    mkdir((root + "/a").data(), 0755);
+    mkdir((root + "/a/b").data(), 0755);
+    mkdir((root + "/a/b/c").data(), 0755);
+
+    g_events.clear();
+
+    auto loop = Loop::newInstance("dirWatch");
+
+    DirectoryWatcher    *w;
+
+    loop->workSync(
+        [&]
+        {
+            w = new DirectoryWatcher();
+
+            connect(w, &w->signalEvents, nullptr,
+                [] (DirectoryEventBatch events)
+                {
+                    std::unique_lock<decltype(g_eventsMutex)>   lk(g_eventsMutex);
+
+                    g_events.insert(g_events.end(), events->begin(), events->end());
+                }
+            );
+
+            w->watch(root.data());
+        }
+    );
+
+    LOG("%s, watches %d (expect 4) \r\n", __FUNCTION__, (int) w->getWatchCount());
+
+    touch(root + "/a/b/c/f1");
+
+    // 新建的子目录自动加入关注，关注生效前创建的文件补发
+    mkdir((root + "/n").data(), 0755);
+    mkdir((root + "/n/x").data(), 0755);
+    touch(root + "/n/x/f2");
+
+    usleep(100 * 1000);
+    loop->workSync([] {});
+
+    touch(root + "/n/x/f3");
+
+    usleep(100 * 1000);
+    loop->workSync([] {});
+
+    LOG("%s, watches %d (expect 6), f1 %d f2 %d f3 %d (expect 1 1 1) \r\n", __FUNCTION__, (int) w->getWatchCount(),
+        hasEvent(root + "/a/b/c/f1", IN_CREATE), hasEvent(root + "/n/x/f2", IN_CREATE), hasEvent(root + "/n/x/f3", IN_CREATE));
+
+    // 树内改名只更新路径
+    rename((root + "/a").data(), (root + "/a2").data());
+
+    usleep(100 * 1000);
+    loop->workSync([] {});
+
+    touch(root + "/a2/b/f4");
+
+    usleep(100 * 1000);
+    loop->workSync([] {});
+
+    LOG("%s, watches %d (expect 6), f4 %d (expect 1) \r\n", __FUNCTION__, (int) w->getWatchCount(), hasEvent(root + "/a2/b/f4", IN_CREATE));
+
+    // 移出树的目录不再关注
+    rename((root + "/a2").data(), "/tmp/spae_dw_out");
+
+    usleep(100 * 1000);
+    loop->workSync([] {});
+
+    LOG("%s, watches %d (expect 3) \r\n", __FUNCTION__, (int) w->getWatchCount());
+
+    loop->workSync(
+        [=]
+        {
+            delete w;
+        }
+    );
+
+    system("rm -rf /tmp/spae_dw /tmp/spae_dw_out");
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testDirectoryWatcher()
+{
+    testDirectoryWatcher1();
+}
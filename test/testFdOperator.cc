@@ -0,0 +1,822 @@
+#include <dirent.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <SpaE/fd_operator.h>
+#include <SpaE/coroutine.h>
+#include <SpaE/semaphore.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testFdOperator " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co = nullptr;
+
+void testReadWriteAsync1()
+{
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+    auto w = new FdOperator(fds[1], "pipe:w");
+
+    // 同一个协程线程上, 读协程挂起时写协程仍然可以运行
+    auto reader = g_co->work(
+        [=]
+        {
+            char buf[64] = {0};
+
+            LOG("%s, reader begin \r\n", __FUNCTION__);
+
+            auto len = r->readAsync(buf, sizeof(buf) - 1);
+
+            LOG("%s, reader got %d: %s \r\n", __FUNCTION__, len, buf);
+        }
+    );
+
+    auto writer = g_co->work(
+        [=]
+        {
+            LOG("%s, writer begin \r\n", __FUNCTION__);
+
+            Coroutine::yieldFor(0.5);
+
+            auto len = w->writeAsync("hello", 5);
+
+            LOG("%s, writer put %d \r\n", __FUNCTION__, len);
+        }
+    );
+
+    g_co->join(writer);
+    g_co->join(reader);
+
+    delete r;
+    delete w;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCloseAsync1()
+{
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+
+    // 挂起的读在 close 时以 ECANCELED 返回，不会在 fd 被复用后重试
+    auto reader = g_co->work(
+        [=]
+        {
+            char buf[64] = {0};
+
+            auto len = r->readAsync(buf, sizeof(buf) - 1);
+
+            LOG("%s, reader got %d errno %d (expect -1 %d) \r\n", __FUNCTION__, len, errno, ECANCELED);
+        }
+    );
+
+    usleep(200 * 1000);
+
+    r->close();
+
+    g_co->join(reader);
+
+    delete r;
+    ::close(fds[1]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCancelAsync1()
+{
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+
+    // 被取消的读移出等待者后返回，之后的数据和 close 不会再碰已结束的上下文
+    auto reader = g_co->work(
+        [=]
+        {
+            char buf[64] = {0};
+
+            auto len = r->readAsync(buf, sizeof(buf) - 1);
+
+            LOG("%s, reader got %d errno %d (expect -1 %d) \r\n", __FUNCTION__, len, errno, ECANCELED);
+        }
+    );
+
+    usleep(200 * 1000);
+
+    g_co->cancel(reader);
+    g_co->join(reader);
+
+    ::write(fds[1], "abc", 3);
+    usleep(100 * 1000);
+
+    r->close();
+
+    delete r;
+    ::close(fds[1]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testCancelAsync2()
+{
+    int in[2], out[2];
+    pipe(in);
+    pipe(out);
+
+    auto src = new FdOperator(in[0], "pipe:src");
+    auto dst = new FdOperator(out[1], "pipe:dst");
+
+    // 空闲 fd 上循环等待的 splice 被取消后结束，可以 join
+    auto mover = g_co->work(
+        [=]
+        {
+            auto n = src->spliceTo(dst, 4096);
+            auto err = errno;
+
+            // 已取消的上下文再次等待立即返回
+            char buf[8];
+            auto len = src->readAsync(buf, sizeof(buf));
+
+            LOG("%s, splice %d errno %d, read %d errno %d (expect -1 %d) \r\n", __FUNCTION__, (int) n, err, len, errno, ECANCELED);
+        }
+    );
+
+    usleep(200 * 1000);
+
+    g_co->cancel(mover);
+
+    LOG("%s, joined %d (expect 1) \r\n", __FUNCTION__, g_co->joinFor(mover, 2));
+
+    src->close();
+    dst->close();
+
+    delete src;
+    delete dst;
+
+    ::close(in[1]);
+    ::close(out[0]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testMultiAsync1()
+{
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+
+    static std::atomic<int>     got;
+    static std::atomic<int>     notified;
+    got = 0;
+    notified = 0;
+
+    // 同一方向的多个等待者都会被唤醒，后登记的不会覆盖先登记的
+    auto reader = [=]
+    {
+        char c;
+        if (r->readAsync(&c, 1) == 1) {
+            got ++;
+        }
+    };
+
+    auto r1 = g_co->work(reader);
+    auto r2 = g_co->work(reader);
+
+    usleep(100 * 1000);
+
+    r->notifyReady(EPOLLIN, [] { notified ++; });
+
+    ::write(fds[1], "a", 1);
+    usleep(100 * 1000);
+    ::write(fds[1], "b", 1);
+
+    g_co->join(r1);
+    g_co->join(r2);
+
+    LOG("%s, got %d (expect 2), notified %d (expect 1) \r\n", __FUNCTION__, got.load(), notified.load());
+
+    delete r;
+    ::close(fds[1]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testSubmit1(bool uring)
+{
+    FdOperator::setUringEnabled(uring);
+
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+    auto w = new FdOperator(fds[1], "pipe:w");
+
+    static std::string      got;
+    static int              written;
+    static Semaphore        sem;
+
+    got.clear();
+    written = 0;
+
+    connect(r, &r->signalReadDone, nullptr,
+        [] (BufferRef buf, int n)
+        {
+            if (n > 0) {
+                got.append(buf.data(), n);
+            }
+            sem.post();
+        }
+    );
+    connect(w, &w->signalWriteDone, nullptr,
+        [] (int n)
+        {
+            written += n;
+        }
+    );
+
+    // 等待连接在对象所在的事件循环中生效
+    r->getLoop()->workSync([] {});
+
+    // 读请求先于数据提交，依次完成
+    r->readSubmit(64);
+    r->readSubmit(64);
+
+    w->writeSubmit("hello", 5);
+    usleep(50 * 1000);
+    w->writeSubmit(" world", 6);
+
+    auto ok = sem.waitFor(1) && sem.waitFor(1);
+
+    r->getLoop()->workSync([] {});
+
+    LOG("%s, uring %d (available %d), ok = %d, got '%s' (expect hello world), written = %d (expect 11) \r\n", __FUNCTION__,
+        uring, FdOperator::isUringAvailable(), ok, got.data(), written);
+
+    // 关闭时未完成的读请求不再通知
+    r->readSubmit(64);
+
+    delete r;
+    delete w;
+
+    FdOperator::setUringEnabled(true);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testDataWatch1(bool isolate)
+{
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+
+    static std::string      got;
+    static int              chunks;
+    static Semaphore        eof;
+
+    got.clear();
+    chunks = 0;
+
+    connect(r, &r->signalData, nullptr,
+        [] (BufferRef buf)
+        {
+            if (! buf) {
+                eof.post();
+                return;
+            }
+
+            got.append(buf.data(), buf.size());
+            chunks ++;
+        }
+    );
+
+    r->getLoop()->workSync([] {});
+
+    r->dataWatch(1024, isolate);
+
+    // 一次写入多块，由 epoll 线程一次读空
+    std::string     data(3000, 'x');
+    ::write(fds[1], data.data(), data.size());
+
+    usleep(50 * 1000);
+
+    ::write(fds[1], "end", 3);
+    ::close(fds[1]);
+
+    auto ok = eof.waitFor(1);
+
+    r->getLoop()->workSync([] {});
+
+    LOG("%s, isolate %d, eof = %d (expect 1), got %d bytes (expect 3003) in %d chunks \r\n", __FUNCTION__,
+        isolate, ok, (int) got.size(), chunks);
+
+    delete r;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testWriteBuffered1()
+{
+    int fds[2];
+    pipe(fds);
+
+    // 缩小管道缓冲，让写出很快遇到 EAGAIN
+    fcntl(fds[1], F_SETPIPE_SZ, 4096);
+
+    auto w = new FdOperator(fds[1], "pipe:w");
+
+    static std::atomic<int>     highs, drains;
+
+    highs = 0;
+    drains = 0;
+
+    connect(w, &w->signalHighWatermark, nullptr,
+        [] (size_t size)
+        {
+            highs ++;
+        }
+    );
+    connect(w, &w->signalDrained, nullptr,
+        []
+        {
+            drains ++;
+        }
+    );
+
+    w->getLoop()->workSync([] {});
+
+    w->setWriteHighWatermark(64 * 1024);
+
+    const int   chunk = 1000, count = 1000;
+    char        buf[chunk];
+
+    // 远超管道容量，写入不能阻塞
+    auto begin = uptime();
+    for (int i = 0; i < count; i ++) {
+        for (int j = 0; j < chunk; j ++) {
+            buf[j] = (char) (i + j);
+        }
+        w->writeBuffered(buf, chunk);
+    }
+    auto cost = uptime() - begin;
+
+    auto pending = w->getPendingWriteSize();
+
+    // 慢速读端
+    int     total = 0, bad = 0;
+    char    rbuf[4096];
+
+    while (total < chunk * count) {
+        auto n = ::read(fds[0], rbuf, sizeof(rbuf));
+        if (n <= 0) {
+            break;
+        }
+
+        for (int k = 0; k < n; k ++, total ++) {
+            if (rbuf[k] != (char) (total / chunk + total % chunk)) {
+                bad ++;
+            }
+        }
+    }
+
+    usleep(50 * 1000);
+    w->getLoop()->workSync([] {});
+
+    LOG("%s, cost %.3f (expect small), pending %d (expect > 0), got %d (expect %d), bad %d (expect 0), "
+        "highs %d (expect 1), drains %d (expect >= 1), pending after %d (expect 0) \r\n", __FUNCTION__,
+        cost, (int) pending, total, chunk * count, bad, highs.load(), drains.load(), (int) w->getPendingWriteSize());
+
+    delete w;
+    ::close(fds[0]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTransfer1()
+{
+    const int   size = 256 * 1024;
+
+    static char     src[size], dst[size];
+
+    for (int i = 0; i < size; i ++) {
+        src[i] = (char) (i * 7 + i / 251);
+    }
+    memset(dst, 0, size);
+
+    int sp[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sp);
+
+    auto sa = new FdOperator(sp[0], "sock:a");
+    auto sb = new FdOperator(sp[1], "sock:b");
+
+    auto fileFd = ::open("/tmp/spae_transfer.bin", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    auto file = new FdOperator(fileFd, "/tmp/spae_transfer.bin");
+
+    // 聚集写入 socket，另一端 splice 到文件，两者在同一个协程线程上交替挂起
+    auto producer = g_co->work(
+        [=]
+        {
+            struct iovec iov[4];
+            for (int i = 0; i < 4; i ++) {
+                iov[i].iov_base = src + i * (size / 4);
+                iov[i].iov_len = size / 4;
+            }
+
+            auto n = sa->writevAsync(iov, 4);
+
+            shutdown(sa->getFd(), SHUT_WR);
+
+            LOG("%s, writev %d (expect %d) \r\n", __FUNCTION__, n, size);
+        }
+    );
+
+    auto spliced = g_co->work(
+        [=]
+        {
+            auto n = sb->spliceTo(file, 1 << 20);
+
+            LOG("%s, splice to file %d (expect %d, stopped at EOF) \r\n", __FUNCTION__, (int) n, size);
+        }
+    );
+
+    g_co->join(producer);
+    g_co->join(spliced);
+
+    // 文件 sendfile 到管道，读端分散读出校验
+    int fds[2];
+    pipe(fds);
+
+    auto r = new FdOperator(fds[0], "pipe:r");
+    auto w = new FdOperator(fds[1], "pipe:w");
+
+    auto sender = g_co->work(
+        [=]
+        {
+            auto n = w->sendFileFrom(file, 0, size);
+
+            LOG("%s, sendfile %d (expect %d) \r\n", __FUNCTION__, (int) n, size);
+        }
+    );
+
+    auto receiver = g_co->work(
+        [=]
+        {
+            int got = 0;
+
+            while (got < size) {
+                struct iovec iov[2];
+                iov[0].iov_base = dst + got;
+                iov[0].iov_len = std::min(1000, size - got);
+                iov[1].iov_base = dst + got + iov[0].iov_len;
+                iov[1].iov_len = size - got - iov[0].iov_len;
+
+                auto n = r->readvAsync(iov, 2);
+                if (n <= 0) {
+                    break;
+                }
+                got += n;
+            }
+
+            LOG("%s, readv %d, match %d (expect 1) \r\n", __FUNCTION__, got, memcmp(src, dst, size) == 0);
+        }
+    );
+
+    g_co->join(sender);
+    g_co->join(receiver);
+
+    // tee 不消耗源管道的数据
+    int fds2[2];
+    pipe(fds2);
+
+    auto r2 = new FdOperator(fds2[0], "pipe2:r");
+    auto w2 = new FdOperator(fds2[1], "pipe2:w");
+
+    ::write(fds[1], "tee", 3);
+
+    auto n = r->teeTo(w2, 64);
+
+    char    a[8] = {0}, b[8] = {0};
+    ::read(fds[0], a, sizeof(a) - 1);
+    ::read(fds2[0], b, sizeof(b) - 1);
+
+    LOG("%s, tee %d (expect 3), src '%s', dst '%s' (expect tee tee) \r\n", __FUNCTION__, (int) n, a, b);
+
+    delete sa;
+    delete sb;
+    delete file;
+    delete r;
+    delete w;
+    delete r2;
+    delete w2;
+
+    unlink("/tmp/spae_transfer.bin");
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+static int countShardThreads()
+{
+    int count = 0;
+
+    auto dir = opendir("/proc/self/task");
+    if (! dir) {
+        return -1;
+    }
+
+    while (auto ent = readdir(dir)) {
+        char path[300], name[32] = {0};
+        snprintf(path, sizeof(path), "/proc/self/task/%s/comm", ent->d_name);
+
+        auto fp = fopen(path, "r");
+        if (! fp) {
+            continue;
+        }
+        if (fgets(name, sizeof(name), fp) && ! strncmp(name, "SpaE::FdW", 9)) {
+            count ++;
+        }
+        fclose(fp);
+    }
+
+    closedir(dir);
+
+    return count;
+}
+
+void testIsolatePool1()
+{
+    const int   count = 8;
+
+    FdOperator::setIsolatePool(2, 3);
+
+    static std::atomic<int>     events;
+    events = 0;
+
+    std::vector<FdOperator *>   readers;
+    std::vector<int>            writers;
+
+    // 8 个共享分片的 fd 只需要 2 个线程，再加一个独占分片
+    for (int i = 0; i <= count; i ++) {
+        int fds[2];
+        pipe(fds);
+
+        auto r = new FdOperator(fds[0], "pipe:r");
+
+        connect(r, &r->signalEpollWatch, nullptr,
+            [=] (int)
+            {
+                char c;
+                ::read(fds[0], &c, 1);
+
+                events ++;
+            }
+        );
+        r->getLoop()->workSync([] {});
+
+        r->epollWatch(EPOLLIN, i < count ? FdOperator::IsolateShard : FdOperator::IsolateDedicated);
+
+        readers.emplace_back(r);
+        writers.emplace_back(fds[1]);
+    }
+
+    for (auto fd: writers) {
+        ::write(fd, "x", 1);
+    }
+
+    usleep(100 * 1000);
+    readers[0]->getLoop()->workSync([] {});
+
+    auto shards = FdOperator::getIsolateShardCount();
+    auto threads = countShardThreads();
+
+    LOG("%s, shards %d (expect 3), threads %d (expect 3), events %d (expect %d) \r\n", __FUNCTION__,
+        shards, threads, events.load(), count + 1);
+
+    // 分片上的 fd 全部关闭后线程被 join
+    for (auto r: readers) {
+        delete r;
+    }
+    for (auto fd: writers) {
+        ::close(fd);
+    }
+
+    LOG("%s, after close shards %d (expect 0), threads %d (expect 0) \r\n", __FUNCTION__,
+        FdOperator::getIsolateShardCount(), countShardThreads());
+
+    FdOperator::setIsolatePool(4, 64);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testWatchClose1()
+{
+    const int   count = 50;
+
+    static std::atomic<int>     events;
+    events = 0;
+
+    // 对象在自己的事件循环中创建和删除，排队中的信号与删除不会并发
+    auto loop = Loop::newInstance("watchClose");
+
+    std::vector<FdOperator *>   readers;
+    std::vector<int>            writers;
+
+    // 水平触发且不读取，epoll 线程持续分发，关闭与分发并发进行
+    loop->workSync(
+        [&]
+        {
+            for (int i = 0; i < count; i ++) {
+                int fds[2];
+                pipe(fds);
+
+                auto r = new FdOperator(fds[0], "pipe:r");
+
+                connect(r, &r->signalEpollWatch, nullptr,
+                    [] (int)
+                    {
+                        events ++;
+                    }
+                );
+
+                r->epollWatch(EPOLLIN, i % 2 ? FdOperator::IsolateShard : FdOperator::IsolateNone);
+
+                ::write(fds[1], "x", 1);
+
+                readers.emplace_back(r);
+                writers.emplace_back(fds[1]);
+            }
+        }
+    );
+
+    usleep(50 * 1000);
+
+    loop->workSync(
+        [&]
+        {
+            for (auto r: readers) {
+                delete r;
+            }
+        }
+    );
+
+    // 已投递的信号执行完后不再增长
+    loop->workSync([] {});
+
+    auto before = events.load();
+
+    usleep(50 * 1000);
+    loop->workSync([] {});
+
+    LOG("%s, events %d, after close +%d (expect 0) \r\n", __FUNCTION__, before, events.load() - before);
+
+    for (auto fd: writers) {
+        ::close(fd);
+    }
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testInotify1()
+{
+    const int   files = 2000, writes = 100;
+
+    const char  *dirA = "/tmp/spae_inotify_a",
+                *dirB = "/tmp/spae_inotify_b";
+
+    mkdir(dirA, 0755);
+    mkdir(dirB, 0755);
+
+    auto a = new FdOperator(-1, dirA);
+    auto b = new FdOperator(-1, dirB);
+
+    static std::atomic<int>     created, batches, watchEvents, foreign, modified, hotMask;
+
+    created = 0;
+    batches = 0;
+    watchEvents = 0;
+    foreign = 0;
+    modified = 0;
+    hotMask = 0;
+
+    connect(a, &a->signalInotifyEvents, nullptr,
+        [] (InotifyBatch events)
+        {
+            batches ++;
+
+            for (auto &e: *events) {
+                if (e.mask & IN_CREATE) {
+                    created ++;
+                }
+                if (e.name.compare(0, 2, "f_")) {
+                    foreign ++;
+                }
+            }
+        }
+    );
+
+    connect(a, &a->signalInotifyWatch, nullptr,
+        [] (int)
+        {
+            watchEvents ++;
+        }
+    );
+
+    // 合并窗口内对同一文件的多次写入只通知一次
+    connect(b, &b->signalInotifyEvents, nullptr,
+        [] (InotifyBatch events)
+        {
+            for (auto &e: *events) {
+                modified ++;
+                hotMask |= e.mask;
+            }
+        }
+    );
+
+    a->getLoop()->workSync([] {});
+
+    a->inotifyWatch(IN_CREATE);
+
+    b->setInotifyCoalesce(0.2);
+    b->inotifyWatch(IN_MODIFY);
+
+    auto t = uptime();
+
+    for (int i = 0; i < files; i ++) {
+        auto path = std::string(dirA) + "/f_" + std::to_string(i);
+
+        ::close(::open(path.data(), O_CREAT | O_WRONLY, 0644));
+    }
+
+    auto hot = std::string(dirB) + "/hot";
+    auto fd = ::open(hot.data(), O_CREAT | O_WRONLY, 0644);
+
+    for (int i = 0; i < writes; i ++) {
+        ::write(fd, "x", 1);
+    }
+    ::close(fd);
+
+    usleep(400 * 1000);
+    a->getLoop()->workSync([] {});
+
+    LOG("%s, shared fd %d (expect 1), created %d (expect %d), batches %d (expect < %d), watch events %d, foreign %d (expect 0), %.3fs \r\n", __FUNCTION__,
+        a->getInotifyFd() == b->getInotifyFd(), created.load(), files, batches.load(), files, watchEvents.load(), foreign.load(), uptime() - t);
+
+    LOG("%s, coalesced %d writes into %d events (expect 1), IN_MODIFY %d (expect 1) \r\n", __FUNCTION__,
+        writes, modified.load(), (hotMask & IN_MODIFY) != 0);
+
+    a->getLoop()->workSync(
+        [=]
+        {
+            delete a;
+            delete b;
+        }
+    );
+
+    for (int i = 0; i < files; i ++) {
+        unlink((std::string(dirA) + "/f_" + std::to_string(i)).data());
+    }
+    unlink(hot.data());
+
+    rmdir(dirA);
+    rmdir(dirB);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testFdOperator()
+{
+    g_co = Coroutine::newInstance("coFd");
+
+    testReadWriteAsync1();
+
+    testCloseAsync1();
+    testCancelAsync1();
+    testCancelAsync2();
+    testMultiAsync1();
+
+    testSubmit1(true);
+    testSubmit1(false);
+
+    testDataWatch1(false);
+    testDataWatch1(true);
+
+    testWriteBuffered1();
+
+    testTransfer1();
+
+    testIsolatePool1();
+
+    testWatchClose1();
+
+    testInotify1();
+}
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <SpaE/framer.h>
+#include <SpaE/semaphore.h>
+#include <SpaE/timer.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testFramer " fmt, uptime(), __VA_ARGS__)
+
+// 同一循环中 feed，信号直接调用
+static std::vector<std::string>     g_frames;
+static int                          g_views;
+
+static Framer *newFramer(Framer::Mode mode)
+{
+    auto f = new Framer(mode);
+
+    connect(f, &f->signalFrames, nullptr,
+        [=] (FrameBatch frames)
+        {
+            for (auto &fr: *frames) {
+                g_frames.emplace_back(fr.data(), fr.size());
+
+                // 没有拷贝的帧引用的是 feed 进来的 4KB 缓冲，拼接的帧缓冲按帧长分配
+                if (fr.buf->capacity >= 4096) {
+                    g_views ++;
+                }
+            }
+        }
+    );
+
+    return f;
+}
+
+// 把 data 切成 chunk 字节的块依次 feed
+static void feedChunks(Framer *f, const std::string &data, size_t chunk)
+{
+    for (size_t i = 0; i < data.size(); i += chunk) {
+        auto n = std::min(chunk, data.size() - i);
+
+        auto b = Buffer::alloc(std::max<size_t>(n, 4096));
+        memcpy(b.data(), data.data() + i, n);
+        b->size = n;
+
+        f->feed(b);
+    }
+}
+
+void testFramerFind1()
+{
+    std::string buf(4096, 'a');
+
+    int bad = 0;
+
+    // 各种长度和对齐下与逐字节的结果一致
+    for (size_t len = 0; len < 300; len ++) {
+        for (size_t off = 0; off < 33; off ++) {
+            auto p = buf.data() + off;
+
+            auto pos = len ? (size_t) rand() % (len + 1) : 0;
+            if (pos < len) {
+                p[pos] = '\n';
+            }
+
+            if (Framer::find(p, len, '\n') != Framer::findScalar(p, len, '\n')) {
+                bad ++;
+            }
+
+            if (pos < len) {
+                p[pos] = 'a';
+            }
+        }
+    }
+
+    LOG("%s, impl %s, bad %d (expect 0) \r\n", __FUNCTION__, Framer::getScanImpl(), bad);
+}
+
+void testFramerLine1()
+{
+    auto f = newFramer(Framer::Line);
+
+    std::string data;
+    for (int i = 0; i < 100; i ++) {
+        data += "line " + std::to_string(i) + (i % 2 ? "\r\n" : "\n");
+    }
+
+    int bad = 0;
+
+    for (size_t chunk: { 1, 7, 64, 4096 }) {
+        g_frames.clear();
+        g_views = 0;
+
+        feedChunks(f, data, chunk);
+
+        for (int i = 0; i < 100; i ++) {
+            if (i >= (int) g_frames.size() || g_frames[i] != "line " + std::to_string(i)) {
+                bad ++;
+            }
+        }
+
+        LOG("%s, chunk %d, frames %d (expect 100), zero-copy %d \r\n", __FUNCTION__, (int) chunk, (int) g_frames.size(), g_views);
+    }
+
+    // 超长的行被丢弃，之后的行正常
+    g_frames.clear();
+
+    static std::atomic<int>     overflow;
+    overflow = 0;
+
+    connect(f, &f->signalOverflow, nullptr, [] (size_t) { overflow ++; });
+
+    f->setMaxFrameSize(16);
+    feedChunks(f, std::string(100, 'x') + "\nshort\n", 10);
+
+    LOG("%s, bad %d (expect 0), overflow %d (expect 1), after '%s' (expect short) \r\n", __FUNCTION__,
+        bad, overflow.load(), g_frames.empty() ? "" : g_frames.back().data());
+
+    delete f;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testFramerPending1()
+{
+    auto f = newFramer(Framer::Line);
+
+    g_frames.clear();
+
+    // 每块 4KB 缓冲只有 3 字节，未完成的帧不应占住每一块
+    for (int i = 0; i < 1000; i ++) {
+        auto b = Buffer::alloc(4096);
+        memcpy(b.data(), "abc", 3);
+        b->size = 3;
+
+        f->feed(b);
+    }
+
+    auto capacity = f->getPendingCapacity();
+
+    feedChunks(f, "\n", 1);
+
+    LOG("%s, pending capacity %d (expect < 8192), frames %d (expect 1), size %d (expect 3000) \r\n", __FUNCTION__,
+        (int) capacity, (int) g_frames.size(), g_frames.empty() ? 0 : (int) g_frames[0].size());
+
+    // 大部分是有效数据的块仍然直接引用
+    g_frames.clear();
+
+    feedChunks(f, std::string(3000, 'x'), 4096);
+
+    capacity = f->getPendingCapacity();
+
+    feedChunks(f, "\n", 1);
+
+    LOG("%s, pending capacity %d (expect 4096), size %d (expect 3000) \r\n", __FUNCTION__,
+        (int) capacity, g_frames.empty() ? 0 : (int) g_frames[0].size());
+
+    delete f;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testFramerEncoded1()
+{
+    // 包含各协议的特殊字节
+    std::vector<std::string>    msgs = { "hello", std::string("\0a\0\0b", 5), "\xC0\xDB\xC0", std::string(600, '\x01'), "" };
+
+    msgs.emplace_back();
+    for (int i = 0; i < 1000; i ++) {
+        msgs.back().push_back((char) (i % 7 ? i : 0));
+    }
+
+    for (auto mode: { Framer::LengthPrefixed, Framer::Slip, Framer::Cobs }) {
+        auto f = newFramer(mode);
+
+        f->setLengthPrefix(2, false);
+
+        std::string data;
+        size_t      expect = 0;
+
+        for (auto &m: msgs) {
+            auto b = f->encode(m.data(), m.size());
+            data.append(b.data(), b.size());
+
+            // SLIP 无法表示空帧
+            if (! m.empty() || mode != Framer::Slip) {
+                expect ++;
+            }
+        }
+
+        for (size_t chunk: { 1, 5, 333, 8192 }) {
+            g_frames.clear();
+
+            feedChunks(f, data, chunk);
+
+            int bad = 0;
+            for (size_t i = 0, j = 0; i < msgs.size(); i ++) {
+                if (msgs[i].empty() && mode == Framer::Slip) {
+                    continue;
+                }
+                if (j >= g_frames.size() || g_frames[j ++] != msgs[i]) {
+                    bad ++;
+                }
+            }
+
+            LOG("%s, mode %d, chunk %d, frames %d (expect %d), bad %d (expect 0) \r\n", __FUNCTION__,
+                mode, (int) chunk, (int) g_frames.size(), (int) expect, bad);
+        }
+
+        delete f;
+    }
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testFramerAttach1()
+{
+    int fds[2];
+    pipe(fds);
+
+    static std::atomic<int>     frames;
+    static Semaphore            end;
+
+    frames = 0;
+
+    auto loop = Loop::newInstance("framer");
+
+    FdOperator  *r;
+    Framer      *f;
+
+    // 分帧在 r 所在的循环中进行
+    loop->workSync(
+        [&]
+        {
+            r = new FdOperator(fds[0], "pipe:r");
+            f = new Framer(Framer::Line);
+
+            f->attach(r);
+
+            connect(f, &f->signalFrames, nullptr,
+                [] (FrameBatch batch)
+                {
+                    frames += batch->size();
+                }
+            );
+
+            connect(f, &f->signalEnd, nullptr,
+                [] ()
+                {
+                    end.post();
+                }
+            );
+
+            r->dataWatch();
+        }
+    );
+
+    for (int i = 0; i < 1000; i ++) {
+        auto line = "record " + std::to_string(i) + "\n";
+        ::write(fds[1], line.data(), line.size());
+    }
+    ::close(fds[1]);
+
+    auto ok = end.waitFor(2);
+
+    loop->workSync([] {});
+
+    LOG("%s, end %d (expect 1), frames %d (expect 1000) \r\n", __FUNCTION__, ok, frames.load());
+
+    loop->workSync(
+        [=]
+        {
+            delete f;
+            delete r;
+        }
+    );
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testFramer()
+{
+    testFramerFind1();
+
+    testFramerLine1();
+
+    testFramerPending1();
+
+    testFramerEncoded1();
+
+    testFramerAttach1();
+}
@@ -0,0 +1,160 @@
+#include <string>
+
+#include <SpaE/generator.h>
+#include <SpaE/coroutine.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testGenerator " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co1 = nullptr;
+
+void testGeneratorPipeline1()
+{
+    // decode -> filter -> aggregate，每一级都是一个生成器
+    const char *input = "12,7,30,5,18,4,99";
+
+    Generator<int> decode(
+        [=] (Generator<int>::Yield &yield)
+        {
+            int v = 0;
+
+            for (auto p = input; ; p ++) {
+                if (*p == ',' || *p == 0) {
+                    yield(v);
+                    v = 0;
+
+                    if (*p == 0) {
+                        break;
+                    }
+                }
+                else {
+                    v = v * 10 + (*p - '0');
+                }
+            }
+        }
+    );
+
+    Generator<int> filter(
+        [&] (Generator<int>::Yield &yield)
+        {
+            for (auto &v: decode) {
+                if (v >= 10) {
+                    yield(v);
+                }
+            }
+        }
+    );
+
+    int sum = 0, count = 0;
+    for (auto &v: filter) {
+        sum += v;
+        count ++;
+    }
+
+    LOG("%s, count = %d (expect 4), sum = %d (expect 159) \r\n", __FUNCTION__, count, sum);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testGeneratorEarlyExit1()
+{
+    static int  destroyed = 0;
+
+    struct Guard
+    {
+        ~Guard()
+        {
+            destroyed ++;
+        }
+    };
+
+    // 提前结束迭代，生产者栈上的对象也要被析构
+    {
+        Generator<std::string> gen(
+            [] (Generator<std::string>::Yield &yield)
+            {
+                Guard   g;
+
+                for (int i = 0; ; i ++) {
+                    yield(std::to_string(i));
+                }
+            }
+        );
+
+        for (auto &v: gen) {
+            if (v == "3") {
+                break;
+            }
+        }
+    }
+
+    LOG("%s, destroyed = %d (expect 1) \r\n", __FUNCTION__, destroyed);
+
+    // 生产者的异常在消费者处抛出
+    Generator<int> bad(
+        [] (Generator<int>::Yield &yield)
+        {
+            yield(1);
+
+            throw std::runtime_error("bad input");
+        }
+    );
+
+    std::string what;
+
+    try {
+        for (auto &v: bad) {
+            (void) v;
+        }
+    }
+    catch (std::exception &e) {
+        what = e.what();
+    }
+
+    LOG("%s, caught '%s' (expect bad input), finished = %d (expect 1) \r\n", __FUNCTION__, what.data(), bad.finished());
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testGeneratorCoroutine1()
+{
+    // 生产者挂起所在的协程上下文
+    auto sc = g_co1->work(
+        []
+        {
+            Generator<int> ticks(
+                [] (Generator<int>::Yield &yield)
+                {
+                    for (int i = 0; i < 3; i ++) {
+                        Coroutine::yieldFor(0.05);
+
+                        yield(i);
+                    }
+                }
+            );
+
+            auto begin = uptime();
+
+            int sum = 0;
+            while (auto v = ticks.next()) {
+                sum += *v;
+            }
+
+            LOG("%s, sum = %d (expect 3), cost = %.3f (expect ~0.15) \r\n", __FUNCTION__, sum, uptime() - begin);
+        }
+    );
+
+    g_co1->join(sc);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testGenerator()
+{
+    g_co1 = Coroutine::newInstance("coGen1");
+
+    testGeneratorPipeline1();
+    testGeneratorEarlyExit1();
+    testGeneratorCoroutine1();
+}
@@ -0,0 +1,524 @@
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <sys/resource.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <SpaE/socket.h>
+#include <SpaE/coroutine.h>
+#include <SpaE/semaphore.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testSocket " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co = nullptr;
+
+void testTcpServer1()
+{
+    const int   clients = 30;
+
+    std::vector<Loop *>     acceptLoops = { Loop::newInstance("tcpAcc1"), Loop::newInstance("tcpAcc2") };
+    std::vector<Loop *>     connLoops = { Loop::newInstance("tcpConn1"), Loop::newInstance("tcpConn2"), Loop::newInstance("tcpConn3") };
+
+    auto server = new TcpServer();
+
+    static std::vector<TcpSocket *>     conns;
+    static SpinMutex                    connsMutex;
+    static std::atomic<int>             misplaced;
+
+    conns.clear();
+    misplaced = 0;
+
+    // 每个连接把收到的数据原样写回
+    connect(server, &server->signalNewConnection, nullptr,
+        [] (TcpSocket *sock)
+        {
+            {
+                std::unique_lock<decltype(connsMutex)>  lk(connsMutex);
+
+                conns.emplace_back(sock);
+            }
+
+            sock->getLoop()->work(
+                [=]
+                {
+                    if (Loop::getCurrentLoop() != sock->getLoop()) {
+                        misplaced ++;
+                    }
+
+                    connect(sock, &sock->signalData, nullptr,
+                        [=] (BufferRef buf)
+                        {
+                            if (buf) {
+                                sock->writeBuffered(buf);
+                            }
+                        }
+                    );
+
+                    sock->dataWatch();
+                }
+            );
+        }
+    );
+
+    server->getLoop()->workSync([] {});
+
+    server->setConnectionLoops(connLoops);
+
+    auto ok = server->listen("127.0.0.1", 0, acceptLoops);
+
+    LOG("%s, listen %d (expect 1), port %d \r\n", __FUNCTION__, ok, server->getPort());
+
+    // 客户端在同一个协程线程上并发连接
+    static std::atomic<int>     echoed;
+    echoed = 0;
+
+    std::vector<SharedContext>  scs;
+    std::vector<TcpSocket *>    socks;
+
+    for (int i = 0; i < clients; i ++) {
+        auto sock = new TcpSocket();
+        socks.emplace_back(sock);
+
+        auto port = server->getPort();
+
+        scs.emplace_back(g_co->work(
+            [=]
+            {
+                if (! sock->connectTo("127.0.0.1", port)) {
+                    return;
+                }
+
+                auto msg = "ping " + std::to_string(i);
+                sock->writeAsync(msg.data(), msg.size());
+
+                char    buf[64] = {0};
+                int     got = 0;
+
+                while (got < (int) msg.size()) {
+                    auto n = sock->readAsync(buf + got, sizeof(buf) - 1 - got);
+                    if (n <= 0) {
+                        break;
+                    }
+                    got += n;
+                }
+
+                if (msg == buf) {
+                    echoed ++;
+                }
+            }
+        ));
+    }
+
+    for (auto &sc: scs) {
+        g_co->join(sc);
+    }
+
+    auto counts = server->getConnectionCounts();
+
+    LOG("%s, echoed %d (expect %d), misplaced %d (expect 0), loads %d %d %d (expect 10 10 10) \r\n", __FUNCTION__,
+        echoed.load(), clients, misplaced.load(), counts[0], counts[1], counts[2]);
+
+    for (auto sock: socks) {
+        delete sock;
+    }
+
+    // 连接关闭后负载归还
+    for (auto sock: conns) {
+        sock->getLoop()->workSync(
+            [=]
+            {
+                delete sock;
+            }
+        );
+    }
+
+    counts = server->getConnectionCounts();
+
+    LOG("%s, loads after close %d %d %d (expect 0 0 0) \r\n", __FUNCTION__, counts[0], counts[1], counts[2]);
+
+    delete server;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTcpClose1()
+{
+    auto server = new TcpServer();
+
+    static std::vector<TcpSocket *>     conns;
+    static SpinMutex                    connsMutex;
+    static std::atomic<int>             closed;
+    static Semaphore                    accepted;
+
+    conns.clear();
+    closed = 0;
+
+    connect(server, &server->signalNewConnection, nullptr,
+        [] (TcpSocket *sock)
+        {
+            sock->getLoop()->work(
+                [=]
+                {
+                    connect(sock, &sock->signalClosed, nullptr, [] { closed ++; });
+
+                    connect(sock, &sock->signalData, nullptr,
+                        [=] (BufferRef buf)
+                        {
+                            if (buf) {
+                                sock->writeBuffered(buf);
+                            }
+                        }
+                    );
+
+                    sock->dataWatch();
+
+                    {
+                        std::unique_lock<decltype(connsMutex)>  lk(connsMutex);
+
+                        conns.emplace_back(sock);
+                    }
+
+                    accepted.post();
+                }
+            );
+        }
+    );
+
+    server->getLoop()->workSync([] {});
+
+    server->listen("127.0.0.1", 0);
+
+    auto port = server->getPort();
+
+    auto first = new TcpSocket();
+    first->connectTo("127.0.0.1", port);
+
+    accepted.wait();
+
+    auto a = conns[0];
+    auto fd = a->getFd();
+
+    // 客户端先占用 fd，之后 accept 得到的连接通常复用 a 的 fd 号
+    auto second = new TcpSocket();
+
+    a->getLoop()->workSync([=] { a->close(); });
+
+    second->connectTo("127.0.0.1", port);
+
+    accepted.wait();
+
+    auto b = conns[1];
+
+    // 已 close 的连接再析构，不能再次关闭已被 b 复用的 fd
+    a->getLoop()->workSync([=] { delete a; });
+
+    second->write("ping", 4);
+
+    char    buf[16] = {0};
+    auto    n = second->readAsync(buf, sizeof(buf) - 1);
+
+    LOG("%s, fd reused %d, echo %d '%s' (expect 4 ping), closed %d (expect 1) \r\n", __FUNCTION__,
+        b->getFd() == fd, n, buf, closed.load());
+
+    delete first;
+    delete second;
+
+    b->getLoop()->workSync([=] { delete b; });
+
+    delete server;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTcpServer2()
+{
+    auto server = new TcpServer();
+
+    static std::atomic<int>     accepted;
+    accepted = 0;
+
+    connect(server, &server->signalNewConnection, nullptr,
+        [] (TcpSocket *sock)
+        {
+            accepted ++;
+
+            delete sock;
+        }
+    );
+
+    server->getLoop()->workSync([] {});
+
+    auto ok = server->listen("127.0.0.1", 0);
+
+    // 重复 listen 被拒绝，不会丢掉已有的监听
+    auto again = server->listen("127.0.0.1", 0);
+    auto err = errno;
+
+    LOG("%s, listen %d (expect 1), again %d errno %d (expect 0 %d) \r\n", __FUNCTION__, ok, again, err, EBUSY);
+
+    struct sockaddr_in  addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(server->getPort());
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // 用尽 fd 后连接在队列中等待，释放 fd 后由重试取走，不需要新的连接触发边沿
+    struct rlimit   old, low;
+    getrlimit(RLIMIT_NOFILE, &old);
+
+    int client = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    low = old;
+    low.rlim_cur = client + 16;
+    setrlimit(RLIMIT_NOFILE, &low);
+
+    std::vector<int>    fillers;
+    for (;;) {
+        auto fd = ::dup(0);
+        if (fd < 0) {
+            break;
+        }
+        fillers.emplace_back(fd);
+    }
+
+    ::connect(client, (struct sockaddr *) &addr, sizeof(addr));
+
+    usleep(200 * 1000);
+
+    auto starved = accepted.load();
+
+    for (auto fd: fillers) {
+        ::close(fd);
+    }
+    setrlimit(RLIMIT_NOFILE, &old);
+
+    for (int i = 0; i < 20 && accepted == 0; i ++) {
+        usleep(50 * 1000);
+    }
+
+    LOG("%s, accepted while starved %d (expect 0), after release %d (expect 1) \r\n", __FUNCTION__, starved, accepted.load());
+
+    ::close(client);
+
+    server->close();
+
+    ok = server->listen("127.0.0.1", 0);
+
+    LOG("%s, listen after close %d (expect 1) \r\n", __FUNCTION__, ok);
+
+    delete server;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testUdpSocket1()
+{
+    auto a = new UdpSocket();
+    auto b = new UdpSocket();
+
+    a->bind("127.0.0.1", 0);
+    b->bind("127.0.0.1", 0);
+
+    auto sc = g_co->work(
+        [=]
+        {
+            char        buf[64] = {0};
+            std::string host;
+            uint16_t    port = 0;
+
+            auto n = b->recvFrom(buf, sizeof(buf) - 1, &host, &port);
+
+            LOG("%s, recv %d '%s' from %s:%d (expect port %d) \r\n", __FUNCTION__, n, buf, host.data(), port, a->getLocalPort());
+        }
+    );
+
+    usleep(50 * 1000);
+
+    a->sendTo("datagram", 8, "127.0.0.1", b->getLocalPort());
+
+    g_co->join(sc);
+
+    delete a;
+    delete b;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testDatagramBatch1()
+{
+    const int   total = 10000, batch = 100;
+
+    auto a = new UdpSocket();
+    auto b = new UdpSocket();
+
+    a->bind("127.0.0.1", 0);
+    b->bind("127.0.0.1", 0);
+
+    int rcvBuf = 4 << 20;
+    setsockopt(b->getFd(), SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+
+    static std::atomic<int>     received, batches, bad, fromPort;
+    static Semaphore            done;
+
+    received = 0;
+    batches = 0;
+    bad = 0;
+    fromPort = 0;
+
+    connect(b, &b->signalDatagrams, nullptr,
+        [] (DatagramBatch msgs)
+        {
+            batches ++;
+
+            for (auto &d: *msgs) {
+                int seq;
+                memcpy(&seq, d.buf.data(), sizeof(seq));
+
+                if (d.buf.size() != 32 || seq != received) {
+                    bad ++;
+                }
+
+                fromPort = ntohs(((struct sockaddr_in *) &d.addr)->sin_port);
+
+                if (++ received == total) {
+                    done.post();
+                }
+            }
+        }
+    );
+
+    b->getLoop()->workSync([] {});
+
+    b->datagramWatch(64);
+
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(b->getLocalPort());
+    inet_pton(AF_INET, "127.0.0.1", &to.sin_addr);
+
+    int sent = 0;
+
+    for (int i = 0; i < total; i += batch) {
+        std::vector<Datagram>   msgs(batch);
+
+        for (int j = 0; j < batch; j ++) {
+            auto seq = i + j;
+
+            msgs[j].buf = Buffer::alloc(32);
+            msgs[j].buf->size = 32;
+            memset(msgs[j].buf.data(), 0, 32);
+            memcpy(msgs[j].buf.data(), &seq, sizeof(seq));
+
+            memcpy(&msgs[j].addr, &to, sizeof(to));
+            msgs[j].addrLen = sizeof(to);
+        }
+
+        auto n = a->sendBatch(msgs);
+        if (n > 0) {
+            sent += n;
+        }
+    }
+
+    auto ok = done.waitFor(2);
+
+    b->getLoop()->workSync([] {});
+
+    LOG("%s, sent %d, received %d (expect %d), ok %d, bad %d (expect 0), batches %d (expect < %d), from port %d (expect %d) \r\n", __FUNCTION__,
+        sent, received.load(), total, ok, bad.load(), batches.load(), total, fromPort.load(), a->getLocalPort());
+
+    delete a;
+    delete b;
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testUnixSocket1()
+{
+    const char  *path = "/tmp/spae_test.sock";
+
+    auto server = new UnixSocket();
+    server->bind(path);
+    server->listen();
+
+    auto acceptor = g_co->work(
+        [=]
+        {
+            auto conn = server->accept();
+            if (! conn) {
+                return;
+            }
+
+            char buf[64] = {0};
+            auto n = conn->readAsync(buf, sizeof(buf) - 1);
+
+            LOG("%s, stream got %d '%s' (expect 5 hello) \r\n", __FUNCTION__, n, buf);
+
+            delete conn;
+        }
+    );
+
+    auto client = new UnixSocket();
+
+    auto connector = g_co->work(
+        [=]
+        {
+            auto ok = client->connectTo(path);
+
+            client->writeAsync("hello", 5);
+
+            LOG("%s, connect %d (expect 1) \r\n", __FUNCTION__, ok);
+        }
+    );
+
+    g_co->join(connector);
+    g_co->join(acceptor);
+
+    delete client;
+    delete server;
+
+    unlink(path);
+
+    // 数据报
+    const char  *pathA = "/tmp/spae_test_a.sock",
+                *pathB = "/tmp/spae_test_b.sock";
+
+    auto a = new UnixSocket(UnixSocket::Datagram);
+    auto b = new UnixSocket(UnixSocket::Datagram);
+
+    a->bind(pathA);
+    b->bind(pathB);
+
+    a->sendTo("dgram", 5, pathB);
+
+    char buf[64] = {0};
+    auto n = b->readAsync(buf, sizeof(buf) - 1);
+
+    LOG("%s, datagram got %d '%s' (expect 5 dgram) \r\n", __FUNCTION__, n, buf);
+
+    delete a;
+    delete b;
+
+    unlink(pathA);
+    unlink(pathB);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testSocket()
+{
+    g_co = Coroutine::newInstance("coSock");
+
+    testTcpServer1();
+    testTcpClose1();
+    testTcpServer2();
+    testUdpSocket1();
+    testDatagramBatch1();
+    testUnixSocket1();
+}
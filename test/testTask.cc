@@ -0,0 +1,263 @@
+#include <unistd.h>
+
+#include <SpaE/task.h>
+#include <SpaE/timer.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testTask " fmt, uptime(), __VA_ARGS__)
+
+#if __cplusplus >= 202002L
+
+class TaskSender : public Object
+{
+signals:
+    Signal<int, std::string>    signalData;
+};
+
+static Loop *g_loop1 = nullptr, *g_loop2 = nullptr;
+
+static Semaphore    g_done;
+
+Task<int> taskAdd(int a, int b)
+{
+    co_await sleepFor(0.1);
+
+    co_return a + b;
+}
+
+Task<> taskChain1()
+{
+    auto v = co_await taskAdd(1, 2);
+
+    LOG("%s, add = %d (expect 3) \r\n", __FUNCTION__, v);
+
+    co_await resumeOn(g_loop2);
+
+    LOG("%s, on loop2 = %d (expect 1) \r\n", __FUNCTION__, Loop::getCurrentLoop() == g_loop2);
+
+    g_done.post();
+}
+
+Task<> taskSignal1(TaskSender *sender)
+{
+    auto [i, s] = co_await nextEmission(sender, &sender->signalData);
+
+    LOG("%s, got %d %s (expect 7 seven), on loop1 = %d (expect 1) \r\n", __FUNCTION__, i, s.data(), Loop::getCurrentLoop() == g_loop1);
+
+    g_done.post();
+}
+
+Task<> taskSignal2(TaskSender *sender)
+{
+    co_await nextEmission(sender, &sender->signalData);
+
+    LOG("%s, resumed after destroy (expect never) \r\n", __FUNCTION__);
+}
+
+Task<> taskDrive(Task<> *t)
+{
+    co_await std::move(*t);
+}
+
+Task<> taskFd1(FdOperator *fd)
+{
+    auto ok = co_await readable(fd);
+
+    char buf[16] = { 0 };
+    auto len = fd->read(buf, sizeof(buf) - 1);
+
+    LOG("%s, ready = %d, got %d: %s \r\n", __FUNCTION__, ok, (int) len, buf);
+
+    g_done.post();
+}
+
+Task<> taskSleep2()
+{
+    co_await sleepFor(0.1);
+
+    LOG("%s, resumed after destroy (expect never) \r\n", __FUNCTION__);
+}
+
+Task<> taskFd2(FdOperator *fd)
+{
+    auto ok = co_await readable(fd);
+
+    LOG("%s, ready = %d (expect 0), closed = %d (expect 1) \r\n", __FUNCTION__, ok, fd->isClosed());
+
+    g_done.post();
+}
+
+Task<> taskFd3(FdOperator *fd)
+{
+    co_await readable(fd);
+
+    LOG("%s, resumed after destroy (expect never) \r\n", __FUNCTION__);
+}
+
+void testTaskChain1()
+{
+    taskChain1().start(g_loop1);
+
+    g_done.wait();
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskSignal1()
+{
+    TaskSender  *sender = nullptr;
+
+    g_loop2->workSync([&] { sender = new TaskSender(); });
+
+    taskSignal1(sender).start(g_loop1);
+
+    usleep(100 * 1000);
+
+    emit sender->signalData(7, "seven");
+
+    g_done.wait();
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskSignal2()
+{
+    TaskSender  *sender = nullptr;
+
+    g_loop2->workSync([&] { sender = new TaskSender(); });
+
+    Task<>  inner;
+
+    // inner 由 driver 启动并挂起在 nextEmission 上，所有权仍在这里
+    g_loop1->workSync(
+        [&]
+        {
+            inner = taskSignal2(sender);
+
+            taskDrive(&inner).start();
+        }
+    );
+
+    // 销毁挂起中的任务，之后的发射不应访问已释放的等待者；driver 不再恢复
+    g_loop1->workSync([&] { inner = Task<>(); });
+
+    emit sender->signalData(1, "one");
+
+    usleep(100 * 1000);
+
+    g_loop2->workSync([&] { delete sender; });
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskFd1()
+{
+    int fds[2];
+    pipe(fds);
+
+    FdOperator  *reader = nullptr;
+
+    g_loop1->workSync([&] { reader = new FdOperator(fds[0], "pipe"); });
+
+    taskFd1(reader).start(g_loop1);
+
+    usleep(100 * 1000);
+
+    ::write(fds[1], "hello", 5);
+
+    g_done.wait();
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskSleep2()
+{
+    Task<>  inner;
+
+    g_loop1->workSync(
+        [&]
+        {
+            inner = taskSleep2();
+
+            taskDrive(&inner).start();
+        }
+    );
+
+    // 销毁挂起中的任务，定时器到期后不应恢复已释放的帧
+    g_loop1->workSync([&] { inner = Task<>(); });
+
+    usleep(200 * 1000);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskFd2()
+{
+    int fds[2];
+    pipe(fds);
+
+    FdOperator  *reader = nullptr;
+
+    g_loop1->workSync([&] { reader = new FdOperator(fds[0], "pipe"); });
+
+    // 等待中被关闭时返回 false
+    taskFd2(reader).start(g_loop1);
+
+    usleep(100 * 1000);
+
+    g_loop1->workSync([&] { reader->close(); });
+
+    g_done.wait();
+
+    g_loop1->workSync([&] { delete reader; });
+    ::close(fds[1]);
+
+    pipe(fds);
+
+    Task<>  inner;
+
+    g_loop1->workSync(
+        [&]
+        {
+            reader = new FdOperator(fds[0], "pipe");
+            inner = taskFd3(reader);
+
+            taskDrive(&inner).start();
+        }
+    );
+
+    // 销毁挂起中的任务，之后的就绪不应恢复已释放的帧
+    g_loop1->workSync([&] { inner = Task<>(); });
+
+    ::write(fds[1], "x", 1);
+
+    usleep(100 * 1000);
+
+    g_loop1->workSync([&] { delete reader; });
+    ::close(fds[1]);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTask()
+{
+    g_loop1 = Loop::newInstance("task1");
+    g_loop2 = Loop::newInstance("task2");
+
+    testTaskChain1();
+    testTaskSignal1();
+    testTaskSignal2();
+    testTaskFd1();
+    testTaskSleep2();
+    testTaskFd2();
+}
+
+#else
+
+void testTask()
+{
+    LOG("%s, skipped, need C++20 \r\n", __FUNCTION__);
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include <SpaE/task_group.h>
+#include <SpaE/channel.h>
+
+using namespace SpaE;
+
+#define LOG(fmt, ...)       printf("%.6f testTaskGroup " fmt, uptime(), __VA_ARGS__)
+
+static Coroutine *g_co1 = nullptr;
+
+void testTaskGroupWaitAll1()
+{
+    static std::atomic<int>     sum { 0 };
+
+    // 分散到协程池，聚合时只唤醒一次
+    auto parent = g_co1->work(
+        [=]
+        {
+            TaskGroup   group;
+
+            for (int i = 0; i < 1000; i ++) {
+                group.spawn(
+                    [=]
+                    {
+                        sum += i;
+                    },
+                    16 * 1024
+                );
+            }
+
+            group.waitAll();
+
+            LOG("%s, sum = %d (expect 499500), size = %d \r\n", __FUNCTION__, sum.load(), group.size());
+        }
+    );
+
+    g_co1->join(parent);
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskGroupWaitAny1()
+{
+    TaskGroup   group;
+
+    // 在普通线程中等待
+    auto sc1 = group.spawn(g_co1, [] { Coroutine::yieldFor(0.3); });
+    auto sc2 = group.spawn(g_co1, [] { Coroutine::yieldFor(0.1); });
+    auto sc3 = group.spawn(g_co1, [] { Coroutine::yieldFor(0.2); });
+
+    ContextId   id;
+    while ((id = group.waitAny())) {
+        LOG("%s, done %d (expect 2 3 1) \r\n", __FUNCTION__,
+            id == sc1->id ? 1 : id == sc2->id ? 2 : id == sc3->id ? 3 : 0);
+    }
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskGroupCancel1()
+{
+    static Channel<int>     ch;
+
+    TaskGroup   group;
+
+    group.spawn(g_co1,
+        [=]
+        {
+            int n = 0;
+
+            while (! Coroutine::isCancelled()) {
+                Coroutine::yieldFor(0.05);
+
+                n ++;
+            }
+
+            LOG("%s, poller cancelled after %d rounds \r\n", __FUNCTION__, n);
+        }
+    );
+
+    group.spawn(
+        [=]
+        {
+            int v;
+            auto ret = ch.recv(v);
+
+            LOG("%s, recv ret = %d (expect 0), cancelled = %d \r\n", __FUNCTION__, ret, Coroutine::isCancelled());
+        }
+    );
+
+    auto ret = group.waitFor(0.2);
+
+    LOG("%s, waitFor ret = %d (expect 0), size = %d (expect 2) \r\n", __FUNCTION__, ret, group.size());
+
+    group.cancel();
+    group.waitAll();
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskGroupCancel2()
+{
+    TaskGroup   outer;
+
+    // 等待中的上下文被取消，传递给内层任务组
+    outer.spawn(g_co1,
+        [=]
+        {
+            TaskGroup   inner;
+
+            for (int i = 0; i < 3; i ++) {
+                inner.spawn(g_co1,
+                    [=]
+                    {
+                        while (! Coroutine::isCancelled()) {
+                            Coroutine::yieldFor(10);
+                        }
+                    }
+                );
+            }
+
+            inner.waitAll();
+
+            LOG("%s, inner done, cancelled = %d \r\n", __FUNCTION__, Coroutine::isCancelled());
+        }
+    );
+
+    outer.waitFor(0.1);
+    outer.cancel();
+    outer.waitAll();
+
+    LOG("%s %d \r\n\r\n", __FUNCTION__, __LINE__);
+}
+
+void testTaskGroup()
+{
+    g_co1 = Coroutine::newInstance("coTg1");
+
+    testTaskGroupWaitAll1();
+    testTaskGroupWaitAny1();
+    testTaskGroupCancel1();
+    testTaskGroupCancel2();
+}